@@ -97,6 +97,7 @@ public:
 		opt_disable_numlock_check = false;
 		opt_disable_dpi_awareness = false;
         opt_time_limit = -1;
+        opt_virtual_time = false;
         opt_log_con = false;
     }
 	~Config();
@@ -116,6 +117,8 @@ public:
 public:
     bool opt_log_con;
     double opt_time_limit;
+    bool opt_virtual_time;
+    std::string opt_record,opt_replay;
 	std::string opt_editconf,opt_opensaves,opt_opencaptures,opt_lang;
 	std::vector<std::string> config_file_list;
 	std::vector<std::string> opt_c;
@@ -148,6 +148,11 @@ void CPU_RET(bool use32,Bitu bytes,Bit32u oldeip);
 void CPU_IRET(bool use32,Bit32u oldeip);
 void CPU_HLT(Bit32u oldeip);
 
+/* idle skipping of read-only polling loops (interpreter cores) */
+extern bool cpu_idle_skip;
+void CPU_IdleBackJump(Bit32u jend);
+void CPU_IdleIORead(Bitu port);
+
 bool CPU_POPF(Bitu use32);
 bool CPU_PUSHF(Bitu use32);
 bool CPU_CLI(void);
@@ -132,6 +132,7 @@ extern bool				DEPRECATED mainline_compatible_bios_mapping;
 #ifdef __SSE__
 extern bool				sse1_available;
 extern bool				sse2_available;
+extern bool				ssse3_available;
 #endif
 
 void					MSG_Add(const char*,const char*); //add messages to the internal languagefile
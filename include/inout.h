@@ -49,6 +49,16 @@ void IO_FreeWriteHandler(Bitu port,Bitu mask,Bitu range=1);
 
 void IO_InvalidateCachedHandler(Bitu port,Bitu range=1);
 
+/* For the idle skipping: the time (in PIC_FullIndex() units) at which the value read from
+ * the port may change next without a PIC event or an I/O write, for status bits derived from
+ * the emulated time. Ports without a hint stop a polling loop from being skipped. */
+typedef double IO_IdleHint(Bitu port);
+#define IO_IDLE_EVENTS_ONLY 1e300
+
+void IO_RegisterIdleHint(Bitu port,IO_IdleHint * hint,Bitu range=1);
+IO_IdleHint * IO_GetIdleHint(Bitu port);
+double IO_IdleHintEventsOnly(Bitu port);
+
 void IO_WriteB(Bitu port,Bit8u val);
 void IO_WriteW(Bitu port,Bit16u val);
 void IO_WriteD(Bitu port,Bit32u val);
@@ -32,6 +32,11 @@
 // NOTE: does not work with the dynamic core (dynrec is fine)
 #define USE_FULL_TLB
 
+// enable this to count the memory accesses that are served by the host
+// pointers of the TLB and the ones that have to go through a page handler
+// (costs some speed, see paging.stats)
+//#define PAGING_TLB_STATS
+
 class PageHandler;
 class MEM_CalloutObject;
 
@@ -310,6 +315,12 @@ struct PagingBlock {
 	} kr_links; // WP-only
 	Bit32u		firstmb[LINK_START];
 	bool		enabled;
+	struct {
+		Bit64u hits;		// accesses through a host pointer (PAGING_TLB_STATS only)
+		Bit64u misses;		// accesses that went through a page handler (PAGING_TLB_STATS only)
+		Bit64u links;		// pages linked into the TLB
+		Bit64u flushes;		// times the whole TLB was cleared
+	} stats;
 };
 
 extern PagingBlock paging; 
@@ -394,49 +405,84 @@ static INLINE PhysPt PAGING_GetPhysicalAddress(const PhysPt linAddr) {
 }
 #endif
 
+#if defined(PAGING_TLB_STATS)
+#define PAGING_TLB_HIT()	(paging.stats.hits++)
+#define PAGING_TLB_MISS()	(paging.stats.misses++)
+#else
+#define PAGING_TLB_HIT()
+#define PAGING_TLB_MISS()
+#endif
+
 /* Special inlined memory reading/writing */
 
 static INLINE Bit8u mem_readb_inline(const PhysPt address) {
 	const HostPt tlb_addr=get_tlb_read(address);
-	if (tlb_addr) return host_readb(tlb_addr+address);
-	else return (Bit8u)(get_tlb_readhandler(address))->readb(address);
+	if (tlb_addr) {
+		PAGING_TLB_HIT();
+		return host_readb(tlb_addr+address);
+	}
+	PAGING_TLB_MISS();
+	return (Bit8u)(get_tlb_readhandler(address))->readb(address);
 }
 
 static INLINE Bit16u mem_readw_inline(const PhysPt address) {
 	if ((address & 0xfff)<0xfff) {
 		const HostPt tlb_addr=get_tlb_read(address);
-		if (tlb_addr) return host_readw(tlb_addr+address);
-		else return (Bit16u)(get_tlb_readhandler(address))->readw(address);
+		if (tlb_addr) {
+			PAGING_TLB_HIT();
+			return host_readw(tlb_addr+address);
+		}
+		PAGING_TLB_MISS();
+		return (Bit16u)(get_tlb_readhandler(address))->readw(address);
 	} else return mem_unalignedreadw(address);
 }
 
 static INLINE Bit32u mem_readd_inline(const PhysPt address) {
 	if ((address & 0xfff)<0xffd) {
 		const HostPt tlb_addr=get_tlb_read(address);
-		if (tlb_addr) return host_readd(tlb_addr+address);
-		else return (Bit32u)(get_tlb_readhandler(address))->readd(address);
+		if (tlb_addr) {
+			PAGING_TLB_HIT();
+			return host_readd(tlb_addr+address);
+		}
+		PAGING_TLB_MISS();
+		return (Bit32u)(get_tlb_readhandler(address))->readd(address);
 	} else return mem_unalignedreadd(address);
 }
 
 static INLINE void mem_writeb_inline(const PhysPt address,const Bit8u val) {
 	const HostPt tlb_addr=get_tlb_write(address);
-	if (tlb_addr) host_writeb(tlb_addr+address,val);
-	else (get_tlb_writehandler(address))->writeb(address,val);
+	if (tlb_addr) {
+		PAGING_TLB_HIT();
+		host_writeb(tlb_addr+address,val);
+	} else {
+		PAGING_TLB_MISS();
+		(get_tlb_writehandler(address))->writeb(address,val);
+	}
 }
 
 static INLINE void mem_writew_inline(const PhysPt address,const Bit16u val) {
 	if ((address & 0xfffu)<0xfffu) {
 		const HostPt tlb_addr=get_tlb_write(address);
-		if (tlb_addr) host_writew(tlb_addr+address,val);
-		else (get_tlb_writehandler(address))->writew(address,val);
+		if (tlb_addr) {
+			PAGING_TLB_HIT();
+			host_writew(tlb_addr+address,val);
+		} else {
+			PAGING_TLB_MISS();
+			(get_tlb_writehandler(address))->writew(address,val);
+		}
 	} else mem_unalignedwritew(address,val);
 }
 
 static INLINE void mem_writed_inline(const PhysPt address,const Bit32u val) {
 	if ((address & 0xfffu)<0xffdu) {
 		const HostPt tlb_addr=get_tlb_write(address);
-		if (tlb_addr) host_writed(tlb_addr+address,val);
-		else (get_tlb_writehandler(address))->writed(address,val);
+		if (tlb_addr) {
+			PAGING_TLB_HIT();
+			host_writed(tlb_addr+address,val);
+		} else {
+			PAGING_TLB_MISS();
+			(get_tlb_writehandler(address))->writed(address,val);
+		}
 	} else mem_unalignedwrited(address,val);
 }
 
@@ -444,18 +490,24 @@ static INLINE void mem_writed_inline(const PhysPt address,const Bit32u val) {
 static INLINE bool mem_readb_checked(const PhysPt address, Bit8u * const val) {
 	const HostPt tlb_addr=get_tlb_read(address);
 	if (tlb_addr) {
+		PAGING_TLB_HIT();
 		*val=host_readb(tlb_addr+address);
 		return false;
-	} else return (get_tlb_readhandler(address))->readb_checked(address, val);
+	}
+	PAGING_TLB_MISS();
+	return (get_tlb_readhandler(address))->readb_checked(address, val);
 }
 
 static INLINE bool mem_readw_checked(const PhysPt address, Bit16u * const val) {
 	if ((address & 0xfffu)<0xfffu) {
 		const HostPt tlb_addr=get_tlb_read(address);
 		if (tlb_addr) {
+			PAGING_TLB_HIT();
 			*val=host_readw(tlb_addr+address);
 			return false;
-		} else return (get_tlb_readhandler(address))->readw_checked(address, val);
+		}
+		PAGING_TLB_MISS();
+		return (get_tlb_readhandler(address))->readw_checked(address, val);
 	} else return mem_unalignedreadw_checked(address, val);
 }
 
@@ -463,27 +515,36 @@ static INLINE bool mem_readd_checked(const PhysPt address, Bit32u * const val) {
 	if ((address & 0xfffu)<0xffdu) {
 		const HostPt tlb_addr=get_tlb_read(address);
 		if (tlb_addr) {
+			PAGING_TLB_HIT();
 			*val=host_readd(tlb_addr+address);
 			return false;
-		} else return (get_tlb_readhandler(address))->readd_checked(address, val);
+		}
+		PAGING_TLB_MISS();
+		return (get_tlb_readhandler(address))->readd_checked(address, val);
 	} else return mem_unalignedreadd_checked(address, val);
 }
 
 static INLINE bool mem_writeb_checked(const PhysPt address,const Bit8u val) {
 	const HostPt tlb_addr=get_tlb_write(address);
 	if (tlb_addr) {
+		PAGING_TLB_HIT();
 		host_writeb(tlb_addr+address,val);
 		return false;
-	} else return (get_tlb_writehandler(address))->writeb_checked(address,val);
+	}
+	PAGING_TLB_MISS();
+	return (get_tlb_writehandler(address))->writeb_checked(address,val);
 }
 
 static INLINE bool mem_writew_checked(const PhysPt address,const Bit16u val) {
 	if ((address & 0xfffu)<0xfffu) {
 		const HostPt tlb_addr=get_tlb_write(address);
 		if (tlb_addr) {
+			PAGING_TLB_HIT();
 			host_writew(tlb_addr+address,val);
 			return false;
-		} else return (get_tlb_writehandler(address))->writew_checked(address,val);
+		}
+		PAGING_TLB_MISS();
+		return (get_tlb_writehandler(address))->writew_checked(address,val);
 	} else return mem_unalignedwritew_checked(address,val);
 }
 
@@ -491,9 +552,12 @@ static INLINE bool mem_writed_checked(const PhysPt address,const Bit32u val) {
 	if ((address & 0xfffu)<0xffdu) {
 		const HostPt tlb_addr=get_tlb_write(address);
 		if (tlb_addr) {
+			PAGING_TLB_HIT();
 			host_writed(tlb_addr+address,val);
 			return false;
-		} else return (get_tlb_writehandler(address))->writed_checked(address,val);
+		}
+		PAGING_TLB_MISS();
+		return (get_tlb_writehandler(address))->writed_checked(address,val);
 	} else return mem_unalignedwrited_checked(address,val);
 }
 
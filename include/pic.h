@@ -46,6 +46,7 @@ unsigned int PIC_parse_IRQ_hack_string(const char *str);
 
 extern Bitu PIC_IRQCheck;
 extern Bitu PIC_Ticks;
+extern Bitu PIC_Activity; // counts the serviced events and raised IRQs, anything that can change what the guest reads
 
 typedef double pic_tickindex_t;
 
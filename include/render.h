@@ -102,10 +102,12 @@ typedef struct {
 } Render_t;
 
 extern Render_t render;
+extern RenderPal_t Scaler_Pal;     /* the palette the scalers read, copied from render.pal at the start of a frame */
 extern Bitu last_gfx_flags;
 extern ScalerLineHandler_t RENDER_DrawLine;
 void RENDER_SetSize(Bitu width,Bitu height,Bitu bpp,float fps,double scrn_ratio);
 bool RENDER_StartUpdate(void);
+bool RENDER_CanSkipFrame(void);
 void RENDER_EndUpdate(bool abort);
 void RENDER_SetPal(Bit8u entry,Bit8u red,Bit8u green,Bit8u blue);
 
@@ -0,0 +1,59 @@
+/*
+ *  Copyright (C) 2002-2019  The DOSBox Team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1335, USA.
+ */
+
+#ifndef DOSBOX_REPLAY_H
+#define DOSBOX_REPLAY_H
+
+#include <time.h>
+
+#ifndef DOSBOX_KEYBOARD_H
+#include "keyboard.h"
+#endif
+
+/* Input recording and replay (-record / -replay on the command line).
+ *
+ * Host input reaches the guest only between two emulated milliseconds, when the
+ * main loop processes the host events. While recording, the keyboard and mouse
+ * events and the changes of the cycles are written to a file together with the
+ * millisecond they happened at. A replay feeds them back at the same millisecond
+ * in virtual time and ignores the host input, so with the same configuration and
+ * disk contents the guest runs exactly the same way again. */
+
+enum ReplayMode {
+    REPLAY_OFF=0,
+    REPLAY_RECORD,
+    REPLAY_PLAY
+};
+
+extern ReplayMode replay_mode;
+
+void REPLAY_Init(const char *record_file,const char *replay_file);
+void REPLAY_Shutdown(void);
+
+/* processes the host events between two emulated milliseconds, used instead of GFX_Events() by the main loop */
+void REPLAY_Events(void);
+
+/* called by the input entry points, return false if the event has to be ignored */
+bool REPLAY_Key(KBD_KEYS keytype,bool pressed);
+bool REPLAY_MouseMoved(float xrel,float yrel,float x,float y,bool emulate);
+bool REPLAY_MouseButton(Bit8u button,bool pressed);
+
+/* the wall clock time the guest sees, derived from emulated time while recording or replaying */
+time_t REPLAY_Time(void);
+
+#endif
@@ -0,0 +1,36 @@
+/*
+ *  Copyright (C) 2002-2019  The DOSBox Team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1335, USA.
+ */
+
+#ifndef DOSBOX_SHAREDROM_H
+#define DOSBOX_SHAREDROM_H
+
+#include <stddef.h>
+
+/* Sharing of ROM images and font tables between instances ("shared rom cache" in [dosbox]).
+ *
+ * The ROM BIOS, the VGA BIOS and the PC-98 font are built by every instance and come
+ * out the same for the same configuration. SHAREDROM_Share() stores the contents of
+ * a buffer in a file of the cache directory named after its contents, and maps that
+ * file privately over the host pages of the buffer. All the instances mapping the
+ * same file share the pages in the host page cache. The emulation may still write the
+ * buffer, the host then gives the writing instance its own copy of that page.
+ *
+ * Returns the number of bytes now shared, 0 if the cache is disabled or not supported. */
+size_t SHAREDROM_Share(void *buf,size_t size,const char *name);
+
+#endif
@@ -32,6 +32,13 @@ extern unsigned long PIT_TICK_RATE;
 
 #define GetTicks() SDL_GetTicks()
 
+/* Milliseconds for pauses the guest sits through (BIOS logo, reset and exit delays).
+ * In virtual time and while recording or replaying input these are emulated
+ * milliseconds, the host clock means nothing there. */
+extern bool ticksVirtual;
+extern bool ticksGuestPauses;
+#define GetGuestTicks() (ticksGuestPauses ? (Bit32u)PIC_Ticks : (Bit32u)GetTicks())
+
 typedef void (*TIMER_TickHandler)(void);
 
 /* Register a function that gets called everytime if 1 or more ticks pass */
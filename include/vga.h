@@ -24,6 +24,7 @@
 #include "dosbox.h"
 #endif
 #include <iostream>
+#include <vector>
 
 #define VGA_LFB_MAPPED
 
@@ -747,6 +748,20 @@ typedef struct {
 	PageHandler *handler;
 } VGA_LFB;
 
+/* Writes to video memory and to the display registers, for the drawing code to tell which
+ * scanlines are still the same as the last time they were converted */
+#define VGA_DIRTY_SHIFT 8u          /* one stamp per 256 bytes of video memory */
+
+typedef struct {
+	Bit8u*	stamp = NULL;		// frame of the last write to each block of video memory
+	Bit8u	font_stamp = 0;		// frame of the last write to plane 2, where the text mode fonts are
+	Bit8u	frame = 0;		// counts frames
+	Bit32u	state = 0;		// counts writes to registers that change the picture
+	Bit32u	frame_state = 0;	// state at the start of the frame being drawn
+	bool	written = false;	// video memory was written since the start of the frame being drawn
+	bool	tracked = false;	// all writes to video memory go through the planar write handler
+} VGA_Dirty;
+
 static const size_t VGA_Draw_2_elem = 2;
 
 typedef struct {
@@ -772,6 +787,7 @@ typedef struct {
     VGA_OTHER other = {};
     VGA_Memory mem;
     VGA_LFB lfb = {};
+    VGA_Dirty dirty;
 } VGA_Type;
 
 
@@ -824,6 +840,16 @@ void VGA_KillDrawing(void);
 
 void VGA_SetOverride(bool vga_override);
 
+/* Throughput of the scanline converters with and without SIMD (VGABENCH) */
+struct VGA_DrawBenchResult {
+	const char*	name;
+	double		scalar;		// Mpixels per host second
+	double		simd;		// 0 if there is no SIMD version or the host lacks the instructions
+	bool		same;		// the SIMD version produced the same pixels
+};
+
+void VGA_DrawBenchmark(std::vector<VGA_DrawBenchResult> &res,unsigned int width,unsigned int lines);
+
 extern VGA_Type vga;
 
 /* Support for modular SVGA implementation */
@@ -27,6 +27,9 @@
 #include <string.h>
 #include <stddef.h>
 #include <stdlib.h>
+#include <map>
+#include <set>
+#include <string>
 
 #if defined (WIN32)
 #include <windows.h>
@@ -60,6 +63,8 @@
 #define DYN_HASH_SHIFT	(4)
 #define DYN_PAGE_HASH	(4096>>DYN_HASH_SHIFT)
 #define DYN_LINKS		(16)
+#define DYN_TRACE_THRESHOLD	(256)	// executions of a block before it is translated as a trace
+#define DYN_TRACE_MAXOPS	(128)
 
 
 //#define DYN_LOG 1 //Turn Logging on.
@@ -112,7 +117,8 @@ enum BlockReturn {
 #endif
 	BR_Iret,
 	BR_CallBack,
-	BR_SMCBlock
+	BR_SMCBlock,
+	BR_Trace
 };
 
 // identificator to signal self-modification of the currently executed block
@@ -168,6 +174,7 @@ static struct {
 #endif
 
 #include "core_dynrec/decoder.h"
+#include "core_dynrec/cache_persist.h"
 
 CacheBlockDynRec * LinkBlocks(BlockReturn ret) {
 	CacheBlockDynRec * block=NULL;
@@ -233,16 +240,41 @@ Bits CPU_Core_Dynrec_Run(void) {
 		#endif
 
 		CodePageHandlerDynRec * chandler=0;
+		bool datahot=false;
 		// see if the current page is present and contains code
-		if (GCC_UNLIKELY(MakeCodePage(ip_point,chandler))) {
+		if (GCC_UNLIKELY(MakeCodePage(ip_point,chandler,&datahot))) {
 			// page not present, throw the exception
 			CPU_Exception(cpu.exception.which,cpu.exception.error);
 			continue;
 		}
 
+		// the code of the page is modified too often to be worth translating
+		if (GCC_UNLIKELY(datahot || (chandler && chandler->data_hot))) {
+			if (chandler) chandler->ClearRelease();
+			// let the normal core run some instructions, then look again
+			cache_datahot.stats.slices++;
+			cpu_cycles_count_t old_cycles=CPU_Cycles;
+			cpu_cycles_count_t slice=(old_cycles>DYN_DATAHOT_SLICE) ? DYN_DATAHOT_SLICE : old_cycles;
+			CPU_Cycles=slice;
+			Bits nc_retcode=CPU_Core_Normal_Run();
+			if (!nc_retcode) {
+				CPU_Cycles=old_cycles-slice+((CPU_Cycles>0) ? CPU_Cycles : 0);
+				if (CPU_Cycles<=0) return CBRET_NONE;
+				continue;
+			}
+			CPU_CycleLeft+=old_cycles-slice;
+			return nc_retcode;
+		}
+
 		// page doesn't contain code or is special
 		if (GCC_UNLIKELY(!chandler)) return CPU_Core_Normal_Run();
 
+		// page is known from the persistent translation profile, translate its blocks now
+		if (GCC_UNLIKELY(chandler->persist_pending)) {
+			cache_persist_prewarm(chandler,ip_point);
+			continue;
+		}
+
 		// find correct Dynamic Block to run
 		CacheBlockDynRec * block=chandler->FindCacheBlock(ip_point&4095);
 		if (!block) {
@@ -251,6 +283,7 @@ Bits CPU_Core_Dynrec_Run(void) {
 			if (!chandler->invalidation_map || (chandler->invalidation_map[ip_point&4095]<4)) {
 				// translate up to 32 instructions
 				block=CreateCacheBlock(chandler,ip_point,32);
+				if (cache_persist.enabled) cache_persist_record(chandler,ip_point&4095);
 			} else {
 				// let the normal core handle this instruction to avoid zero-sized blocks
 				cpu_cycles_count_t old_cycles=CPU_Cycles;
@@ -348,6 +381,12 @@ run_block:
 			if (block) goto run_block;
 			break;
 
+		case BR_Trace:
+			// the block has become hot, run it as a trace from now on
+			block=CreateTraceBlock(cache.block.running);
+			if (block) goto run_block;
+			break;
+
 		default:
 			E_Exit("Invalid return code %d", ret);
 		}
@@ -383,7 +422,57 @@ void CPU_Core_Dynrec_Cache_Init(bool enable_cache) {
 }
 
 void CPU_Core_Dynrec_Cache_Close(void) {
+	LOG(LOG_CPU,LOG_NORMAL)("DYNREC:%lu flag computations eliminated",(unsigned long)mf_stats.eliminated);
+	if (cache_datahot.stats.marked) {
+		LOG_MSG("DYNREC:%lu writes invalidated translated code, pages became data-hot %lu times, %lu slices of data-hot pages run by the normal core",
+			(unsigned long)cache_datahot.stats.invalidations,(unsigned long)cache_datahot.stats.marked,(unsigned long)cache_datahot.stats.slices);
+	}
+	if (cache_lru.stats.evicted) {
+		LOG_MSG("DYNREC:The code cache of %luKB was full, %lu blocks evicted, %lu recently run blocks kept",
+			(unsigned long)(cache_code_size/1024),(unsigned long)cache_lru.stats.evicted,(unsigned long)cache_lru.stats.kept);
+	}
+	cache_persist_save();
 	cache_close();
 }
 
+void CPU_Core_Dynrec_Cache_Size(Bitu megabytes) {
+	// the cache memory is allocated once and stays in place,
+	// translated code contains absolute addresses into it
+	if (cache_code_start_ptr!=NULL || cache_blocks!=NULL) return;
+	cache_code_size=megabytes*1024*1024;
+	// one block descriptor for every 64 bytes of code
+	cache_block_count=cache_code_size/64;
+}
+
+void CPU_Core_Dynrec_Cache_Persist(const char * filename) {
+	cache_persist_init(filename);
+}
+
+void CPU_Core_Dynrec_DataHot_Threshold(Bitu threshold) {
+	cache_datahot.threshold=threshold;
+	if (!threshold) cache_datahot.pages.clear();
+}
+
+#if C_DEBUG
+// the DYNREC debugger command
+void CPU_Core_Dynrec_LogStats(bool reset) {
+	if (reset) {
+		mf_stats.eliminated=0;
+		DEBUG_ShowMsg("DEBUG: DYNREC counters reset.\n");
+		return;
+	}
+
+	DEBUG_ShowMsg("DYNREC: %lu flag computations eliminated",(unsigned long)mf_stats.eliminated);
+}
+#endif
+
+void CPU_Core_Dynrec_Fast_FPU(bool enable) {
+#if C_FPU
+	// only affects code translated from now on
+	dyn_fpu_fast=enable;
+#else
+	(void)enable;
+#endif
+}
+
 #endif
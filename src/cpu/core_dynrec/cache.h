@@ -19,10 +19,15 @@
 
 class CodePageHandlerDynRec;	// forward
 
+// persistent translation profile (see cache_persist.h)
+static void cache_persist_setup(CodePageHandlerDynRec * cph,PageHandler * old_handler,Bitu phys_page);
+
 // basic cache block representation
 class CacheBlockDynRec {
 public:
 	void Clear(void);
+	// remove the link of code path index, it points to the default linkcode afterwards
+	void Unlink(Bitu index);
 	// link this cache block to another block, index specifies the code
 	// path (always zero for unconditional links, 0/1 for conditional ones
 	void LinkTo(Bitu index,CacheBlockDynRec * toblock) {
@@ -53,8 +58,17 @@ public:
 		CacheBlockDynRec * to;		// this block can transfer control to the to-block
 		CacheBlockDynRec * next;
 		CacheBlockDynRec * from;	// the from-block can transfer control to this block
-	} link[2];	// maximum two links (conditional jumps)
+	} link[3];	// maximum two links (conditional jumps), the third one is the return point of a call
 	CacheBlockDynRec * crossblock;
+	struct {
+		Bit32s countdown;		// executions left until the block is translated as a trace
+	} hot;
+	struct {
+		Bit32u target;			// negated linear address of the block link[0] points to
+	} indirect;					// inline target cache of an indirect near branch
+	struct {
+		Bit32u used;			// set whenever the block is run, cleared when the eviction passes it
+	} lru;
 };
 
 static struct {
@@ -63,6 +77,7 @@ static struct {
 		CacheBlockDynRec * active;		// the current cache block
 		CacheBlockDynRec * free;		// pointer to the free list
 		CacheBlockDynRec * running;		// the last block that was entered for execution
+		CacheBlockDynRec * indirect;	// the block an indirect branch continues at
 	} block;
 	Bit8u * pos;		// position in the cache block
 	CodePageHandlerDynRec * free_pages;		// pointer to the free list
@@ -77,7 +92,49 @@ static Bit8u * cache_code=NULL;
 static Bit8u * cache_code_link_blocks=NULL;
 
 static CacheBlockDynRec * cache_blocks=NULL;
-static CacheBlockDynRec link_blocks[2];		// default linking (specially marked)
+static Bitu cache_code_size=CACHE_TOTAL;		// size of the code cache (dynamic core cache size)
+static Bitu cache_block_count=CACHE_BLOCKS;	// number of cache block descriptors
+static CacheBlockDynRec link_blocks[3];		// default linking (specially marked)
+static CacheBlockDynRec indirect_miss_block;	// returns to the core when an indirect branch target is not known
+
+// return address stack, near calls push the linear address they return to
+// together with the calling block, near returns search it for their target
+#define DYN_RAS_SIZE 16
+static struct {
+	struct {
+		PhysPt lin;						// return point of the call
+		CacheBlockDynRec * caller;		// the block that executed the call
+	} entry[DYN_RAS_SIZE];
+	Bitu top;
+} cache_ras;
+
+
+// pages whose code gets modified all the time (code and data sharing a page,
+// heavily self-modifying code) are marked data-hot and left to the normal core
+// for a while instead of retranslating their code over and over
+#define DYN_DATAHOT_WINDOW	1000	// milliseconds over which the invalidations of a page are counted
+#define DYN_DATAHOT_TIME	2000	// milliseconds a page stays data-hot
+#define DYN_DATAHOT_SLICE	32		// instructions the normal core runs at a time for a data-hot page
+
+static struct {
+	Bitu threshold;					// invalidations per window that make a page data-hot, zero disables it
+	std::map<Bitu,Bitu> pages;		// data-hot physical pages and the tick at which they cool down
+	struct {
+		Bitu invalidations;			// writes that invalidated translated code
+		Bitu marked;				// times a page became data-hot
+		Bitu slices;				// slices run by the normal core for data-hot pages
+	} stats;
+} cache_datahot = { 128 };
+
+// see if the physical page is data-hot, forget it once it has cooled down
+static bool cache_datahot_active(Bitu phys_page) {
+	if (cache_datahot.pages.empty()) return false;
+	std::map<Bitu,Bitu>::iterator it=cache_datahot.pages.find(phys_page);
+	if (it==cache_datahot.pages.end()) return false;
+	if ((Bits)(it->second-PIC_Ticks)>0) return true;
+	cache_datahot.pages.erase(it);
+	return false;
+}
 
 
 // the CodePageHandlerDynRec class provides access to the contained
@@ -108,10 +165,34 @@ public:
 			free(invalidation_map);
 			invalidation_map=NULL;
 		}
+
+		// the page can get here through a block that crosses into it
+		data_hot=cache_datahot_active(phys_page);
+		hot_window=PIC_Ticks;
+		hot_invalidations=0;
+
+		cache_persist_setup(this,old_pagehandler,phys_page);
+	}
+
+	// count the writes that hit translated code, a page with too many of them
+	// becomes data-hot, the core loop releases it and runs it with the normal core
+	void NoteInvalidation(void) {
+		cache_datahot.stats.invalidations++;
+		if (!cache_datahot.threshold || data_hot) return;
+		if ((PIC_Ticks-hot_window)>=DYN_DATAHOT_WINDOW) {
+			hot_window=PIC_Ticks;
+			hot_invalidations=0;
+		}
+		if (++hot_invalidations>=cache_datahot.threshold) {
+			data_hot=true;
+			cache_datahot.pages[phys_page]=PIC_Ticks+DYN_DATAHOT_TIME;
+			cache_datahot.stats.marked++;
+		}
 	}
 
 	// clear out blocks that contain code which has been modified
 	bool InvalidateRange(Bitu start,Bitu end) {
+		NoteInvalidation();
 		Bits index=1+(Bits)(end>>(Bitu)DYN_HASH_SHIFT);
 		bool is_current_block=false;	// if the current block is modified, it has to be exited as soon as possible
 
@@ -384,6 +465,15 @@ public:
     Bit8u* invalidation_map = NULL;
     CodePageHandlerDynRec* next = NULL; // page linking
     CodePageHandlerDynRec* prev = NULL; // page linking
+    // persistent translation profile key of the page contents at setup time
+    Bit64u persist_hash = 0;
+    Bit8u persist_mode = 0;
+    bool persist_valid = false;
+    bool persist_pending = false;       // known blocks have to be translated ahead of time
+    // adaptive data-hot detection
+    bool data_hot = false;              // the page is left to the normal core
+    Bitu hot_window = 0;                // tick at which the current counting window started
+    Bitu hot_invalidations = 0;         // invalidations within the window
 private:
     PageHandler* old_pagehandler = NULL;
 
@@ -414,7 +504,7 @@ static CacheBlockDynRec * cache_getblock(void) {
 
 void CacheBlockDynRec::Clear(void) {
 	// check if this is not a cross page block
-	if (hash.index) for (Bitu ind=0;ind<2;ind++) {
+	if (hash.index) for (Bitu ind=0;ind<3;ind++) {
 		CacheBlockDynRec * fromlink=link[ind].from;
 		link[ind].from=0;
 		while (fromlink) {
@@ -425,19 +515,7 @@ void CacheBlockDynRec::Clear(void) {
 
 			fromlink=nextlink;
 		}
-		if (link[ind].to!=&link_blocks[ind]) {
-			// not linked to the standard linkcode, find the block that links to this block
-			CacheBlockDynRec * * wherelink=&link[ind].to->link[ind].from;
-			while (*wherelink != this && *wherelink) {
-				wherelink = &(*wherelink)->link[ind].next;
-			}
-			// now remove the link
-			if(*wherelink) 
-				*wherelink = (*wherelink)->link[ind].next;
-			else {
-				LOG(LOG_CPU,LOG_ERROR)("Cache anomaly. please investigate");
-			}
-		}
+		Unlink(ind);
 	} else 
 		cache_addunusedblock(this);
 	if (crossblock) {
@@ -455,25 +533,85 @@ void CacheBlockDynRec::Clear(void) {
 		free(cache.wmapmask);
 		cache.wmapmask=NULL;
 	}
+	// forget the calls this block made
+	for (Bitu i=0;i<DYN_RAS_SIZE;i++) {
+		if (cache_ras.entry[i].caller==this) cache_ras.entry[i].caller=NULL;
+	}
+}
+
+void CacheBlockDynRec::Unlink(Bitu index) {
+	if (link[index].to!=&link_blocks[index]) {
+		// not linked to the standard linkcode, find the block that links to this block
+		CacheBlockDynRec * * wherelink=&link[index].to->link[index].from;
+		while (*wherelink != this && *wherelink) {
+			wherelink = &(*wherelink)->link[index].next;
+		}
+		// now remove the link
+		if(*wherelink) 
+			*wherelink = (*wherelink)->link[index].next;
+		else {
+			LOG(LOG_CPU,LOG_ERROR)("Cache anomaly. please investigate");
+		}
+	}
+	link[index].to=&link_blocks[index];
+	link[index].next=0;
 }
 
 
+// the code cache is used as a ring, once it is full the oldest translations are
+// overwritten. Blocks that have been run since the ring last came by are kept
+// and the code is placed behind them instead (second chance eviction). As every
+// pass clears the marks of the blocks it keeps, a place is always found.
+static struct {
+	struct {
+		Bitu evicted;			// blocks overwritten to make room
+		Bitu kept;				// recently run blocks passed over
+	} stats;
+} cache_lru;
+
+// the block that follows block in the ring
+static INLINE CacheBlockDynRec * cache_nextblock(CacheBlockDynRec * block) {
+	if (!block->cache.next || (block->cache.next->cache.start>(cache_code_start_ptr + cache_code_size - CACHE_MAXSIZE)))
+		return cache.block.first;
+	return block->cache.next;
+}
+
 static CacheBlockDynRec * cache_openblock(void) {
 	CacheBlockDynRec * block=cache.block.active;
+	Bitu size;
+	CacheBlockDynRec * nextblock;
+findblock:
+	while (block->page.handler && block->lru.used) {
+		block->lru.used=0;
+		cache_lru.stats.kept++;
+		block=cache_nextblock(block);
+	}
 	// check for enough space in this block
-	Bitu size=block->cache.size;
-	CacheBlockDynRec * nextblock=block->cache.next;
-	if (block->page.handler) 
+	size=block->cache.size;
+	nextblock=block->cache.next;
+	if (block->page.handler) {
 		block->Clear();
+		cache_lru.stats.evicted++;
+	}
 	// block size must be at least CACHE_MAXSIZE
 	while (size<CACHE_MAXSIZE) {
 		if (!nextblock)
 			goto skipresize;
+		if (nextblock->page.handler && nextblock->lru.used) {
+			// keep the recently run block, the space freed so far
+			// stays available and is merged when the ring comes by again
+			block->cache.size=size;
+			block->cache.next=nextblock;
+			block=nextblock;
+			goto findblock;
+		}
 		// merge blocks
 		size+=nextblock->cache.size;
 		CacheBlockDynRec * tempblock=nextblock->cache.next;
-		if (nextblock->page.handler) 
+		if (nextblock->page.handler) {
 			nextblock->Clear();
+			cache_lru.stats.evicted++;
+		}
 		// block is free now
 		cache_addunusedblock(nextblock);
 		nextblock=tempblock;
@@ -482,6 +620,8 @@ skipresize:
 	// adjust parameters and open this block
 	block->cache.size=size;
 	block->cache.next=nextblock;
+	block->lru.used=1;
+	cache.block.active=block;
 	cache.pos=block->cache.start;
 	return block;
 }
@@ -491,10 +631,14 @@ static void cache_closeblock(void) {
 	// links point to the default linking code
 	block->link[0].to=&link_blocks[0];
 	block->link[1].to=&link_blocks[1];
+	block->link[2].to=&link_blocks[2];
 	block->link[0].from=0;
 	block->link[1].from=0;
+	block->link[2].from=0;
 	block->link[0].next=0;
 	block->link[1].next=0;
+	block->link[2].next=0;
+	block->indirect.target=0;
 	// close the block with correct alignment
 	Bitu written=(Bitu)(cache.pos-block->cache.start);
 	if (written>block->cache.size) {
@@ -516,12 +660,7 @@ static void cache_closeblock(void) {
 		}
 	}
 	// advance the active block pointer
-	if (!block->cache.next || (block->cache.next->cache.start>(cache_code_start_ptr + CACHE_TOTAL - CACHE_MAXSIZE))) {
-//		LOG_MSG("Cache full restarting");
-		cache.block.active=cache.block.first;
-	} else {
-		cache.block.active=block->cache.next;
-	}
+	cache.block.active=cache_nextblock(block);
 }
 
 
@@ -570,12 +709,12 @@ static void cache_init(bool enable) {
 		cache_initialized = true;
 		if (cache_blocks == NULL) {
 			// allocate the cache blocks memory
-			cache_blocks=(CacheBlockDynRec*)malloc(CACHE_BLOCKS*sizeof(CacheBlockDynRec));
+			cache_blocks=(CacheBlockDynRec*)malloc(cache_block_count*sizeof(CacheBlockDynRec));
 			if(!cache_blocks) E_Exit("Allocating cache_blocks has failed");
-			memset(cache_blocks,0,sizeof(CacheBlockDynRec)*CACHE_BLOCKS);
+			memset(cache_blocks,0,sizeof(CacheBlockDynRec)*cache_block_count);
 			cache.block.free=&cache_blocks[0];
 			// initialize the cache blocks
-			for (i=0;i<CACHE_BLOCKS-1;i++) {
+			for (i=0;i<(Bits)cache_block_count-1;i++) {
 				cache_blocks[i].link[0].to=(CacheBlockDynRec *)1;
 				cache_blocks[i].link[1].to=(CacheBlockDynRec *)1;
 				cache_blocks[i].cache.next=&cache_blocks[i+1];
@@ -584,12 +723,12 @@ static void cache_init(bool enable) {
 		if (cache_code_start_ptr==NULL) {
 			// allocate the code cache memory
 #if defined (WIN32)
-			cache_code_start_ptr=(Bit8u*)VirtualAlloc(0,CACHE_TOTAL+CACHE_MAXSIZE+PAGESIZE_TEMP-1+PAGESIZE_TEMP,
+			cache_code_start_ptr=(Bit8u*)VirtualAlloc(0,cache_code_size+CACHE_MAXSIZE+PAGESIZE_TEMP-1+PAGESIZE_TEMP,
 				MEM_COMMIT,PAGE_EXECUTE_READWRITE);
 			if (!cache_code_start_ptr)
-				cache_code_start_ptr=(Bit8u*)malloc(CACHE_TOTAL+CACHE_MAXSIZE+PAGESIZE_TEMP-1+PAGESIZE_TEMP);
+				cache_code_start_ptr=(Bit8u*)malloc(cache_code_size+CACHE_MAXSIZE+PAGESIZE_TEMP-1+PAGESIZE_TEMP);
 #else
-			cache_code_start_ptr=(Bit8u*)malloc(CACHE_TOTAL+CACHE_MAXSIZE+PAGESIZE_TEMP-1+PAGESIZE_TEMP);
+			cache_code_start_ptr=(Bit8u*)malloc(cache_code_size+CACHE_MAXSIZE+PAGESIZE_TEMP-1+PAGESIZE_TEMP);
 #endif
 			if(!cache_code_start_ptr) E_Exit("Allocating dynamic cache failed");
 
@@ -600,14 +739,14 @@ static void cache_init(bool enable) {
 			cache_code=cache_code+PAGESIZE_TEMP;
 
 #if (C_HAVE_MPROTECT)
-			if(mprotect(cache_code_link_blocks,CACHE_TOTAL+CACHE_MAXSIZE+PAGESIZE_TEMP,PROT_WRITE|PROT_READ|PROT_EXEC))
+			if(mprotect(cache_code_link_blocks,cache_code_size+CACHE_MAXSIZE+PAGESIZE_TEMP,PROT_WRITE|PROT_READ|PROT_EXEC))
 				LOG_MSG("Setting execute permission on the code cache has failed");
 #endif
 			CacheBlockDynRec * block=cache_getblock();
 			cache.block.first=block;
 			cache.block.active=block;
 			block->cache.start=&cache_code[0];
-			block->cache.size=CACHE_TOTAL;
+			block->cache.size=cache_code_size;
 			block->cache.next=0;						// last block in the list
 		}
 		// setup the default blocks for block linkage returns
@@ -619,12 +758,19 @@ static void cache_init(bool enable) {
 		link_blocks[1].cache.start=cache.pos;
 		// link code that returns with a special return code
 		dyn_return(BR_Link2,false);
+		// the return point link is never jumped to
+		link_blocks[2].cache.start=link_blocks[0].cache.start;
 
 		cache.pos=&cache_code_link_blocks[64];
 		*(void**)(&core_dynrec.runcode) = (void*)cache.pos;
 //		link_blocks[1].cache.start=cache.pos;
 		dyn_run_code();
 
+		// code that returns to the core when the target of an
+		// indirect branch has not been translated yet
+		indirect_miss_block.cache.start=cache.pos;
+		dyn_return(BR_Normal,false);
+
 		cache.free_pages=0;
 		cache.last_page=0;
 		cache.used_pages=0;
@@ -0,0 +1,191 @@
+/*
+ *  Copyright (C) 2002-2019  The DOSBox Team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1335, USA.
+ */
+
+
+
+/*
+	Persistent translation profile.
+
+	The generated host code can not be stored on disk as it is, every
+	translated block contains absolute addresses of the emulator itself
+	(cpu_regs, helper functions, cache links) which differ from one run
+	to the next. What is stored instead is the list of block start
+	offsets that got translated for a code page, keyed by a hash of the
+	contents of the guest page and the CPU mode the code ran in.
+
+	When a page is turned into a code page and its contents and mode
+	match an entry of the profile, all known blocks of the page are
+	translated in one go before execution continues. The blocks are
+	translated from the current memory contents and are protected by
+	the write map of the CodePageHandlerDynRec like any other block,
+	so a stale or colliding profile entry can never cause wrong code
+	to be executed, it only costs some translation time.
+*/
+
+
+#define PERSIST_MAGIC		"DBXDRCP1"
+#define PERSIST_MAX_PAGES	(64*1024)
+
+// mode bits that influence the translation of a code page
+#define PERSIST_MODE_BIG	0x01
+#define PERSIST_MODE_PMODE	0x02
+#define PERSIST_MODE_VM		0x04
+
+typedef std::pair<Bit64u,Bit8u> PersistKey;
+
+static struct {
+	bool enabled;
+	bool dirty;
+	std::string filename;
+	std::map<PersistKey, std::set<Bit16u> > pages;
+	Bitu prewarmed;			// number of blocks translated ahead of time
+} cache_persist;
+
+
+static Bit8u cache_persist_mode(void) {
+	Bit8u mode=0;
+	if (cpu.code.big) mode|=PERSIST_MODE_BIG;
+	if (cpu.pmode) mode|=PERSIST_MODE_PMODE;
+	if (reg_flags & FLAG_VM) mode|=PERSIST_MODE_VM;
+	return mode;
+}
+
+// called when a memory page becomes a code page, hash the page contents
+static void cache_persist_setup(CodePageHandlerDynRec * cph,PageHandler * old_handler,Bitu phys_page) {
+	cph->persist_valid=false;
+	cph->persist_pending=false;
+	if (!cache_persist.enabled) return;
+	if (!(old_handler->flags & PFLAG_READABLE)) return;
+
+	HostPt mem=old_handler->GetHostReadPt(phys_page);
+	if (mem==NULL) return;
+
+	// 64bit FNV-1a over the whole page
+	Bit64u hash=0xcbf29ce484222325ULL;
+	for (Bitu i=0;i<4096;i++) {
+		hash^=mem[i];
+		hash*=0x100000001b3ULL;
+	}
+	cph->persist_hash=hash;
+	cph->persist_mode=cache_persist_mode();
+	cph->persist_valid=true;
+	cph->persist_pending=(cache_persist.pages.find(PersistKey(hash,cph->persist_mode))!=cache_persist.pages.end());
+}
+
+// remember that a block has been translated at offset start of the code page
+static void cache_persist_record(CodePageHandlerDynRec * cph,Bitu start) {
+	if (!cph->persist_valid || (cph->persist_mode!=cache_persist_mode())) return;
+	PersistKey key(cph->persist_hash,cph->persist_mode);
+	std::map<PersistKey, std::set<Bit16u> >::iterator it=cache_persist.pages.find(key);
+	if (it==cache_persist.pages.end()) {
+		if (cache_persist.pages.size()>=PERSIST_MAX_PAGES) return;
+		it=cache_persist.pages.insert(std::make_pair(key,std::set<Bit16u>())).first;
+	}
+	if (it->second.insert((Bit16u)start).second) cache_persist.dirty=true;
+}
+
+// translate all blocks known for this code page, lin_addr is any address within the page
+static void cache_persist_prewarm(CodePageHandlerDynRec * cph,PhysPt lin_addr) {
+	cph->persist_pending=false;
+	// page faults can't be handled in the middle of the prewarming
+	if (paging.enabled) return;
+	if (cph->persist_mode!=cache_persist_mode()) return;
+
+	std::map<PersistKey, std::set<Bit16u> >::iterator it=cache_persist.pages.find(PersistKey(cph->persist_hash,cph->persist_mode));
+	if (it==cache_persist.pages.end()) return;
+
+	PhysPt page_base=lin_addr&~((PhysPt)4095);
+	for (std::set<Bit16u>::iterator sit=it->second.begin();sit!=it->second.end();++sit) {
+		// the page might have been released by a translation that crossed into the next page
+		if (get_tlb_readhandler(page_base)!=cph) break;
+		if (cph->FindCacheBlock(*sit)) continue;
+		// skip code that is known to be modified a lot
+		if (cph->invalidation_map && (cph->invalidation_map[*sit]>=4)) continue;
+		CreateCacheBlock(cph,page_base+(*sit),32);
+		cache_persist.prewarmed++;
+	}
+}
+
+static void cache_persist_save(void) {
+	if (!cache_persist.enabled || !cache_persist.dirty) return;
+	FILE * f=fopen(cache_persist.filename.c_str(),"wb");
+	if (f==NULL) {
+		LOG_MSG("DYNREC:Unable to write persistent cache %s",cache_persist.filename.c_str());
+		return;
+	}
+	Bit32u count=(Bit32u)cache_persist.pages.size();
+	fwrite(PERSIST_MAGIC,8,1,f);
+	fwrite(&count,sizeof(count),1,f);
+	for (std::map<PersistKey, std::set<Bit16u> >::iterator it=cache_persist.pages.begin();it!=cache_persist.pages.end();++it) {
+		Bit16u blocks=(Bit16u)it->second.size();
+		fwrite(&it->first.first,sizeof(Bit64u),1,f);
+		fwrite(&it->first.second,sizeof(Bit8u),1,f);
+		fwrite(&blocks,sizeof(blocks),1,f);
+		for (std::set<Bit16u>::iterator sit=it->second.begin();sit!=it->second.end();++sit) {
+			Bit16u start=*sit;
+			fwrite(&start,sizeof(start),1,f);
+		}
+	}
+	fclose(f);
+	cache_persist.dirty=false;
+	LOG(LOG_CPU,LOG_NORMAL)("DYNREC:Saved translation profile of %u pages to %s",(unsigned int)count,cache_persist.filename.c_str());
+}
+
+static void cache_persist_load(void) {
+	cache_persist.pages.clear();
+	cache_persist.dirty=false;
+	FILE * f=fopen(cache_persist.filename.c_str(),"rb");
+	if (f==NULL) return;		// no profile yet, will be created on exit
+
+	char magic[8];
+	Bit32u count=0;
+	if (fread(magic,8,1,f)!=1 || memcmp(magic,PERSIST_MAGIC,8) || fread(&count,sizeof(count),1,f)!=1) {
+		LOG_MSG("DYNREC:Persistent cache %s is invalid, ignoring it",cache_persist.filename.c_str());
+		fclose(f);
+		return;
+	}
+	for (Bit32u i=0;i<count && i<PERSIST_MAX_PAGES;i++) {
+		Bit64u hash;
+		Bit8u mode;
+		Bit16u blocks;
+		if (fread(&hash,sizeof(hash),1,f)!=1 || fread(&mode,sizeof(mode),1,f)!=1 ||
+			fread(&blocks,sizeof(blocks),1,f)!=1) break;
+		std::set<Bit16u> & starts=cache_persist.pages[PersistKey(hash,mode)];
+		for (Bitu b=0;b<blocks;b++) {
+			Bit16u start;
+			if (fread(&start,sizeof(start),1,f)!=1) break;
+			if (start<4096) starts.insert(start);
+		}
+	}
+	fclose(f);
+	LOG(LOG_CPU,LOG_NORMAL)("DYNREC:Loaded translation profile of %u pages from %s",(unsigned int)cache_persist.pages.size(),cache_persist.filename.c_str());
+}
+
+static void cache_persist_init(const char * filename) {
+	std::string fname(filename!=NULL ? filename : "");
+	if (cache_persist.enabled && fname==cache_persist.filename) return;
+
+	// flush the profile of the previous file
+	cache_persist_save();
+
+	cache_persist.filename=fname;
+	cache_persist.enabled=!fname.empty();
+	cache_persist.prewarmed=0;
+	if (cache_persist.enabled) cache_persist_load();
+	else cache_persist.pages.clear();
+}
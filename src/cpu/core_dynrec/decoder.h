@@ -23,6 +23,7 @@
 #include "decoder_opcodes.h"
 
 #include "dyn_fpu.h"
+#include "dyn_mmx.h"
 
 /*
 	The function CreateCacheBlock translates the instruction stream
@@ -31,8 +32,9 @@
 	instruction is encountered.
 */
 
-static CacheBlockDynRec * CreateCacheBlock(CodePageHandlerDynRec * codepage,PhysPt start,Bitu max_opcodes) {
+static CacheBlockDynRec * CreateCacheBlock(CodePageHandlerDynRec * codepage,PhysPt start,Bitu max_opcodes,bool trace=false) {
 	// initialize a load of variables
+	decode.trace=trace;
 	decode.code_start=start;
 	decode.code=start;
 	decode.page.code=codepage;
@@ -45,10 +47,15 @@ static CacheBlockDynRec * CreateCacheBlock(CodePageHandlerDynRec * codepage,Phys
 	codepage->AddCacheBlock(decode.block);
 
 	InitFlagsOptimization();
+#ifdef DRC_REGS_CACHE
+	gen_regcache_init();
+#endif
 
 	// every codeblock that is run sets cache.block.running to itself
 	// so the block linking knows the last executed block
 	gen_mov_direct_ptr(&cache.block.running,(DRC_PTR_SIZE_IM)decode.block);
+	// and marks itself as used so it is kept when the cache is full (see cache_openblock)
+	gen_mov_direct_dword(&decode.block->lru.used,1);
 
 	// start with the cycles check
 	gen_mov_word_to_reg(FC_RETOP,&CPU_Cycles,true);
@@ -56,8 +63,22 @@ static CacheBlockDynRec * CreateCacheBlock(CodePageHandlerDynRec * codepage,Phys
 	save_info_dynrec[used_save_info_dynrec].type=cycle_check;
 	used_save_info_dynrec++;
 
+	if (!trace) {
+		// count the executions of this block, once it became hot
+		// it is translated again as a trace (see CreateTraceBlock)
+		decode.block->hot.countdown=DYN_TRACE_THRESHOLD;
+		gen_mov_word_to_reg(FC_OP1,&decode.block->hot.countdown,true);
+		gen_add_imm(FC_OP1,(Bit32u)(-1));
+		gen_mov_word_from_reg(FC_OP1,&decode.block->hot.countdown,true);
+		save_info_dynrec[used_save_info_dynrec].branch_pos=gen_create_branch_long_leqzero(FC_OP1);
+		save_info_dynrec[used_save_info_dynrec].type=trace_check;
+		used_save_info_dynrec++;
+	}
+
 	decode.cycles=0;
 	while (max_opcodes--) {
+		// a trace has to fit into a single cache block
+		if (GCC_UNLIKELY(trace) && !dyn_trace_room()) break;
 		// Init prefixes
 		decode.big_addr=cpu.code.big;
 		decode.big_op=cpu.code.big;
@@ -240,6 +261,19 @@ restart_prefix:
 				case 0xbe:dyn_movx_ev_gb(true);break;
 				case 0xbf:dyn_movx_ev_gw(true);break;
 
+				// mmx instructions
+				case 0x60:case 0x61:case 0x62:case 0x63:case 0x64:case 0x65:case 0x66:case 0x67:
+				case 0x68:case 0x69:case 0x6a:case 0x6b:case 0x6e:case 0x6f:
+				case 0x71:case 0x72:case 0x73:case 0x74:case 0x75:case 0x76:case 0x77:
+				case 0x7e:case 0x7f:
+				case 0xd1:case 0xd2:case 0xd3:case 0xd5:case 0xd8:case 0xd9:case 0xdb:
+				case 0xdc:case 0xdd:case 0xdf:
+				case 0xe1:case 0xe2:case 0xe5:case 0xe8:case 0xe9:case 0xeb:case 0xec:case 0xed:case 0xef:
+				case 0xf1:case 0xf2:case 0xf3:case 0xf5:case 0xf8:case 0xf9:case 0xfa:
+				case 0xfc:case 0xfd:case 0xfe:
+					if (!dyn_mmx(dual_code)) goto illegalopcode;
+					break;
+
 				default:
 #if DYN_LOG
 //					LOG_MSG("Unhandled dual opcode 0F%02X",dual_code);
@@ -511,20 +545,20 @@ restart_prefix:
 
 		// 'call near imm16/32'
 		case 0xe8:
-			dyn_call_near_imm();
-			goto finish_block;
+			if (dyn_call_near_imm()) goto finish_block;
+			break;
 		// 'jmp near imm16/32'
 		case 0xe9:
-			dyn_exit_link(decode.big_op ? (Bit32s)decode_fetchd() : (Bit16s)decode_fetchw());
-			goto finish_block;
+			if (dyn_jmp_link(decode.big_op ? (Bit32s)decode_fetchd() : (Bit16s)decode_fetchw())) goto finish_block;
+			break;
 		// 'jmp far'
 		case 0xea:
 			dyn_jmp_far_imm();
 			goto finish_block;
 		// 'jmp short imm8'
 		case 0xeb:
-			dyn_exit_link((Bit8s)decode_fetchb());
-			goto finish_block;
+			if (dyn_jmp_link((Bit8s)decode_fetchb())) goto finish_block;
+			break;
 
 
 		// repeat prefixes
@@ -576,6 +610,12 @@ restart_prefix:
 				goto core_close_block;
 			case 2:
 				goto illegalopcode;
+			case 3:
+				// indirect near call/jmp
+				dyn_reduce_cycles();
+				dyn_branch_indirect(false);
+				dyn_closeblock();
+				goto finish_block;
 			default:
 				break;
 			}
@@ -615,3 +655,26 @@ finish_block:
 
 	return decode.block;
 }
+
+
+/*
+	The function CreateTraceBlock translates a block that has been
+	executed DYN_TRACE_THRESHOLD times again as a trace. The trace
+	follows forward unconditional jumps and near calls inside the page,
+	and spans up to DYN_TRACE_MAXOPS instructions, so the cycles check,
+	eip update and block linking between the fused blocks disappear and
+	the flags optimization can look across the former block boundaries.
+*/
+
+static CacheBlockDynRec * CreateTraceBlock(CacheBlockDynRec * hot) {
+	PhysPt ip_point=SegPhys(cs)+reg_eip;
+	CodePageHandlerDynRec * chandler=hot->page.handler;
+	if (!chandler || (hot->page.start!=(ip_point&4095)) ||
+		(chandler->invalidation_map && (chandler->invalidation_map[ip_point&4095]>=4))) {
+		// can't be retranslated, don't try again
+		hot->hot.countdown=0x7fffffff;
+		return NULL;
+	}
+	hot->Clear();
+	return CreateCacheBlock(chandler,ip_point,DYN_TRACE_MAXOPS,true);
+}
@@ -103,6 +103,7 @@ static struct DynDecode {
 	Bitu cycles;			// number cycles used by currently translated code
 	bool seg_prefix_used;	// segment overridden
 	Bit8u seg_prefix;		// segment prefix (if seg_prefix_used==true)
+	bool trace;				// translating a trace (superblock) of a hot block
 
 	// block that contains the first instruction translated
 	CacheBlockDynRec * block;
@@ -128,7 +129,10 @@ static struct DynDecode {
 } decode;
 
 
-static bool MakeCodePage(Bitu lin_addr,CodePageHandlerDynRec * &cph) {
+// make the page at lin_addr a code page, cph receives its handler or NULL if no
+// code can be translated there. If datahot is given data-hot pages are refused
+// as well, which is signalled through it
+static bool MakeCodePage(Bitu lin_addr,CodePageHandlerDynRec * &cph,bool * datahot=NULL) {
 	Bit8u rdval;
 	//Ensure page contains memory:
 	if (GCC_UNLIKELY(mem_readb_checked((PhysPt)lin_addr,&rdval))) return true;
@@ -161,6 +165,11 @@ static bool MakeCodePage(Bitu lin_addr,CodePageHandlerDynRec * &cph) {
 		cph=0;
 		return false;
 	}
+	if (datahot && GCC_UNLIKELY(cache_datahot_active(phys_page))) {
+		*datahot=true;
+		cph=0;
+		return false;
+	}
 	// find a free CodePage
 	if (!cache.free_pages) {
 		if (cache.used_pages!=decode.page.code) cache.used_pages->ClearRelease();
@@ -256,10 +265,12 @@ static void INLINE decode_increase_wmapmask(Bitu size) {
 	CacheBlockDynRec* activecb=decode.active_block; 
 	if (GCC_UNLIKELY(!activecb->cache.wmapmask)) {
 		// no mask memory yet allocated, start with a small buffer
-		activecb->cache.wmapmask=(Bit8u*)malloc(START_WMMEM);
-		memset(activecb->cache.wmapmask,0,START_WMMEM);
+		Bitu masklen=START_WMMEM;
+		while (masklen<=size) masklen*=4;	// large skipped areas of traces
+		activecb->cache.wmapmask=(Bit8u*)malloc(masklen);
+		memset(activecb->cache.wmapmask,0,masklen);
 		activecb->cache.maskstart=(Bit16u)decode.page.index;	// start of buffer is current code position
-		activecb->cache.masklen=START_WMMEM;
+		activecb->cache.masklen=(Bit16u)masklen;
 		mapidx=0;
 	} else {
 		mapidx=decode.page.index-activecb->cache.maskstart;
@@ -280,9 +291,20 @@ static void INLINE decode_increase_wmapmask(Bitu size) {
 		case 1 : activecb->cache.wmapmask[mapidx]+=0x01; break;
 		case 2 : (*(Bit16u*)&activecb->cache.wmapmask[mapidx])+=0x0101; break;
 		case 4 : (*(Bit32u*)&activecb->cache.wmapmask[mapidx])+=0x01010101; break;
+		default:
+			for (Bitu i=0;i<size;i++) activecb->cache.wmapmask[mapidx+i]+=0x01;
+			break;
 	}
 }
 
+// skip over a part of the current page that is jumped across inside a trace,
+// the skipped bytes are masked out of the write map as no code depends on them
+static void decode_skip_bytes(Bitu size) {
+	decode_increase_wmapmask(size);
+	decode.code+=(PhysPt)size;
+	decode.page.index+=size;
+}
+
 // fetch a byte, val points to the code location if possible,
 // otherwise val contains the current value read from the position
 static bool decode_fetchb_imm(Bitu & val) {
@@ -503,6 +525,14 @@ static INLINE void dyn_set_eip_end(HostReg reg,Bit32u imm=0) {
 // is architecture dependent
 // R=host register; I=32bit immediate value; A=address value; m=memory
 
+// functions that do not access the general purpose registers in cpu_regs
+// are called through the _pure variants, which a backend that keeps guest
+// registers in host registers (DRC_REGS_CACHE) does not need to write back
+#if !defined(DRC_REGS_CACHE)
+#define gen_call_function_pure gen_call_function_raw
+#define gen_call_function_setup_pure gen_call_function_setup
+#endif
+
 template <typename T> static DRC_PTR_SIZE_IM INLINE gen_call_function_R(const T func,Bitu op) {
     gen_load_param_reg(op,0);
     return gen_call_function_setup(func, 1);
@@ -513,6 +543,11 @@ template <typename T> static DRC_PTR_SIZE_IM INLINE gen_call_function_R3(const T
     return gen_call_function_setup(func, 3, true);
 }
 
+template <typename T> static DRC_PTR_SIZE_IM INLINE gen_call_function_R3_pure(const T func,Bitu op) {
+    gen_load_param_reg(op,2);
+    return gen_call_function_setup_pure(func, 3, true);
+}
+
 template <typename T> static DRC_PTR_SIZE_IM INLINE gen_call_function_RI(const T func,Bitu op1,Bitu op2) {
     gen_load_param_imm(op2,1);
     gen_load_param_reg(op1,0);
@@ -597,7 +632,7 @@ template <typename T> static DRC_PTR_SIZE_IM INLINE gen_call_function_mm(const T
 
 
 
-enum save_info_type {db_exception, cycle_check, string_break};
+enum save_info_type {db_exception, cycle_check, string_break, trace_check};
 
 
 // function that is called on exceptions
@@ -610,6 +645,64 @@ static BlockReturn DynRunException(Bit32u eip_add,Bit32u cycle_sub) {
 }
 
 
+// find the block an indirect near branch continues at when the inline target
+// cache of the running block missed, the cache is pointed to the found block.
+// Near returns first search the return address stack for their target, the
+// calling block remembers the block at its return point (link[2])
+static void dyn_indirect_lookup(bool ret) {
+	CacheBlockDynRec * from=cache.block.running;
+	PhysPt lin=SegPhys(cs)+reg_eip;
+	CodePageHandlerDynRec * handler=(CodePageHandlerDynRec *)get_tlb_readhandler(lin);
+	cache.block.indirect=&indirect_miss_block;
+
+	CacheBlockDynRec * caller=NULL;
+	CacheBlockDynRec * block=NULL;
+	if (ret) {
+		// near returns that hit the inline cache did not pop their entry,
+		// so unwind the stack up to the entry of this return
+		for (Bitu i=0;i<DYN_RAS_SIZE;i++) {
+			Bitu pos=(cache_ras.top-1-i)&(DYN_RAS_SIZE-1);
+			if (cache_ras.entry[pos].caller && (cache_ras.entry[pos].lin==lin)) {
+				caller=cache_ras.entry[pos].caller;
+				cache_ras.entry[pos].caller=NULL;
+				cache_ras.top=pos;
+				break;
+			}
+		}
+		if (caller) {
+			CacheBlockDynRec * retblock=caller->link[2].to;
+			if ((retblock!=&link_blocks[2]) && (retblock->page.handler==handler) &&
+				(retblock->page.start==(lin&4095))) block=retblock;
+		}
+	}
+	if (!block) {
+		if (!(handler->flags & PFLAG_HASCODE)) return;
+		block=handler->FindCacheBlock(lin&4095);
+		if (!block) return;
+		if (caller) {
+			// remember the return point for the next return to this caller
+			caller->Unlink(2);
+			caller->LinkTo(2,block);
+		}
+	}
+	// the running block might have been invalidated by the branch
+	if (from->page.handler) {
+		from->Unlink(0);
+		from->LinkTo(0,block);
+		from->indirect.target=(Bit32u)0-(Bit32u)lin;
+	}
+	cache.block.indirect=block;
+}
+
+static void dyn_indirect_lookup_jmp(void) {
+	dyn_indirect_lookup(false);
+}
+
+static void dyn_indirect_lookup_ret(void) {
+	dyn_indirect_lookup(true);
+}
+
+
 // array with information about code that is generated at the
 // end of a cache block because it is rarely reached (like exceptions)
 static struct {
@@ -657,6 +750,10 @@ static void dyn_fill_blocks(void) {
 				gen_add_direct_word(&reg_eip,save_info_dynrec[sct].eip_change,decode.big_op);
 				dyn_return(BR_Cycles);
 				break;
+			case trace_check:
+				// the block became hot, let the core retranslate it as a trace
+				dyn_return(BR_Trace);
+				break;
 		}
 	}
 	used_save_info_dynrec=0;
@@ -672,6 +769,16 @@ static void dyn_closeblock(void) {
 }
 
 
+// see if the instruction stream of a trace can be continued, the trace
+// has to fit into a single cache block including the code that is
+// generated at its end (see dyn_fill_blocks)
+static bool dyn_trace_room(void) {
+	if (used_save_info_dynrec>=(512-32)) return false;
+	Bitu written=(Bitu)(cache.pos-decode.block->cache.start)+used_save_info_dynrec*64;
+	return (written+1024)<CACHE_MAXSIZE;
+}
+
+
 // add a check that can branch to the exception handling
 static void dyn_check_exception(HostReg reg) {
 	save_info_dynrec[used_save_info_dynrec].branch_pos=gen_create_branch_long_nonzero(reg,false);
@@ -690,9 +797,11 @@ bool DRC_CALL_CONV mem_readb_checked_drc(PhysPt address) DRC_FC;
 bool DRC_CALL_CONV mem_readb_checked_drc(PhysPt address) {
 	HostPt tlb_addr=get_tlb_read(address);
 	if (tlb_addr) {
+		PAGING_TLB_HIT();
 		*((Bit8u*)(&core_dynrec.readdata))=host_readb(tlb_addr+address);
 		return false;
 	} else {
+		PAGING_TLB_MISS();
 		return get_tlb_readhandler(address)->readb_checked(address, (Bit8u*)(&core_dynrec.readdata));
 	}
 }
@@ -701,9 +810,13 @@ bool DRC_CALL_CONV mem_writeb_checked_drc(PhysPt address,Bit8u val) DRC_FC;
 bool DRC_CALL_CONV mem_writeb_checked_drc(PhysPt address,Bit8u val) {
 	HostPt tlb_addr=get_tlb_write(address);
 	if (tlb_addr) {
+		PAGING_TLB_HIT();
 		host_writeb(tlb_addr+address,val);
 		return false;
-	} else return get_tlb_writehandler(address)->writeb_checked(address,val);
+	} else {
+		PAGING_TLB_MISS();
+		return get_tlb_writehandler(address)->writeb_checked(address,val);
+	}
 }
 
 bool DRC_CALL_CONV mem_readw_checked_drc(PhysPt address) DRC_FC;
@@ -711,9 +824,13 @@ bool DRC_CALL_CONV mem_readw_checked_drc(PhysPt address) {
 	if ((address & 0xfff)<0xfff) {
 		HostPt tlb_addr=get_tlb_read(address);
 		if (tlb_addr) {
+			PAGING_TLB_HIT();
 			*((Bit16u*)(&core_dynrec.readdata))=host_readw(tlb_addr+address);
 			return false;
-		} else return get_tlb_readhandler(address)->readw_checked(address, (Bit16u*)(&core_dynrec.readdata));
+		} else {
+			PAGING_TLB_MISS();
+			return get_tlb_readhandler(address)->readw_checked(address, (Bit16u*)(&core_dynrec.readdata));
+		}
 	} else return mem_unalignedreadw_checked(address, ((Bit16u*)(&core_dynrec.readdata)));
 }
 
@@ -722,9 +839,13 @@ bool DRC_CALL_CONV mem_readd_checked_drc(PhysPt address) {
 	if ((address & 0xfff)<0xffd) {
 		HostPt tlb_addr=get_tlb_read(address);
 		if (tlb_addr) {
+			PAGING_TLB_HIT();
 			*((Bit32u*)(&core_dynrec.readdata))=host_readd(tlb_addr+address);
 			return false;
-		} else return get_tlb_readhandler(address)->readd_checked(address, (Bit32u*)(&core_dynrec.readdata));
+		} else {
+			PAGING_TLB_MISS();
+			return get_tlb_readhandler(address)->readd_checked(address, (Bit32u*)(&core_dynrec.readdata));
+		}
 	} else return mem_unalignedreadd_checked(address, ((Bit32u*)(&core_dynrec.readdata)));
 }
 
@@ -733,9 +854,13 @@ bool DRC_CALL_CONV mem_writew_checked_drc(PhysPt address,Bit16u val) {
 	if ((address & 0xfff)<0xfff) {
 		HostPt tlb_addr=get_tlb_write(address);
 		if (tlb_addr) {
+			PAGING_TLB_HIT();
 			host_writew(tlb_addr+address,val);
 			return false;
-		} else return get_tlb_writehandler(address)->writew_checked(address,val);
+		} else {
+			PAGING_TLB_MISS();
+			return get_tlb_writehandler(address)->writew_checked(address,val);
+		}
 	} else return mem_unalignedwritew_checked(address,val);
 }
 
@@ -744,25 +869,53 @@ bool DRC_CALL_CONV mem_writed_checked_drc(PhysPt address,Bit32u val) {
 	if ((address & 0xfff)<0xffd) {
 		HostPt tlb_addr=get_tlb_write(address);
 		if (tlb_addr) {
+			PAGING_TLB_HIT();
 			host_writed(tlb_addr+address,val);
 			return false;
-		} else return get_tlb_writehandler(address)->writed_checked(address,val);
+		} else {
+			PAGING_TLB_MISS();
+			return get_tlb_writehandler(address)->writed_checked(address,val);
+		}
 	} else return mem_unalignedwrited_checked(address,val);
 }
 
 
 // functions that enable access to the memory
 
+// call the memory access function func with the address in FC_OP1 (and the value
+// in FC_OP2 for writes), where the backend supports it pages that have a host
+// pointer in the tlb are accessed directly and the call is only done for the others
+template <typename T> static void dyn_call_mem_function(const T func,bool write,Bitu size) {
+#if defined(DRC_TLB_INLINE) && defined(USE_FULL_TLB)
+	HostPt * tlb=write ? paging.tlb.write : paging.tlb.read;
+	if (gen_tlb_inline_possible(tlb)) {
+#if defined(PAGING_TLB_STATS)
+		Bit64u * hits=&paging.stats.hits;
+#else
+		Bit64u * hits=NULL;
+#endif
+		DRC_PTR_SIZE_IM done=gen_tlb_access(FC_OP1,FC_OP2,tlb,size,write,&core_dynrec.readdata,hits);
+		gen_call_function_raw(func);
+		gen_fill_branch(done);
+		return;
+	}
+#else
+	(void)write;
+	(void)size;
+#endif
+	gen_call_function_raw(func);
+}
+
 // read a byte from a given address and store it in reg_dst
 static void dyn_read_byte(HostReg reg_addr,HostReg reg_dst) {
 	gen_mov_regs(FC_OP1,reg_addr);
-	gen_call_function_raw(mem_readb_checked_drc);
+	dyn_call_mem_function(mem_readb_checked_drc,false,1);
 	dyn_check_exception(FC_RETOP);
 	gen_mov_byte_to_reg_low(reg_dst,&core_dynrec.readdata);
 }
 static void dyn_read_byte_canuseword(HostReg reg_addr,HostReg reg_dst) {
 	gen_mov_regs(FC_OP1,reg_addr);
-	gen_call_function_raw(mem_readb_checked_drc);
+	dyn_call_mem_function(mem_readb_checked_drc,false,1);
 	dyn_check_exception(FC_RETOP);
 	gen_mov_byte_to_reg_low_canuseword(reg_dst,&core_dynrec.readdata);
 }
@@ -771,7 +924,7 @@ static void dyn_read_byte_canuseword(HostReg reg_addr,HostReg reg_dst) {
 static void dyn_write_byte(HostReg reg_addr,HostReg reg_val) {
 	gen_mov_regs(FC_OP2,reg_val);
 	gen_mov_regs(FC_OP1,reg_addr);
-	gen_call_function_raw(mem_writeb_checked_drc);
+	dyn_call_mem_function(mem_writeb_checked_drc,true,1);
 	dyn_check_exception(FC_RETOP);
 }
 
@@ -779,8 +932,8 @@ static void dyn_write_byte(HostReg reg_addr,HostReg reg_val) {
 // from a given address and store it in reg_dst
 static void dyn_read_word(HostReg reg_addr,HostReg reg_dst,bool dword) {
 	gen_mov_regs(FC_OP1,reg_addr);
-	if (dword) gen_call_function_raw(mem_readd_checked_drc);
-	else gen_call_function_raw(mem_readw_checked_drc);
+	if (dword) dyn_call_mem_function(mem_readd_checked_drc,false,4);
+	else dyn_call_mem_function(mem_readw_checked_drc,false,2);
 	dyn_check_exception(FC_RETOP);
 	gen_mov_word_to_reg(reg_dst,&core_dynrec.readdata,dword);
 }
@@ -791,13 +944,14 @@ static void dyn_write_word(HostReg reg_addr,HostReg reg_val,bool dword) {
 //	if (!dword) gen_extend_word(false,reg_val);
 	gen_mov_regs(FC_OP2,reg_val);
 	gen_mov_regs(FC_OP1,reg_addr);
-	if (dword) gen_call_function_raw(mem_writed_checked_drc);
-	else gen_call_function_raw(mem_writew_checked_drc);
+	if (dword) dyn_call_mem_function(mem_writed_checked_drc,true,4);
+	else dyn_call_mem_function(mem_writew_checked_drc,true,2);
 	dyn_check_exception(FC_RETOP);
 }
 
 
 
+#if !defined(DRC_USE_REGS_ADDR)
 // effective address calculation helper, op2 has to be present!
 // loads op1 into ea_reg and adds the scaled op2 and the immediate to it
 static void dyn_lea_mem_mem(HostReg ea_reg,void* op1,void* op2,Bitu scale,Bits imm) {
@@ -816,6 +970,7 @@ static void dyn_lea_mem_mem(HostReg ea_reg,void* op1,void* op2,Bitu scale,Bits i
 		if (op1!=NULL) gen_add(ea_reg,op1);
 	}
 }
+#endif
 
 #ifdef DRC_USE_REGS_ADDR
 // effective address calculation helper
@@ -1202,6 +1357,10 @@ static struct {
 	Bitu ftype;
 } mf_functions[64];
 
+static struct {
+	Bitu eliminated;		// flag generating functions that have been replaced
+} mf_stats;
+
 static void InitFlagsOptimization(void) {
 	mf_functions_num=0;
 }
@@ -1214,6 +1373,7 @@ static void InvalidateFlags(void) {
 	for (Bitu ct=0; ct<mf_functions_num; ct++) {
 		gen_fill_function_ptr(mf_functions[ct].pos,mf_functions[ct].fct_ptr,mf_functions[ct].ftype);
 	}
+	mf_stats.eliminated+=mf_functions_num;
 	mf_functions_num=0;
 #endif
 }
@@ -1226,6 +1386,7 @@ template <typename T> static void InvalidateFlags(const T current_simple_functio
 	for (Bitu ct=0; ct<mf_functions_num; ct++) {
 		gen_fill_function_ptr(mf_functions[ct].pos,mf_functions[ct].fct_ptr,mf_functions[ct].ftype);
 	}
+	mf_stats.eliminated+=mf_functions_num;
 	mf_functions_num=1;
 	mf_functions[0].pos=cache.pos;
 	mf_functions[0].fct_ptr=reinterpret_cast<void*>((uintptr_t)current_simple_function);
@@ -1238,6 +1399,8 @@ template <typename T> static void InvalidateFlags(const T current_simple_functio
 // this function can be replaced by a simpler one as well
 template <typename T> static void InvalidateFlagsPartially(const T current_simple_function,Bitu flags_type) {
 #ifdef DRC_FLAGS_INVALIDATION
+	// queue full (long traces), keep the flags generating function
+	if (GCC_UNLIKELY(mf_functions_num>=64)) return;
 	mf_functions[mf_functions_num].pos=cache.pos;
 	mf_functions[mf_functions_num].fct_ptr=reinterpret_cast<void*>((uintptr_t)current_simple_function);
 	mf_functions[mf_functions_num].ftype=flags_type;
@@ -1250,6 +1413,7 @@ template <typename T> static void InvalidateFlagsPartially(const T current_simpl
 // this function can be replaced by a simpler one as well
 template <typename T> static void InvalidateFlagsPartially(const T current_simple_function,DRC_PTR_SIZE_IM cpos,Bitu flags_type) {
 #ifdef DRC_FLAGS_INVALIDATION
+	if (GCC_UNLIKELY(mf_functions_num>=64)) return;
 	mf_functions[mf_functions_num].pos=(Bit8u*)cpos;
 	mf_functions[mf_functions_num].fct_ptr=reinterpret_cast<void*>((uintptr_t)current_simple_function);
 	mf_functions[mf_functions_num].ftype=flags_type;
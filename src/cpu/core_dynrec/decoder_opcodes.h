@@ -540,8 +540,8 @@ static void dyn_imul_gvev(Bitu immsize) {
 			break;
 	}
 
-	if (decode.big_op) gen_call_function_raw(dynrec_dimul_dword);
-	else gen_call_function_raw(dynrec_dimul_word);
+	if (decode.big_op) gen_call_function_pure(dynrec_dimul_dword);
+	else gen_call_function_pure(dynrec_dimul_word);
 
 	MOV_REG_WORD_FROM_HOST_REG(FC_RETOP,decode.modrm.reg,decode.big_op);
 }
@@ -853,15 +853,15 @@ static Bitu dyn_grp4_ev(void) {
 		gen_protect_addr_reg();
 		gen_mov_word_to_reg(FC_OP1,decode.big_op?(void*)(&reg_eip):(void*)(&reg_ip),decode.big_op);
 		gen_add_imm(FC_OP1,(Bit32u)(decode.code-decode.code_start));
-		if (decode.big_op) gen_call_function_raw(dynrec_push_dword);
-		else gen_call_function_raw(dynrec_push_word);
+		if (decode.big_op) gen_call_function_raw(dynrec_call_push_dword);
+		else gen_call_function_raw(dynrec_call_push_word);
 
 		gen_restore_addr_reg();
 		gen_mov_word_from_reg(FC_ADDR,decode.big_op?(void*)(&reg_eip):(void*)(&reg_ip),decode.big_op);
-		return 1;
+		return 3;
 	case 0x4:	// JMP Ev
 		gen_mov_word_from_reg(FC_OP1,decode.big_op?(void*)(&reg_eip):(void*)(&reg_ip),decode.big_op);
-		return 1;
+		return 3;
 	case 0x3:	// CALL Ep
 	case 0x5:	// JMP Ep
 		if (!decode.big_op) gen_extend_word(false,FC_OP1);
@@ -1103,6 +1103,28 @@ static void dyn_exit_link(Bit32s eip_change) {
 	dyn_closeblock();
 }
 
+// see if a trace can continue at the target of a jump instead of exiting the block,
+// only forward jumps inside the current page are followed
+static bool dyn_trace_can_follow(Bit32s eip_change) {
+	if (!decode.trace || (eip_change<=0)) return false;
+	if ((decode.page.index+(Bitu)eip_change)>=4096) return false;
+	if (decode.big_op!=cpu.code.big) return false;
+	// the trace is translated at the current cs:eip, 16bit code must not wrap around
+	if (!decode.big_op && ((reg_eip+(decode.code-decode.code_start)+(Bit32u)eip_change)>0xffff)) return false;
+	return true;
+}
+
+// unconditional jump, returns true if the block has been closed
+static bool dyn_jmp_link(Bit32s eip_change) {
+	if (dyn_trace_can_follow(eip_change)) {
+		// continue the trace at the jump target
+		decode_skip_bytes((Bitu)eip_change);
+		return false;
+	}
+	dyn_exit_link(eip_change);
+	return true;
+}
+
 
 static void dyn_branched_exit(BranchTypes btype,Bit32s eip_add) {
 	Bit32u eip_base=decode.code-decode.code_start;
@@ -1186,6 +1208,20 @@ static void dyn_loop(LoopTypes type) {
 }
 
 
+// continue at cs:eip after an indirect near branch, the block the branch went
+// to the last time is checked first (inline target cache of the block)
+static void dyn_branch_indirect(bool ret) {
+	gen_mov_word_to_reg(FC_OP1,&reg_eip,true);
+	ADD_SEG_PHYS_TO_HOST_REG(FC_OP1,DRC_SEG_CS);
+	gen_add(FC_OP1,&decode.block->indirect.target);
+	DRC_PTR_SIZE_IM no_hit=gen_create_branch_on_nonzero(FC_OP1,true);
+	gen_jmp_ptr(&decode.block->link[0].to,offsetof(CacheBlockDynRec,cache.start));
+	gen_fill_branch(no_hit);
+	if (ret) gen_call_function_raw(dyn_indirect_lookup_ret);
+	else gen_call_function_raw(dyn_indirect_lookup_jmp);
+	gen_jmp_ptr(&cache.block.indirect,offsetof(CacheBlockDynRec,cache.start));
+}
+
 static void dyn_ret_near(Bit16u bytes) {
 	dyn_reduce_cycles();
 
@@ -1197,17 +1233,24 @@ static void dyn_ret_near(Bit16u bytes) {
 	gen_mov_word_from_reg(FC_RETOP,decode.big_op?(void*)(&reg_eip):(void*)(&reg_ip),true);
 
 	if (bytes) gen_add_direct_word(&reg_esp,bytes,true);
-	dyn_return(BR_Normal);
+	dyn_branch_indirect(true);
 	dyn_closeblock();
 }
 
-static void dyn_call_near_imm(void) {
+// returns true if the block has been closed
+static bool dyn_call_near_imm(void) {
 	Bit32s imm;
 	if (decode.big_op) imm=(Bit32s)decode_fetchd();
 	else imm=(Bit16s)decode_fetchw();
 	dyn_set_eip_end(FC_OP1);
-	if (decode.big_op) gen_call_function_raw(dynrec_push_dword);
-	else gen_call_function_raw(dynrec_push_word);
+	if (decode.big_op) gen_call_function_raw(dynrec_call_push_dword);
+	else gen_call_function_raw(dynrec_call_push_word);
+
+	if (dyn_trace_can_follow(imm)) {
+		// continue the trace inside the called function
+		decode_skip_bytes((Bitu)imm);
+		return false;
+	}
 
 	dyn_set_eip_end(FC_OP1,imm);
 	gen_mov_word_from_reg(FC_OP1,decode.big_op?(void*)(&reg_eip):(void*)(&reg_ip),decode.big_op);
@@ -1215,6 +1258,7 @@ static void dyn_call_near_imm(void) {
 	dyn_reduce_cycles();
 	gen_jmp_ptr(&decode.block->link[0].to,offsetof(CacheBlockDynRec,cache.start));
 	dyn_closeblock();
+	return true;
 }
 
 static void dyn_ret_far(Bitu bytes) {
@@ -55,6 +55,150 @@ static void FPU_FFREE(Bitu st) {
 #endif
 
 
+// use inline host fpu code for the common operations where the backend
+// supports it, otherwise (or if disabled by the "dynamic core fast fpu"
+// setting) the helper functions are called for every instruction
+static bool dyn_fpu_fast=true;
+
+// second opcode byte of the popping host instruction that does
+// st(1)=st(0) OP st(1) with op1 in st(0) and op2 in st(1)
+#define FPU_NATIVE_ADD		0xc1	// faddp  st(1),st(0)
+#define FPU_NATIVE_MUL		0xc9	// fmulp  st(1),st(0)
+#define FPU_NATIVE_SUB		0xe1	// fsubrp st(1),st(0)
+#define FPU_NATIVE_SUBR		0xe9	// fsubp  st(1),st(0)
+#define FPU_NATIVE_DIV		0xf1	// fdivrp st(1),st(0)
+#define FPU_NATIVE_DIVR		0xf9	// fdivp  st(1),st(0)
+
+#if defined(DRC_FPU_NATIVE) && C_FPU_X86
+/*
+	The x86 fpu core keeps the fpu registers as 80bit images of the host
+	fpu in fpu.p_regs, so the host fpu can work on them directly. Like
+	the helper functions the generated code switches to the guest control
+	word (with all exceptions masked) for the calculations, so precision
+	and rounding control apply. The host exception flags are cleared before
+	every operation and added to the status word along with the condition
+	codes, so the exception flags accumulate as with the helpers.
+*/
+#define DYN_FPU_NATIVE
+
+// the control word of the host fpu while the guest control word is loaded
+static Bit16u dyn_fpu_host_cw;
+
+static INLINE bool dyn_fpu_native(void) {
+	return dyn_fpu_fast && gen_fpu_native_possible((void*)&fpu);
+}
+
+// the operation on st(0) and st(1), the status word is updated like the helpers do
+static void dyn_fpu_native_arith_op(Bit8u op) {
+	gen_fpu_save_cw((void*)&dyn_fpu_host_cw);
+	gen_fpu_load_cw((void*)&fpu.cw_mask_all);
+	gen_fpu_clear_exceptions();
+	gen_fpu_arith_pop(op);
+	gen_fpu_status_to_sw((void*)&fpu.sw,0x02bf,0x0200);
+	gen_fpu_load_cw((void*)&dyn_fpu_host_cw);
+}
+
+// p_regs[FC_OP1]=p_regs[FC_OP1] OP p_regs[FC_OP2]
+static void dyn_fpu_native_arith(Bit8u op) {
+	gen_fpu_index(FC_OP1);
+	gen_fpu_index(FC_OP2);
+	gen_fpu_load_ext(FC_OP2,(void*)fpu.p_regs);
+	gen_fpu_load_ext(FC_OP1,(void*)fpu.p_regs);
+	dyn_fpu_native_arith_op(op);
+	gen_fpu_store_ext_pop(FC_OP1,(void*)fpu.p_regs);
+}
+
+// same with the memory operand that the FPU_FLD_*_EA helpers leave on the host fpu stack
+static void dyn_fpu_native_arith_ea(Bit8u op) {
+	gen_fpu_index(FC_OP1);
+	gen_fpu_load_ext(FC_OP1,(void*)fpu.p_regs);
+	dyn_fpu_native_arith_op(op);
+	gen_fpu_store_ext_pop(FC_OP1,(void*)fpu.p_regs);
+}
+
+// compare p_regs[FC_OP1] with p_regs[FC_OP2] and set the condition codes
+static void dyn_fpu_native_compare(void) {
+	gen_fpu_index(FC_OP1);
+	gen_fpu_index(FC_OP2);
+	gen_fpu_load_ext(FC_OP2,(void*)fpu.p_regs);
+	gen_fpu_load_ext(FC_OP1,(void*)fpu.p_regs);
+	gen_fpu_clear_exceptions();
+	gen_fpu_compare_pop2();
+	gen_fpu_status_to_sw((void*)&fpu.sw,0x47bf,0x4700);
+}
+
+// same with the memory operand that the FPU_FLD_*_EA helpers leave on the host fpu stack
+static void dyn_fpu_native_compare_ea(void) {
+	gen_fpu_index(FC_OP1);
+	gen_fpu_load_ext(FC_OP1,(void*)fpu.p_regs);
+	gen_fpu_clear_exceptions();
+	gen_fpu_compare_pop2();
+	gen_fpu_status_to_sw((void*)&fpu.sw,0x47bf,0x4700);
+}
+
+// p_regs[FC_OP2]=p_regs[FC_OP1] including the tag
+static void dyn_fpu_native_copy(void) {
+	gen_fpu_tag_to_reg(FC_RETOP,FC_OP1,(void*)fpu.tags);
+	gen_fpu_tag_from_reg(FC_RETOP,FC_OP2,(void*)fpu.tags);
+	gen_fpu_index(FC_OP1);
+	gen_fpu_index(FC_OP2);
+	gen_fpu_load_ext(FC_OP1,(void*)fpu.p_regs);
+	gen_fpu_store_ext_pop(FC_OP2,(void*)fpu.p_regs);
+	gen_fpu_clear_sw((void*)&fpu.sw,0x0200);
+}
+
+static void dyn_fpu_native_pop(void) {
+	gen_mov_word_to_reg(FC_OP1,(void*)(&TOP),true);
+	gen_fpu_tag_imm(FC_OP1,(void*)fpu.tags,TAG_Empty);
+	gen_add_imm(FC_OP1,1);
+	gen_and_imm(FC_OP1,7);
+	gen_mov_word_from_reg(FC_OP1,(void*)(&TOP),true);
+}
+#endif
+
+// arithmetic operation on the registers FC_OP1 and FC_OP2
+static void dyn_fpu_arith(void (*func)(Bitu,Bitu),Bit8u native_op) {
+#if defined(DYN_FPU_NATIVE)
+	if (dyn_fpu_native()) {
+		dyn_fpu_native_arith(native_op);
+		return;
+	}
+#endif
+	gen_call_function_RR(func,FC_OP1,FC_OP2);
+}
+
+// FCOM on the registers FC_OP1 and FC_OP2
+static void dyn_fpu_compare(void) {
+#if defined(DYN_FPU_NATIVE)
+	if (dyn_fpu_native()) {
+		dyn_fpu_native_compare();
+		return;
+	}
+#endif
+	gen_call_function_RR(FPU_FCOM,FC_OP1,FC_OP2);
+}
+
+// FST from register FC_OP1 to register FC_OP2
+static void dyn_fpu_copy(void) {
+#if defined(DYN_FPU_NATIVE)
+	if (dyn_fpu_native()) {
+		dyn_fpu_native_copy();
+		return;
+	}
+#endif
+	gen_call_function_RR(FPU_FST,FC_OP1,FC_OP2);
+}
+
+static void dyn_fpu_pop(void) {
+#if defined(DYN_FPU_NATIVE)
+	if (dyn_fpu_native()) {
+		dyn_fpu_native_pop();
+		return;
+	}
+#endif
+	gen_call_function_raw(FPU_FPOP);
+}
+
 static INLINE void dyn_fpu_top() {
 	gen_mov_word_to_reg(FC_OP2,(void*)(&TOP),true);
 	gen_add_imm(FC_OP2,decode.modrm.rm);
@@ -72,6 +216,17 @@ static INLINE void dyn_fpu_top_swapped() {
 static void dyn_eatree() {
 //	Bitu group = (decode.modrm.val >> 3) & 7;
 	Bitu group = decode.modrm.reg&7; //It is already that, but compilers.
+#if defined(DYN_FPU_NATIVE)
+	if (dyn_fpu_native()) {
+		static const Bit8u native_ops[8]={FPU_NATIVE_ADD,FPU_NATIVE_MUL,0,0,
+			FPU_NATIVE_SUB,FPU_NATIVE_SUBR,FPU_NATIVE_DIV,FPU_NATIVE_DIVR};
+		if (group==0x02 || group==0x03) {	// FCOM/FCOMP
+			dyn_fpu_native_compare_ea();
+			if (group==0x03) dyn_fpu_native_pop();
+		} else dyn_fpu_native_arith_ea(native_ops[group]);
+		return;
+	}
+#endif
 	switch (group){
 	case 0x00:		// FADD ST,STi
 		gen_call_function_R(FPU_FADD_EA,FC_OP1);
@@ -84,7 +239,7 @@ static void dyn_eatree() {
 		break;
 	case 0x03:		// FCOMP STi
 		gen_call_function_R(FPU_FCOM_EA,FC_OP1);
-		gen_call_function_raw(FPU_FPOP);
+		dyn_fpu_pop();
 		break;
 	case 0x04:		// FSUB  ST,STi
 		gen_call_function_R(FPU_FSUB_EA,FC_OP1);
@@ -110,29 +265,29 @@ static void dyn_fpu_esc0(){
 		dyn_fpu_top();
 		switch (decode.modrm.reg){
 		case 0x00:		//FADD ST,STi
-			gen_call_function_RR(FPU_FADD,FC_OP1,FC_OP2);
+			dyn_fpu_arith(FPU_FADD,FPU_NATIVE_ADD);
 			break;
 		case 0x01:		// FMUL  ST,STi
-			gen_call_function_RR(FPU_FMUL,FC_OP1,FC_OP2);
+			dyn_fpu_arith(FPU_FMUL,FPU_NATIVE_MUL);
 			break;
 		case 0x02:		// FCOM  STi
-			gen_call_function_RR(FPU_FCOM,FC_OP1,FC_OP2);
+			dyn_fpu_compare();
 			break;
 		case 0x03:		// FCOMP STi
-			gen_call_function_RR(FPU_FCOM,FC_OP1,FC_OP2);
-			gen_call_function_raw(FPU_FPOP);
+			dyn_fpu_compare();
+			dyn_fpu_pop();
 			break;
 		case 0x04:		// FSUB  ST,STi
-			gen_call_function_RR(FPU_FSUB,FC_OP1,FC_OP2);
+			dyn_fpu_arith(FPU_FSUB,FPU_NATIVE_SUB);
 			break;	
 		case 0x05:		// FSUBR ST,STi
-			gen_call_function_RR(FPU_FSUBR,FC_OP1,FC_OP2);
+			dyn_fpu_arith(FPU_FSUBR,FPU_NATIVE_SUBR);
 			break;
 		case 0x06:		// FDIV  ST,STi
-			gen_call_function_RR(FPU_FDIV,FC_OP1,FC_OP2);
+			dyn_fpu_arith(FPU_FDIV,FPU_NATIVE_DIV);
 			break;
 		case 0x07:		// FDIVR ST,STi
-			gen_call_function_RR(FPU_FDIVR,FC_OP1,FC_OP2);
+			dyn_fpu_arith(FPU_FDIVR,FPU_NATIVE_DIVR);
 			break;
 		default:
 			break;
@@ -155,11 +310,22 @@ static void dyn_fpu_esc1(){
 			gen_mov_word_to_reg(FC_OP1,(void*)(&TOP),true);
 			gen_add_imm(FC_OP1,decode.modrm.rm);
 			gen_and_imm(FC_OP1,7);
+#if defined(DYN_FPU_NATIVE)
+			if (dyn_fpu_native()) {
+				// FPU_PREP_PUSH, the tag is copied from the source register
+				gen_mov_word_to_reg(FC_OP2,(void*)(&TOP),true);
+				gen_add_imm(FC_OP2,7);
+				gen_and_imm(FC_OP2,7);
+				gen_mov_word_from_reg(FC_OP2,(void*)(&TOP),true);
+				dyn_fpu_native_copy();
+				break;
+			}
+#endif
 			gen_protect_reg(FC_OP1);
 			gen_call_function_raw(FPU_PREP_PUSH); 
 			gen_mov_word_to_reg(FC_OP2,(void*)(&TOP),true);
 			gen_restore_reg(FC_OP1);
-			gen_call_function_RR(FPU_FST,FC_OP1,FC_OP2);
+			dyn_fpu_copy();
 			break;
 		case 0x01: /* FXCH STi */
 			dyn_fpu_top();
@@ -170,8 +336,8 @@ static void dyn_fpu_esc1(){
 			break;
 		case 0x03: /* FSTP STi */
 			dyn_fpu_top();
-			gen_call_function_RR(FPU_FST,FC_OP1,FC_OP2);
-			gen_call_function_raw(FPU_FPOP);
+			dyn_fpu_copy();
+			dyn_fpu_pop();
 			break;   
 		case 0x04:
 			switch(decode.modrm.rm){
@@ -309,7 +475,7 @@ static void dyn_fpu_esc1(){
 		case 0x03: /* FSTP float*/
 			dyn_fill_ea(FC_ADDR);
 			gen_call_function_R(FPU_FST_F32,FC_ADDR);
-			gen_call_function_raw(FPU_FPOP);
+			dyn_fpu_pop();
 			break;
 		case 0x04: /* FLDENV */
 			dyn_fill_ea(FC_ADDR);
@@ -347,8 +513,8 @@ static void dyn_fpu_esc2(){
 				gen_and_imm(FC_OP2,7);
 				gen_mov_word_to_reg(FC_OP1,(void*)(&TOP),true);
 				gen_call_function_RR(FPU_FUCOM,FC_OP1,FC_OP2);
-				gen_call_function_raw(FPU_FPOP);
-				gen_call_function_raw(FPU_FPOP);
+				dyn_fpu_pop();
+				dyn_fpu_pop();
 				break;
 			default:
 				LOG(LOG_FPU,LOG_WARN)("ESC 2:Unhandled group %d subfunction %d",(unsigned int)decode.modrm.reg,(unsigned int)decode.modrm.rm); 
@@ -414,7 +580,7 @@ static void dyn_fpu_esc3(){
 		case 0x03:	/* FISTP */
 			dyn_fill_ea(FC_ADDR); 
 			gen_call_function_R(FPU_FST_I32,FC_ADDR);
-			gen_call_function_raw(FPU_FPOP);
+			dyn_fpu_pop();
 			break;
 		case 0x05:	/* FLD 80 Bits Real */
 			gen_call_function_raw(FPU_PREP_PUSH);
@@ -424,7 +590,7 @@ static void dyn_fpu_esc3(){
 		case 0x07:	/* FSTP 80 Bits Real */
 			dyn_fill_ea(FC_ADDR); 
 			gen_call_function_R(FPU_FST_F80,FC_ADDR);
-			gen_call_function_raw(FPU_FPOP);
+			dyn_fpu_pop();
 			break;
 		default:
 			LOG(LOG_FPU,LOG_WARN)("ESC 3 EA:Unhandled group %d subfunction %d",(unsigned int)decode.modrm.reg,(unsigned int)decode.modrm.rm);
@@ -439,36 +605,36 @@ static void dyn_fpu_esc4(){
 		switch(decode.modrm.reg){
 		case 0x00:	/* FADD STi,ST*/
 			dyn_fpu_top_swapped();
-			gen_call_function_RR(FPU_FADD,FC_OP1,FC_OP2);
+			dyn_fpu_arith(FPU_FADD,FPU_NATIVE_ADD);
 			break;
 		case 0x01:	/* FMUL STi,ST*/
 			dyn_fpu_top_swapped();
-			gen_call_function_RR(FPU_FMUL,FC_OP1,FC_OP2);
+			dyn_fpu_arith(FPU_FMUL,FPU_NATIVE_MUL);
 			break;
 		case 0x02:  /* FCOM*/
 			dyn_fpu_top();
-			gen_call_function_RR(FPU_FCOM,FC_OP1,FC_OP2);
+			dyn_fpu_compare();
 			break;
 		case 0x03:  /* FCOMP*/
 			dyn_fpu_top();
-			gen_call_function_RR(FPU_FCOM,FC_OP1,FC_OP2);
-			gen_call_function_raw(FPU_FPOP);
+			dyn_fpu_compare();
+			dyn_fpu_pop();
 			break;
 		case 0x04:  /* FSUBR STi,ST*/
 			dyn_fpu_top_swapped();
-			gen_call_function_RR(FPU_FSUBR,FC_OP1,FC_OP2);
+			dyn_fpu_arith(FPU_FSUBR,FPU_NATIVE_SUBR);
 			break;
 		case 0x05:  /* FSUB  STi,ST*/
 			dyn_fpu_top_swapped();
-			gen_call_function_RR(FPU_FSUB,FC_OP1,FC_OP2);
+			dyn_fpu_arith(FPU_FSUB,FPU_NATIVE_SUB);
 			break;
 		case 0x06:  /* FDIVR STi,ST*/
 			dyn_fpu_top_swapped();
-			gen_call_function_RR(FPU_FDIVR,FC_OP1,FC_OP2);
+			dyn_fpu_arith(FPU_FDIVR,FPU_NATIVE_DIVR);
 			break;
 		case 0x07:  /* FDIV STi,ST*/
 			dyn_fpu_top_swapped();
-			gen_call_function_RR(FPU_FDIV,FC_OP1,FC_OP2);
+			dyn_fpu_arith(FPU_FDIV,FPU_NATIVE_DIV);
 			break;
 		default:
 			break;
@@ -494,18 +660,18 @@ static void dyn_fpu_esc5(){
 			gen_call_function_RR(FPU_FXCH,FC_OP1,FC_OP2);
 			break;
 		case 0x02: /* FST STi */
-			gen_call_function_RR(FPU_FST,FC_OP1,FC_OP2);
+			dyn_fpu_copy();
 			break;
 		case 0x03:  /* FSTP STi*/
-			gen_call_function_RR(FPU_FST,FC_OP1,FC_OP2);
-			gen_call_function_raw(FPU_FPOP);
+			dyn_fpu_copy();
+			dyn_fpu_pop();
 			break;
 		case 0x04:	/* FUCOM STi */
 			gen_call_function_RR(FPU_FUCOM,FC_OP1,FC_OP2);
 			break;
 		case 0x05:	/*FUCOMP STi */
 			gen_call_function_RR(FPU_FUCOM,FC_OP1,FC_OP2);
-			gen_call_function_raw(FPU_FPOP);
+			dyn_fpu_pop();
 			break;
 		default:
 			LOG(LOG_FPU,LOG_WARN)("ESC 5:Unhandled group %d subfunction %d",(unsigned int)decode.modrm.reg,(unsigned int)decode.modrm.rm);
@@ -529,7 +695,7 @@ static void dyn_fpu_esc5(){
 		case 0x03:	/* FSTP double real*/
 			dyn_fill_ea(FC_ADDR); 
 			gen_call_function_R(FPU_FST_F64,FC_ADDR);
-			gen_call_function_raw(FPU_FPOP);
+			dyn_fpu_pop();
 			break;
 		case 0x04:	/* FRSTOR */
 			dyn_fill_ea(FC_ADDR); 
@@ -559,15 +725,15 @@ static void dyn_fpu_esc6(){
 		switch(decode.modrm.reg){
 		case 0x00:	/*FADDP STi,ST*/
 			dyn_fpu_top_swapped();
-			gen_call_function_RR(FPU_FADD,FC_OP1,FC_OP2);
+			dyn_fpu_arith(FPU_FADD,FPU_NATIVE_ADD);
 			break;
 		case 0x01:	/* FMULP STi,ST*/
 			dyn_fpu_top_swapped();
-			gen_call_function_RR(FPU_FMUL,FC_OP1,FC_OP2);
+			dyn_fpu_arith(FPU_FMUL,FPU_NATIVE_MUL);
 			break;
 		case 0x02:  /* FCOMP5*/
 			dyn_fpu_top();
-			gen_call_function_RR(FPU_FCOM,FC_OP1,FC_OP2);
+			dyn_fpu_compare();
 			break;	/* TODO IS THIS ALLRIGHT ????????? */
 		case 0x03:  /*FCOMPP*/
 			if(decode.modrm.rm != 1) {
@@ -578,29 +744,29 @@ static void dyn_fpu_esc6(){
 			gen_add_imm(FC_OP2,1);
 			gen_and_imm(FC_OP2,7);
 			gen_mov_word_to_reg(FC_OP1,(void*)(&TOP),true);
-			gen_call_function_RR(FPU_FCOM,FC_OP1,FC_OP2);
-			gen_call_function_raw(FPU_FPOP); /* extra pop at the bottom*/
+			dyn_fpu_compare();
+			dyn_fpu_pop(); /* extra pop at the bottom*/
 			break;
 		case 0x04:  /* FSUBRP STi,ST*/
 			dyn_fpu_top_swapped();
-			gen_call_function_RR(FPU_FSUBR,FC_OP1,FC_OP2);
+			dyn_fpu_arith(FPU_FSUBR,FPU_NATIVE_SUBR);
 			break;
 		case 0x05:  /* FSUBP  STi,ST*/
 			dyn_fpu_top_swapped();
-			gen_call_function_RR(FPU_FSUB,FC_OP1,FC_OP2);
+			dyn_fpu_arith(FPU_FSUB,FPU_NATIVE_SUB);
 			break;
 		case 0x06:	/* FDIVRP STi,ST*/
 			dyn_fpu_top_swapped();
-			gen_call_function_RR(FPU_FDIVR,FC_OP1,FC_OP2);
+			dyn_fpu_arith(FPU_FDIVR,FPU_NATIVE_DIVR);
 			break;
 		case 0x07:  /* FDIVP STi,ST*/
 			dyn_fpu_top_swapped();
-			gen_call_function_RR(FPU_FDIV,FC_OP1,FC_OP2);
+			dyn_fpu_arith(FPU_FDIV,FPU_NATIVE_DIV);
 			break;
 		default:
 			break;
 		}
-		gen_call_function_raw(FPU_FPOP);		
+		dyn_fpu_pop();		
 	} else {
 		dyn_fill_ea(FC_ADDR);
 		gen_call_function_R(FPU_FLD_I16_EA,FC_ADDR); 
@@ -617,7 +783,7 @@ static void dyn_fpu_esc7(){
 		case 0x00: /* FFREEP STi */
 			dyn_fpu_top();
 			gen_call_function_R(FPU_FFREE,FC_OP2);
-			gen_call_function_raw(FPU_FPOP);
+			dyn_fpu_pop();
 			break;
 		case 0x01: /* FXCH STi*/
 			dyn_fpu_top();
@@ -626,8 +792,8 @@ static void dyn_fpu_esc7(){
 		case 0x02:  /* FSTP STi*/
 		case 0x03:  /* FSTP STi*/
 			dyn_fpu_top();
-			gen_call_function_RR(FPU_FST,FC_OP1,FC_OP2);
-			gen_call_function_raw(FPU_FPOP);
+			dyn_fpu_copy();
+			dyn_fpu_pop();
 			break;
 		case 0x04:
 			switch(decode.modrm.rm){
@@ -664,7 +830,7 @@ static void dyn_fpu_esc7(){
 		case 0x03:	/* FISTP Bit16s */
 			dyn_fill_ea(FC_ADDR); 
 			gen_call_function_R(FPU_FST_I16,FC_ADDR);
-			gen_call_function_raw(FPU_FPOP);
+			dyn_fpu_pop();
 			break;
 		case 0x04:   /* FBLD packed BCD */
 			gen_call_function_raw(FPU_PREP_PUSH);
@@ -681,12 +847,12 @@ static void dyn_fpu_esc7(){
 		case 0x06:	/* FBSTP packed BCD */
 			dyn_fill_ea(FC_ADDR); 
 			gen_call_function_R(FPU_FBST,FC_ADDR);
-			gen_call_function_raw(FPU_FPOP);
+			dyn_fpu_pop();
 			break;
 		case 0x07:  /* FISTP Bit64s */
 			dyn_fill_ea(FC_ADDR); 
 			gen_call_function_R(FPU_FST_I64,FC_ADDR);
-			gen_call_function_raw(FPU_FPOP);
+			dyn_fpu_pop();
 			break;
 		default:
 			LOG(LOG_FPU,LOG_WARN)("ESC 7 EA:Unhandled group %d subfunction %d",(unsigned int)decode.modrm.reg,(unsigned int)decode.modrm.rm);
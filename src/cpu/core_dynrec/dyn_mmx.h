@@ -0,0 +1,193 @@
+/*
+ *  Copyright (C) 2002-2019  The DOSBox Team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1335, USA.
+ */
+
+
+
+/*
+	MMX instructions.
+
+	EMMS and the data movement instructions (MOVD/MOVQ) are translated
+	for all backends. The arithmetic, logical, shift, compare, pack and
+	unpack instructions need a backend that can do them with host
+	instructions (DRC_MMX_NATIVE, the sse2 unit on x86-64 hosts): the
+	operands are loaded into the low half of two host xmm registers,
+	combined with the sse2 counterpart of the instruction and the low
+	half is stored back. Everything else is left to the normal core.
+*/
+
+#include "mmx.h"
+
+// the 64bit memory operand of the current instruction
+static MMX_reg dyn_mmx_tmp;
+
+// read the 64bit memory operand given by the modrm into dyn_mmx_tmp
+static void dyn_mmx_read_tmp(void) {
+	dyn_fill_ea(FC_ADDR);
+	gen_protect_addr_reg();
+	dyn_read_word(FC_ADDR,FC_OP1,true);
+	gen_mov_word_from_reg(FC_OP1,(void*)(&dyn_mmx_tmp.ud.d0),true);
+	gen_restore_addr_reg();
+	gen_add_imm(FC_ADDR,4);
+	dyn_read_word(FC_ADDR,FC_OP1,true);
+	gen_mov_word_from_reg(FC_OP1,(void*)(&dyn_mmx_tmp.ud.d1),true);
+}
+
+// write the mmx register src to the memory given by the modrm
+static void dyn_mmx_write_ea(MMX_reg * src) {
+	dyn_fill_ea(FC_ADDR);
+	gen_protect_addr_reg();
+	gen_mov_word_to_reg(FC_OP2,(void*)(&src->ud.d0),true);
+	dyn_write_word(FC_ADDR,FC_OP2,true);
+	gen_restore_addr_reg();
+	gen_add_imm(FC_ADDR,4);
+	gen_mov_word_to_reg(FC_OP2,(void*)(&src->ud.d1),true);
+	dyn_write_word(FC_ADDR,FC_OP2,true);
+}
+
+// copy the mmx register src to dest
+static void dyn_mmx_copy(MMX_reg * dest,MMX_reg * src) {
+	if (dest==src) return;
+	gen_mov_word_to_reg(FC_OP1,(void*)(&src->ud.d0),true);
+	gen_mov_word_from_reg(FC_OP1,(void*)(&dest->ud.d0),true);
+	gen_mov_word_to_reg(FC_OP1,(void*)(&src->ud.d1),true);
+	gen_mov_word_from_reg(FC_OP1,(void*)(&dest->ud.d1),true);
+}
+
+#if defined(DRC_MMX_NATIVE)
+static INLINE bool dyn_mmx_native(void) {
+	return gen_mmx_native_possible((void*)reg_mmx) && gen_mmx_native_possible((void*)(&dyn_mmx_tmp));
+}
+
+// load the source operand (mmx register or memory) into the host register xreg,
+// this has to be done first as the memory access destroys the xmm registers
+static void dyn_mmx_load_src(Bit8u xreg) {
+	if (decode.modrm.mod<3) {
+		dyn_mmx_read_tmp();
+		gen_mmx_load(xreg,(void*)(&dyn_mmx_tmp));
+	} else gen_mmx_load(xreg,(void*)(&reg_mmx[decode.modrm.rm]));
+}
+#endif
+
+// translate the mmx instruction 0x0f dual_code, returns false if it has
+// to be executed by the normal core, no code is generated in that case
+static bool dyn_mmx(Bitu dual_code) {
+	// the normal core decodes the mmx instructions only with 32bit operand size
+	if (!decode.big_op) return false;
+
+	if (dual_code==0x77) {		// EMMS
+		gen_call_function_I(setFPU,TAG_Empty);
+		return true;
+	}
+
+	dyn_get_modrm();
+	MMX_reg * dest=&reg_mmx[decode.modrm.reg];
+	switch (dual_code) {
+	case 0x6e:		// MOVD Pq,Ed
+		if (decode.modrm.mod<3) {
+			dyn_fill_ea(FC_ADDR);
+			dyn_read_word(FC_ADDR,FC_OP1,true);
+		} else MOV_REG_WORD32_TO_HOST_REG(FC_OP1,decode.modrm.rm);
+		gen_mov_word_from_reg(FC_OP1,(void*)(&dest->ud.d0),true);
+		gen_mov_direct_dword((void*)(&dest->ud.d1),0);
+		return true;
+	case 0x7e:		// MOVD Ed,Pq
+		if (decode.modrm.mod<3) {
+			dyn_fill_ea(FC_ADDR);
+			gen_mov_word_to_reg(FC_OP2,(void*)(&dest->ud.d0),true);
+			dyn_write_word(FC_ADDR,FC_OP2,true);
+		} else {
+			gen_mov_word_to_reg(FC_OP1,(void*)(&dest->ud.d0),true);
+			MOV_REG_WORD32_FROM_HOST_REG(FC_OP1,decode.modrm.rm);
+		}
+		return true;
+	case 0x6f:		// MOVQ Pq,Qq
+		if (decode.modrm.mod<3) {
+			dyn_mmx_read_tmp();
+			dyn_mmx_copy(dest,&dyn_mmx_tmp);
+		} else dyn_mmx_copy(dest,&reg_mmx[decode.modrm.rm]);
+		return true;
+	case 0x7f:		// MOVQ Qq,Pq
+		if (decode.modrm.mod<3) dyn_mmx_write_ea(dest);
+		else dyn_mmx_copy(&reg_mmx[decode.modrm.rm],dest);
+		return true;
+	default:
+		break;
+	}
+
+#if defined(DRC_MMX_NATIVE)
+	if (!dyn_mmx_native()) return false;
+	switch (dual_code) {
+	case 0x71:		// PSRLW/PSRAW/PSLLW Pq,Ib
+	case 0x72:		// PSRLD/PSRAD/PSLLD Pq,Ib
+	case 0x73:		// PSRLQ/PSLLQ Pq,Ib
+		{
+			if (decode.modrm.mod<3) return false;
+			Bit8u subop=decode.modrm.reg;
+			if ((subop!=2) && (subop!=6) && ((subop!=4) || (dual_code==0x73))) return false;
+			MMX_reg * reg=&reg_mmx[decode.modrm.rm];
+			gen_mmx_load(0,(void*)reg);
+			gen_mmx_shift_imm((Bit8u)dual_code,subop,0,decode_fetchb());
+			gen_mmx_store(0,(void*)reg);
+		}
+		return true;
+	case 0x63:		// PACKSSWB Pq,Qq
+	case 0x67:		// PACKUSWB Pq,Qq
+	case 0x6b:		// PACKSSDW Pq,Qq
+		// both operands have to be in one register for the
+		// 128bit pack to produce the 64bit result
+		dyn_mmx_load_src(1);
+		gen_mmx_load(0,(void*)dest);
+		gen_mmx_op(0x6c,0,1);		// punpcklqdq
+		gen_mmx_op((Bit8u)dual_code,0,0);
+		break;
+	case 0x68:		// PUNPCKHBW Pq,Qq
+	case 0x69:		// PUNPCKHWD Pq,Qq
+	case 0x6a:		// PUNPCKHDQ Pq,Qq
+		// the upper half of the 128bit low unpack is the 64bit high unpack
+		dyn_mmx_load_src(1);
+		gen_mmx_load(0,(void*)dest);
+		gen_mmx_op((Bit8u)(dual_code-8),0,1);
+		gen_mmx_shift_imm(0x73,3,0,8);		// psrldq
+		break;
+	case 0x60:case 0x61:case 0x62:					// PUNPCKLBW/WD/DQ
+	case 0x64:case 0x65:case 0x66:					// PCMPGTB/W/D
+	case 0x74:case 0x75:case 0x76:					// PCMPEQB/W/D
+	case 0xd1:case 0xd2:case 0xd3:					// PSRLW/D/Q
+	case 0xd5:										// PMULLW
+	case 0xd8:case 0xd9:case 0xdc:case 0xdd:		// PSUBUSB/W PADDUSB/W
+	case 0xdb:case 0xdf:case 0xeb:case 0xef:		// PAND PANDN POR PXOR
+	case 0xe1:case 0xe2:							// PSRAW/D
+	case 0xe5:										// PMULHW
+	case 0xe8:case 0xe9:case 0xec:case 0xed:		// PSUBSB/W PADDSB/W
+	case 0xf1:case 0xf2:case 0xf3:					// PSLLW/D/Q
+	case 0xf5:										// PMADDWD
+	case 0xf8:case 0xf9:case 0xfa:					// PSUBB/W/D
+	case 0xfc:case 0xfd:case 0xfe:					// PADDB/W/D
+		dyn_mmx_load_src(1);
+		gen_mmx_load(0,(void*)dest);
+		gen_mmx_op((Bit8u)dual_code,0,1);
+		break;
+	default:
+		return false;
+	}
+	gen_mmx_store(0,(void*)dest);
+	return true;
+#else
+	return false;
+#endif
+}
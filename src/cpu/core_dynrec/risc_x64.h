@@ -29,6 +29,20 @@
 // try to replace _simple functions by code
 #define DRC_FLAGS_INVALIDATION_DCODE
 
+// the host fpu can work on the 80bit fpu register images directly
+#define DRC_FPU_NATIVE
+
+// the mmx instructions can be done by the sse2 unit of the host
+#define DRC_MMX_NATIVE
+
+// memory accesses can use the host pointers of the tlb without a function call
+#define DRC_TLB_INLINE
+
+// the guest registers are accessed through FC_REGS_ADDR
+#define DRC_USE_REGS_ADDR
+// and kept in host registers within a block (see gen_regcache_init)
+#define DRC_REGS_CACHE
+
 // type with the same size as a pointer
 #define DRC_PTR_SIZE_IM Bit64u
 
@@ -80,6 +94,11 @@ typedef Bit8u HostReg;
 // temporary register for LEA
 #define TEMP_REG_DRC HOST_ESI
 
+// register (r15) that holds the address of cpu_regs while generated code runs,
+// the guest registers and all other emulator variables within 2GB of them
+// are accessed relative to it (see gen_run_code)
+#define FC_REGS_ADDR 15
+
 
 // move a full register from reg_src to reg_dst
 static void gen_mov_regs(HostReg reg_dst,HostReg reg_src) {
@@ -90,11 +109,192 @@ static void gen_mov_regs(HostReg reg_dst,HostReg reg_src) {
 
 static void gen_mov_reg_qword(HostReg dest_reg,Bit64u imm);
 
+// see if data can be addressed relative to FC_REGS_ADDR, offset receives the displacement
+static INLINE bool gen_regs_offset(void* data,Bit64s & offset) {
+	offset=(Bit64s)data-(Bit64s)(&cpu_regs);
+	return (offset>>63) == (offset>>31);
+}
+
+
+// within a block the guest registers eax..edi can be held in the host registers
+// r12-r14 (the slots), which are preserved across function calls. A register
+// is loaded into a slot on its first use, and a modified slot is written back
+// to cpu_regs when the slot is reused, before the generated code calls a
+// function that may access cpu_regs and before every jump, so cpu_regs is up
+// to date whenever the code leaves the straight-line path.
+// At the destination of a jump only the slots that hold the same register on
+// both paths are kept (see gen_regcache_merge).
+#define REGCACHE_SLOTS 3
+#define REGCACHE_BRANCHES 1024
+
+static struct {
+	struct {
+		bool valid;
+		bool dirty;		// the slot differs from cpu_regs
+		Bit8u guest;	// index of the cached register in cpu_regs.regs
+		Bitu used;		// for replacing the least recently used slot
+	} slot[REGCACHE_SLOTS];
+	Bitu used;
+	// the code at cache.pos can only be reached through a jump
+	bool unreachable;
+	// slot assignment at the jumps whose destination is not yet known
+	struct {
+		Bit64u pos;
+		Bit8s guest[REGCACHE_SLOTS];
+	} branch[REGCACHE_BRANCHES];
+	Bitu branch_num;
+} regcache;
+
+// start with empty slots, called at the beginning of every block
+static void gen_regcache_init(void) {
+	for (Bitu sl=0; sl<REGCACHE_SLOTS; sl++) {
+		regcache.slot[sl].valid=false;
+		regcache.slot[sl].dirty=false;
+	}
+	regcache.unreachable=false;
+	regcache.branch_num=0;
+}
+
+// mov [r15+offset],r12d+sl (store==true) or mov r12d+sl,[r15+offset]
+static void gen_regcache_move(Bitu sl,bool store) {
+	cache_addb(0x45);
+	cache_addb(store ? 0x89 : 0x8b);
+	cache_addb((Bit8u)(0x47+((4+sl)<<3)));
+	cache_addb((Bit8u)(regcache.slot[sl].guest*sizeof(GenReg32)));
+}
+
+// op reg,r12d+sl (or op r12d+sl,reg, depending on the op), 0x0f-prefixed
+// ops are passed as 0x0fxx, word selects the 16bit form
+static void gen_regcache_op(Bitu sl,HostReg reg,Bit16u op,bool word=false) {
+	if (word) cache_addb(0x66);
+	cache_addb(0x41);
+	if (op>0xff) cache_addb(0x0f);
+	cache_addb((Bit8u)op);
+	cache_addb((Bit8u)(0xc4+(reg<<3)+sl));
+}
+
+// write a modified slot back to cpu_regs
+static void gen_regcache_writeback(Bitu sl) {
+	if (regcache.slot[sl].valid && regcache.slot[sl].dirty) {
+		gen_regcache_move(sl,true);
+		regcache.slot[sl].dirty=false;
+	}
+}
+
+// write all modified slots back to cpu_regs
+static void gen_regcache_flush(void) {
+	for (Bitu sl=0; sl<REGCACHE_SLOTS; sl++) gen_regcache_writeback(sl);
+}
+
+// load all slots from cpu_regs again after a function that may have changed it
+static void gen_regcache_reload(void) {
+	for (Bitu sl=0; sl<REGCACHE_SLOTS; sl++) {
+		if (regcache.slot[sl].valid) gen_regcache_move(sl,false);
+	}
+}
+
+// cpu_regs[offset] is accessed directly in memory, so it must not stay in a slot
+static void gen_regcache_release(void* data) {
+	Bit64s offset=(Bit64s)data-(Bit64s)(&cpu_regs);
+	if ((offset<0) || (offset>=(Bit64s)(8*sizeof(GenReg32)))) return;
+	for (Bitu sl=0; sl<REGCACHE_SLOTS; sl++) {
+		if (regcache.slot[sl].valid && (regcache.slot[sl].guest==(offset>>2))) {
+			gen_regcache_writeback(sl);
+			regcache.slot[sl].valid=false;
+		}
+	}
+}
+
+// get the slot that holds cpu_regs[index], a slot is assigned to it if it
+// is not cached yet and loaded from cpu_regs if load==true
+static Bitu gen_regcache_get(Bitu index,bool load) {
+	Bit8u guest=(Bit8u)(index>>2);
+	Bitu sl;
+	for (sl=0; sl<REGCACHE_SLOTS; sl++) {
+		if (regcache.slot[sl].valid && (regcache.slot[sl].guest==guest)) {
+			regcache.slot[sl].used=++regcache.used;
+			return sl;
+		}
+	}
+	// take a free slot or replace the least recently used one
+	Bitu victim=0;
+	for (sl=0; sl<REGCACHE_SLOTS; sl++) {
+		if (!regcache.slot[sl].valid) {
+			victim=sl;
+			break;
+		}
+		if (regcache.slot[sl].used<regcache.slot[victim].used) victim=sl;
+	}
+	gen_regcache_writeback(victim);
+	regcache.slot[victim].valid=true;
+	regcache.slot[victim].dirty=false;
+	regcache.slot[victim].guest=guest;
+	regcache.slot[victim].used=++regcache.used;
+	if (load) gen_regcache_move(victim,false);
+	return victim;
+}
+
+// remember the slot assignment at the jump whose destination is at pos,
+// the modified slots have to be written back before the jump is generated
+static void gen_regcache_branch(Bit64u pos) {
+	if (regcache.branch_num>=REGCACHE_BRANCHES) return;
+	regcache.branch[regcache.branch_num].pos=pos;
+	for (Bitu sl=0; sl<REGCACHE_SLOTS; sl++) {
+		regcache.branch[regcache.branch_num].guest[sl]=regcache.slot[sl].valid ? (Bit8s)regcache.slot[sl].guest : -1;
+	}
+	regcache.branch_num++;
+}
+
+// the destination of the jump at pos is reached, if the preceding code falls
+// through to it only the slots that hold the same register as at the jump
+// are kept, otherwise the slots are taken from the jump
+static void gen_regcache_merge(Bit64u pos) {
+	Bits br=-1;
+	for (Bits ct=(Bits)regcache.branch_num-1; ct>=0; ct--) {
+		if (regcache.branch[ct].pos==pos) {
+			br=ct;
+			break;
+		}
+	}
+	if (!regcache.unreachable) gen_regcache_flush();
+	for (Bitu sl=0; sl<REGCACHE_SLOTS; sl++) {
+		Bits guest=(br>=0) ? regcache.branch[br].guest[sl] : -1;
+		if (regcache.unreachable) {
+			regcache.slot[sl].valid=(guest>=0);
+			regcache.slot[sl].dirty=false;
+			regcache.slot[sl].guest=(Bit8u)guest;
+			regcache.slot[sl].used=0;
+		} else if (regcache.slot[sl].valid && (regcache.slot[sl].guest!=guest)) {
+			regcache.slot[sl].valid=false;
+		}
+	}
+	regcache.unreachable=false;
+}
+
 // This function generates an instruction with register addressing and a memory location
 static INLINE void gen_reg_memaddr(HostReg reg,void* data,Bit8u op,Bit8u prefix=0) {
+	gen_regcache_release(data);
 	Bit64s diff = (Bit64s)data-((Bit64s)cache.pos+(prefix?7:6));
-//	if ((diff<0x80000000LL) && (diff>-0x80000000LL)) { //clang messes itself up on this...
-	if ( (diff>>63) == (diff>>31) ) { //signed bit extend, test to see if value fits in a Bit32s
+	Bit64s offset;
+	bool regs_rel=gen_regs_offset(data,offset);
+	if (regs_rel && ((offset<-128) || (offset>127)) && ((diff>>63) == (diff>>31))) regs_rel=false;
+	if (regs_rel) {
+		// mov reg,[r15+offset] (or similar, depending on the op) to fetch *data,
+		// the REX prefix has to be merged with a REX prefix passed in
+		Bit8u rex=0x41;
+		if ((prefix&0xf0)==0x40) rex|=prefix;
+		else if (prefix==0x66) cache_addb(prefix);
+		cache_addb(rex);
+		if (prefix==0x0f) cache_addb(prefix);
+		cache_addb(op);
+		if ((offset>=-128) && (offset<=127)) {
+			cache_addb(0x47+(reg<<3));
+			cache_addb((Bit8u)offset);
+		} else {
+			cache_addb(0x87+(reg<<3));
+			cache_addd((Bit32u)(((Bit64u)offset)&0xffffffffLL));
+		}
+	} else if ( (diff>>63) == (diff>>31) ) { //signed bit extend, test to see if value fits in a Bit32s
 		// mov reg,[rip+diff] (or similar, depending on the op) to fetch *data
 		if(prefix) cache_addb(prefix);
 		cache_addb(op);
@@ -125,9 +325,31 @@ static INLINE void gen_reg_memaddr(HostReg reg,void* data,Bit8u op,Bit8u prefix=
 
 // Same as above, but with immediate addressing and a memory location
 static INLINE void gen_memaddr(Bit8u modreg,void* data,Bitu off,Bitu imm,Bit8u op,Bit8u prefix=0) {
+	gen_regcache_release(data);
 	Bit64s diff = (Bit64s)data-((Bit64s)cache.pos+off+(prefix?7:6));
+	Bit64s offset;
+	bool regs_rel=gen_regs_offset(data,offset);
+	if (regs_rel && ((offset<-128) || (offset>127)) && ((diff>>63) == (diff>>31))) regs_rel=false;
+	if (regs_rel) {
+		// op [r15+offset],imm
+		if(prefix) cache_addb(prefix);
+		cache_addb(0x41);
+		cache_addb(op);
+		if ((offset>=-128) && (offset<=127)) {
+			cache_addb(0x47+(modreg&0x38));
+			cache_addb((Bit8u)offset);
+		} else {
+			cache_addb(0x87+(modreg&0x38));
+			cache_addd((Bit32u)(((Bit64u)offset)&0xffffffffLL));
+		}
+
+		switch(off) {
+			case 1: cache_addb(((Bit8u)imm&0xff)); break;
+			case 2: cache_addw(((Bit16u)imm&0xffff)); break;
+			case 4: cache_addd(((Bit32u)imm&0xffffffff)); break;
+		}
 //	if ((diff<0x80000000LL) && (diff>-0x80000000LL)) {
-	if ( (diff>>63) == (diff>>31) ) {
+	} else if ( (diff>>63) == (diff>>31) ) {
 		// RIP-relative addressing is offset after the instruction 
 		if(prefix) cache_addb(prefix);
 		cache_addw(op+((modreg+1)<<8));
@@ -240,10 +462,12 @@ static void gen_mov_byte_to_reg_low_imm_canuseword(HostReg dest_reg,Bit8u imm) {
 	cache_addd((Bit32u)imm);
 }
 
+#if !defined(DRC_USE_REGS_ADDR)
 // move the lowest 8bit of a register into memory
 static void gen_mov_byte_from_reg_low(HostReg src_reg,void* dest) {
 	gen_reg_memaddr(src_reg,dest,0x88);	// mov byte [data],reg
 }
+#endif
 
 
 
@@ -373,22 +597,39 @@ static INLINE void gen_lea(HostReg dest_reg,Bitu scale,Bits imm) {
 
 
 
-// generate a call to a parameterless function
-template <typename T> static void INLINE gen_call_function_raw(const T func) {
+// generate a call to a parameterless function that does not access
+// the general purpose registers in cpu_regs, so the slots can stay as they are
+template <typename T> static void INLINE gen_call_function_pure(const T func) {
 	cache_addw(0xb848);
 	cache_addq((Bit64u)func);
 	cache_addw(0xd0ff);
 }
 
-// generate a call to a function with paramcount parameters
-// note: the parameters are loaded in the architecture specific way
-// using the gen_load_param_ functions below
-template <typename T> static Bit64u INLINE gen_call_function_setup(const T func,Bitu paramcount,bool fastcall=false) {
+// generate a call to a parameterless function
+template <typename T> static void INLINE gen_call_function_raw(const T func) {
+	gen_regcache_flush();
+	gen_call_function_pure(func);
+	gen_regcache_reload();
+}
+
+// generate a call to a function with paramcount parameters that does not
+// access the general purpose registers in cpu_regs
+template <typename T> static Bit64u INLINE gen_call_function_setup_pure(const T func,Bitu paramcount,bool fastcall=false) {
 	(void)paramcount;
 	(void)fastcall;
 
 	Bit64u proc_addr = (Bit64u)cache.pos;
-	gen_call_function_raw(func);
+	gen_call_function_pure(func);
+	return proc_addr;
+}
+
+// generate a call to a function with paramcount parameters
+// note: the parameters are loaded in the architecture specific way
+// using the gen_load_param_ functions below
+template <typename T> static Bit64u INLINE gen_call_function_setup(const T func,Bitu paramcount,bool fastcall=false) {
+	gen_regcache_flush();
+	Bit64u proc_addr=gen_call_function_setup_pure(func,paramcount,fastcall);
+	gen_regcache_reload();
 	return proc_addr;
 }
 
@@ -527,6 +768,7 @@ static void INLINE gen_load_param_mem(Bitu mem,Bitu param) {
 
 // jump to an address pointed at by ptr, offset is in imm
 static void gen_jmp_ptr(void * ptr,Bits imm=0) {
+	gen_regcache_flush();
 	cache_addw(0xa148);		// mov rax,[data]
 	cache_addq((Bit64u)ptr);
 
@@ -540,33 +782,39 @@ static void gen_jmp_ptr(void * ptr,Bits imm=0) {
 		cache_addb(0xa0);
 		cache_addd((Bit32u)imm);
 	}
+	regcache.unreachable=true;
 }
 
 
 // short conditional jump (+-127 bytes) if register is zero
 // the destination is set by gen_fill_branch() later
 static Bit64u gen_create_branch_on_zero(HostReg reg,bool dword) {
+	gen_regcache_flush();
 	if (!dword) cache_addb(0x66);
 	cache_addb(0x0b);					// or reg,reg
 	cache_addb(0xc0+reg+(reg<<3));
 
 	cache_addw(0x0074);					// jz addr
+	gen_regcache_branch((Bit64u)cache.pos-1);
 	return ((Bit64u)cache.pos-1);
 }
 
 // short conditional jump (+-127 bytes) if register is nonzero
 // the destination is set by gen_fill_branch() later
 static Bit64u gen_create_branch_on_nonzero(HostReg reg,bool dword) {
+	gen_regcache_flush();
 	if (!dword) cache_addb(0x66);
 	cache_addb(0x0b);					// or reg,reg
 	cache_addb(0xc0+reg+(reg<<3));
 
 	cache_addw(0x0075);					// jnz addr
+	gen_regcache_branch((Bit64u)cache.pos-1);
 	return ((Bit64u)cache.pos-1);
 }
 
 // calculate relative offset and fill it into the location pointed to by data
 static void gen_fill_branch(DRC_PTR_SIZE_IM data) {
+	gen_regcache_merge(data);
 #if C_DEBUG
 	Bit64s len=(Bit64u)cache.pos-data;
 	if (len<0) len=-len;
@@ -581,44 +829,366 @@ static void gen_fill_branch(DRC_PTR_SIZE_IM data) {
 static Bit64u gen_create_branch_long_nonzero(HostReg reg,bool isdword) {
 	// isdword: cmp reg32,0
 	// not isdword: cmp reg8,0
+	gen_regcache_flush();
 	cache_addb(0x0a+(isdword?1:0));				// or reg,reg
 	cache_addb(0xc0+reg+(reg<<3));
 
 	cache_addw(0x850f);		// jnz
 	cache_addd(0);
+	gen_regcache_branch((Bit64u)cache.pos-4);
 	return ((Bit64u)cache.pos-4);
 }
 
 // compare 32bit-register against zero and jump if value less/equal than zero
 static Bit64u gen_create_branch_long_leqzero(HostReg reg) {
+	gen_regcache_flush();
 	cache_addw(0xf883+(reg<<8));
 	cache_addb(0x00);		// cmp reg,0
 
 	cache_addw(0x8e0f);		// jle
 	cache_addd(0);
+	gen_regcache_branch((Bit64u)cache.pos-4);
 	return ((Bit64u)cache.pos-4);
 }
 
 // calculate long relative offset and fill it into the location pointed to by data
 static void gen_fill_branch_long(Bit64u data) {
+	gen_regcache_merge(data);
 	*(Bit32u*)data=(Bit32u)((Bit64u)cache.pos-data-4);
 }
 
+// see if the fpu register images (or tags) at data can be addressed through FC_REGS_ADDR
+static INLINE bool gen_fpu_native_possible(void* data) {
+	Bit64s offset;
+	return gen_regs_offset(data,offset);
+}
+
+// op [r15+idx*(1<<scale)+offset] with offset being the distance of data to cpu_regs
+static void gen_fpu_indexed(Bit8u op,Bit8u reg,HostReg idx,Bit8u scale,void* data) {
+	Bit64s offset;
+	gen_regs_offset(data,offset);
+	cache_addb(0x41);
+	cache_addb(op);
+	cache_addb(0x84+(reg<<3));
+	cache_addb(0x07+(idx<<3)+(scale<<6));
+	cache_addd((Bit32u)(((Bit64u)offset)&0xffffffffLL));
+}
+
+// turn a register number into the offset of its 16 byte register image
+static void gen_fpu_index(HostReg reg) {
+	cache_addw(0xe0c1+(reg<<8));		// shl reg,4
+	cache_addb(0x04);
+}
+
+// fld tbyte [regs+idx], idx has to be set up by gen_fpu_index
+static void gen_fpu_load_ext(HostReg idx,void* regs) {
+	gen_fpu_indexed(0xdb,5,idx,0,regs);
+}
+
+// fstp tbyte [regs+idx], idx has to be set up by gen_fpu_index
+static void gen_fpu_store_ext_pop(HostReg idx,void* regs) {
+	gen_fpu_indexed(0xdb,7,idx,0,regs);
+}
+
+// arithmetic operation on st(1) and st(0) that pops the stack, rm is the
+// second byte of the 0xde opcode (like 0xc1 for faddp st(1),st(0))
+static void gen_fpu_arith_pop(Bit8u rm) {
+	cache_addb(0xde);
+	cache_addb(rm);
+}
+
+// fcompp
+static void gen_fpu_compare_pop2(void) {
+	cache_addw(0xd9de);
+}
+
+// move the dword at tags[idx] into dest_reg
+static void gen_fpu_tag_to_reg(HostReg dest_reg,HostReg idx,void* tags) {
+	gen_fpu_indexed(0x8b,dest_reg,idx,2,tags);
+}
+
+// move src_reg into the dword at tags[idx]
+static void gen_fpu_tag_from_reg(HostReg src_reg,HostReg idx,void* tags) {
+	gen_fpu_indexed(0x89,src_reg,idx,2,tags);
+}
+
+// move a 32bit constant into the dword at tags[idx]
+static void gen_fpu_tag_imm(HostReg idx,void* tags,Bit32u imm) {
+	gen_fpu_indexed(0xc7,0,idx,2,tags);
+	cache_addd(imm);
+}
+
+// clear the bits of mask in the 16bit status word at sw
+static void gen_fpu_clear_sw(void* sw,Bit16u mask) {
+	gen_memaddr(0x24,sw,2,(Bit16u)~mask,0x81,0x66);	// and word [sw],~mask
+}
+
+// store the control word of the host fpu at cw
+static void gen_fpu_save_cw(void* cw) {
+	gen_reg_memaddr(7,cw,0xd9);			// fnstcw [cw]
+}
+
+// load the control word of the host fpu from cw
+static void gen_fpu_load_cw(void* cw) {
+	gen_reg_memaddr(5,cw,0xd9);			// fldcw [cw]
+}
+
+// clear the exception flags of the host fpu
+static void gen_fpu_clear_exceptions(void) {
+	cache_addw(0xe2db);					// fnclex
+}
+
+// clear the bits of clear in the 16bit status word at sw and set the bits
+// of mask that are set in the status word of the host fpu, destroys FC_RETOP
+static void gen_fpu_status_to_sw(void* sw,Bit16u mask,Bit16u clear) {
+	cache_addw(0xe0df);					// fnstsw ax
+	gen_and_imm(HOST_EAX,mask);
+	gen_fpu_clear_sw(sw,clear);
+	gen_reg_memaddr(HOST_EAX,sw,0x09,0x66);	// or word [sw],ax
+}
+
+// see if the mmx registers at data can be addressed through FC_REGS_ADDR
+static INLINE bool gen_mmx_native_possible(void* data) {
+	Bit64s offset;
+	return gen_regs_offset(data,offset);
+}
+
+// sse2 instruction with the xmm register xreg and the memory at data
+static void gen_sse_memaddr(Bit8u prefix,Bit8u op,Bit8u xreg,void* data) {
+	Bit64s offset;
+	gen_regs_offset(data,offset);
+	cache_addb(prefix);
+	cache_addb(0x41);
+	cache_addb(0x0f);
+	cache_addb(op);
+	if ((offset>=-128) && (offset<=127)) {
+		cache_addb(0x47+(xreg<<3));		// [r15+disp8]
+		cache_addb((Bit8u)offset);
+	} else {
+		cache_addb(0x87+(xreg<<3));		// [r15+disp32]
+		cache_addd((Bit32u)(((Bit64u)offset)&0xffffffffLL));
+	}
+}
+
+// load the 64bit value at data into the low half of xreg, the upper half is cleared
+static void gen_mmx_load(Bit8u xreg,void* data) {
+	gen_sse_memaddr(0xf3,0x7e,xreg,data);	// movq xreg,[data]
+}
+
+// store the low half of xreg into the 64bit value at data
+static void gen_mmx_store(Bit8u xreg,void* data) {
+	gen_sse_memaddr(0x66,0xd6,xreg,data);	// movq [data],xreg
+}
+
+// packed operation on two xmm registers, op is the second opcode byte
+// of the mmx instruction which is the same for its sse2 counterpart
+static void gen_mmx_op(Bit8u op,Bit8u xreg_dst,Bit8u xreg_src) {
+	cache_addw(0x0f66);
+	cache_addb(op);
+	cache_addb(0xc0+(xreg_dst<<3)+xreg_src);
+}
+
+// shift by an immediate value (opcode 0x71-0x73, subop is the reg field)
+static void gen_mmx_shift_imm(Bit8u op,Bit8u subop,Bit8u xreg,Bit8u imm) {
+	cache_addw(0x0f66);
+	cache_addb(op);
+	cache_addb(0xc0+(subop<<3)+xreg);
+	cache_addb(imm);
+}
+
+// see if the host pointer table of the tlb can be addressed through FC_REGS_ADDR
+static INLINE bool gen_tlb_inline_possible(HostPt* tlb) {
+	Bit64s offset;
+	return gen_regs_offset((void*)tlb,offset);
+}
+
+// access size bytes at the address in reg_addr through the host pointer table tlb,
+// a read stores the value in readdata, a write takes it from reg_val.
+// FC_RETOP is zero after a successful access; the access is left to the code
+// that directly follows if the page has no host pointer or the access crosses
+// into the next page, the returned jump skips that code and has to be filled
+// by gen_fill_branch(). hits (if not NULL) counts the successful accesses.
+// only rax, r10 and r11 are used, which are free at a function call anyways
+static Bit64u gen_tlb_access(HostReg reg_addr,HostReg reg_val,HostPt* tlb,Bitu size,bool write,void* readdata,Bit64u* hits) {
+	Bit64s offset;
+	gen_regs_offset((void*)tlb,offset);
+
+	gen_regcache_flush();
+	cache_addb(0x41);					// mov r10d,reg_addr
+	cache_addw(0xc289+(reg_addr<<11));
+	cache_addw(0xc089+(reg_addr<<11));	// mov eax,reg_addr
+	cache_addw(0xe8c1);					// shr eax,12
+	cache_addb(0x0c);
+	cache_addw(0x8b4d);					// mov r11,[r15+rax*8+offset]
+	cache_addw(0xc79c);
+	cache_addd((Bit32u)(((Bit64u)offset)&0xffffffffLL));
+	cache_addw(0x854d);					// test r11,r11
+	cache_addb(0xdb);
+	cache_addw(0x0074);					// jz miss
+	Bit64u no_pointer=(Bit64u)cache.pos-1;
+	gen_regcache_branch(no_pointer);
+
+	Bit64u crossing=0;
+	if (size>1) {
+		cache_addw(0x8944);				// mov eax,r10d
+		cache_addb(0xd0);
+		cache_addb(0x25);				// and eax,0xfff
+		cache_addd(0xfff);
+		cache_addb(0x3d);				// cmp eax,0x1000-size
+		cache_addd((Bit32u)(0x1000-size));
+		cache_addw(0x0077);				// ja miss
+		crossing=(Bit64u)cache.pos-1;
+		gen_regcache_branch(crossing);
+	}
+
+	if (write) {
+		if (size==2) cache_addb(0x66);
+		cache_addb(0x43);				// mov [r11+r10],reg_val
+		cache_addb(size==1 ? 0x88 : 0x89);
+		cache_addb(0x04+(reg_val<<3));
+		cache_addb(0x13);
+	} else {
+		cache_addb(0x43);				// mov/movzx eax,[r11+r10]
+		switch (size) {
+			case 1: cache_addw(0xb60f); break;
+			case 2: cache_addw(0xb70f); break;
+			default: cache_addb(0x8b); break;
+		}
+		cache_addw(0x1304);
+		gen_mov_word_from_reg(HOST_EAX,readdata,true);
+	}
+	if ((hits!=NULL) && gen_regs_offset((void*)hits,offset)) {
+		cache_addw(0xff49);				// inc qword [r15+offset]
+		cache_addb(0x87);
+		cache_addd((Bit32u)(((Bit64u)offset)&0xffffffffLL));
+	}
+	cache_addw(0xc031);					// xor eax,eax
+	cache_addw(0x00eb);					// jmp done
+	Bit64u done=(Bit64u)cache.pos-1;
+	gen_regcache_branch(done);
+	regcache.unreachable=true;
+
+	gen_fill_branch(no_pointer);
+	if (crossing) gen_fill_branch(crossing);
+	return done;
+}
+
 static void gen_run_code(void) {
 	cache_addw(0x5355);     // push rbp,rbx
 	cache_addb(0x56);       // push rsi
+	cache_addw(0x5741);     // push r15
+	cache_addw(0x5441);     // push r12
+	cache_addw(0x5541);     // push r13
+	cache_addw(0x5641);     // push r14
 	cache_addd(0x20EC8348); // sub rsp, 32
+	cache_addw(0xBF49);cache_addq((Bit64u)(&cpu_regs)); // mov r15, &cpu_regs
 	cache_addb(0x48);cache_addw(0x2D8D);cache_addd(2); // lea rbp, [rip+2]
 	cache_addw(0xE0FF+(FC_OP1<<8)); // jmp FC_OP1
 	cache_addd(0x20C48348); // add rsp, 32
+	cache_addw(0x5E41);     // pop r14
+	cache_addw(0x5D41);     // pop r13
+	cache_addw(0x5C41);     // pop r12
+	cache_addw(0x5F41);     // pop r15
 	cache_addd(0xC35D5B5E); // pop rsi,rbx,rbp;ret
 }
 
 // return from a function
 static void gen_return_function(void) {
+	gen_regcache_flush();
 	cache_addw(0xE5FF); // jmp rbp
+	regcache.unreachable=true;
+}
+
+#ifdef DRC_USE_REGS_ADDR
+
+// mov 16bit value from cpu_regs[index] into dest_reg using the slots (index modulo 2 must be zero)
+// the value is zero-extended like in gen_mov_word_to_reg
+static void gen_mov_regval16_to_reg(HostReg dest_reg,Bitu index) {
+	gen_regcache_op(gen_regcache_get(index,true),dest_reg,0x0fb7);		// movzx dest_reg,slot16
+}
+
+// mov 32bit value from cpu_regs[index] into dest_reg using the slots (index modulo 4 must be zero)
+static void gen_mov_regval32_to_reg(HostReg dest_reg,Bitu index) {
+	gen_regcache_op(gen_regcache_get(index,true),dest_reg,0x8b);		// mov dest_reg,slot
+}
+
+// move a 32bit (dword==true) or 16bit (dword==false) value from cpu_regs[index] into dest_reg using the slots
+// (if dword==true index modulo 4 must be zero) (if dword==false index modulo 2 must be zero)
+static void gen_mov_regword_to_reg(HostReg dest_reg,Bitu index,bool dword) {
+	if (dword) gen_mov_regval32_to_reg(dest_reg,index);
+	else gen_mov_regval16_to_reg(dest_reg,index);
+}
+
+// move an 8bit value from cpu_regs[index] into dest_reg using the slots
+// the upper 24bit of the destination register can be destroyed
+// this function does not use FC_OP1/FC_OP2 as dest_reg as these
+// registers might not be directly byte-accessible on some architectures
+static void gen_mov_regbyte_to_reg_low(HostReg dest_reg,Bitu index) {
+	Bitu sl=gen_regcache_get(index,true);
+	if (index&3) {
+		gen_regcache_op(sl,dest_reg,0x0fb7);	// movzx dest_reg,slot16
+		cache_addw(0xe8c1+(dest_reg<<8));		// shr dest_reg,8
+		cache_addb(0x08);
+	} else {
+		gen_regcache_op(sl,dest_reg,0x0fb6);	// movzx dest_reg,slot8
+	}
+}
+
+// move an 8bit value from cpu_regs[index] into dest_reg using the slots
+// the upper 24bit of the destination register can be destroyed
+// this function can use FC_OP1/FC_OP2 as dest_reg which are
+// not directly byte-accessible on some architectures
+static void gen_mov_regbyte_to_reg_low_canuseword(HostReg dest_reg,Bitu index) {
+	gen_mov_regbyte_to_reg_low(dest_reg,index);
+}
+
+
+// add a 32bit value from cpu_regs[index] to a full register using the slots (index modulo 4 must be zero)
+static void gen_add_regval32_to_reg(HostReg reg,Bitu index) {
+	gen_regcache_op(gen_regcache_get(index,true),reg,0x03);			// add reg,slot
+}
+
+
+// move 16bit of register into cpu_regs[index] using the slots (index modulo 2 must be zero)
+static void gen_mov_regval16_from_reg(HostReg src_reg,Bitu index) {
+	Bitu sl=gen_regcache_get(index,true);
+	gen_regcache_op(sl,src_reg,0x89,true);	// mov slot16,src_reg
+	regcache.slot[sl].dirty=true;
 }
 
+// move 32bit of register into cpu_regs[index] using the slots (index modulo 4 must be zero)
+static void gen_mov_regval32_from_reg(HostReg src_reg,Bitu index) {
+	Bitu sl=gen_regcache_get(index,false);
+	gen_regcache_op(sl,src_reg,0x89);		// mov slot,src_reg
+	regcache.slot[sl].dirty=true;
+}
+
+// move 32bit (dword==true) or 16bit (dword==false) of a register into cpu_regs[index] using the slots
+// (if dword==true index modulo 4 must be zero) (if dword==false index modulo 2 must be zero)
+static void gen_mov_regword_from_reg(HostReg src_reg,Bitu index,bool dword) {
+	if (dword) gen_mov_regval32_from_reg(src_reg,index);
+	else gen_mov_regval16_from_reg(src_reg,index);
+}
+
+// move the lowest 8bit of a register into cpu_regs[index] using the slots
+static void gen_mov_regbyte_from_reg_low(HostReg src_reg,Bitu index) {
+	Bitu sl=gen_regcache_get(index,true);
+	if (index&3) {
+		cache_addw(0xc141);						// ror slot,8
+		cache_addb((Bit8u)(0xcc+sl));
+		cache_addb(0x08);
+		gen_regcache_op(sl,src_reg,0x88);		// mov slot8,src_reg8
+		cache_addw(0xc141);						// rol slot,8
+		cache_addb((Bit8u)(0xc4+sl));
+		cache_addb(0x08);
+	} else {
+		gen_regcache_op(sl,src_reg,0x88);		// mov slot8,src_reg8
+	}
+	regcache.slot[sl].dirty=true;
+}
+
+#endif
+
 #ifdef DRC_FLAGS_INVALIDATION
 // called when a call to a function can be replaced by a
 // call to a simpler function
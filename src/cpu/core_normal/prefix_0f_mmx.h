@@ -70,13 +70,13 @@
 	CASE_0F_D(0x7f)												/* MOVQ Qq,Pq */
 	{
 		GetRM;
-		MMX_reg* dest=lookupRMregMM[rm];
+		MMX_reg* src=lookupRMregMM[rm];
 		if (rm>=0xc0) {
-			MMX_reg* src=&reg_mmx[rm&7];
+			MMX_reg* dest=&reg_mmx[rm&7];
 			dest->q = src->q;
 		} else {
 			GetEAa;
-			SaveMq(eaa,dest->q);
+			SaveMq(eaa,src->q);
 		}
 		break;
 	}
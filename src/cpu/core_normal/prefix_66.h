@@ -631,6 +631,7 @@
 			Bit32s addip=Fetchds();
 			SAVEIP;
 			reg_eip+=(Bit32u)addip;
+			IDLE_CHECK_BACKJUMP(addip);
 			continue;
 		}
 	CASE_D(0xea)												/* JMP Ad */
@@ -652,6 +653,7 @@
 			Bit32s addip=Fetchbs();
 			SAVEIP;
 			reg_eip+=(Bit32u)addip;
+			IDLE_CHECK_BACKJUMP(addip);
 			continue;
 		}
 	CASE_D(0xed)												/* IN EAX,DX */
@@ -1061,6 +1061,7 @@
 			Bit16u addip=(Bit16u)Fetchws();
 			SAVEIP;
 			reg_eip=(Bit16u)(reg_eip+addip);
+			IDLE_CHECK_BACKJUMP((Bit16s)addip);
 			continue;
 		}
 	CASE_W(0xea)												/* JMP Ap */
@@ -1082,6 +1083,7 @@
 			Bit16s addip=Fetchbs();
 			SAVEIP;
 			reg_eip=(Bit16u)(reg_eip+(Bit32u)addip);
+			IDLE_CHECK_BACKJUMP(addip);
 			continue;
 		}
 	CASE_B(0xec)												/* IN AL,DX */
@@ -52,6 +52,11 @@ static INLINE Bit32s Fetchds() {
 		continue;											\
 	}
 
+/* a taken backward jump may close a polling loop, see CPU_IdleBackJump */
+#define IDLE_CHECK_BACKJUMP(adj)					\
+	if (GCC_UNLIKELY(cpu_idle_skip) && (Bit32s)(adj) < 0)		\
+		CPU_IdleBackJump((Bit32u)(reg_eip-(adj)));
+
 /* NTS: At first glance, this looks like code that will only fetch the delta for conditional jumps
  *      if the condition is true. Further examination shows that DOSBox's core has two different
  *      CS:IP variables, reg_ip and core.cseip which Fetchb() modifies. */
@@ -59,28 +64,40 @@ static INLINE Bit32s Fetchds() {
 #define JumpCond16_b(COND) {						\
 	const Bit32u adj=(Bit32u)Fetchbs();						\
 	SAVEIP;								\
-	if (COND) reg_ip+=adj;						\
+	if (COND) {							\
+		reg_ip+=adj;						\
+		IDLE_CHECK_BACKJUMP(adj);				\
+	}								\
 	continue;							\
 }
 
 #define JumpCond16_w(COND) {						\
 	const Bit32u adj=(Bit32u)Fetchws();						\
 	SAVEIP;								\
-	if (COND) reg_ip+=adj;						\
+	if (COND) {							\
+		reg_ip+=adj;						\
+		IDLE_CHECK_BACKJUMP(adj);				\
+	}								\
 	continue;							\
 }
 
 #define JumpCond32_b(COND) {						\
 	const Bit32u adj=(Bit32u)Fetchbs();						\
 	SAVEIP;								\
-	if (COND) reg_eip+=adj;						\
+	if (COND) {							\
+		reg_eip+=adj;						\
+		IDLE_CHECK_BACKJUMP(adj);				\
+	}								\
 	continue;							\
 }
 
 #define JumpCond32_d(COND) {						\
 	const Bit32u adj=(Bit32u)Fetchds();						\
 	SAVEIP;								\
-	if (COND) reg_eip+=adj;						\
+	if (COND) {							\
+		reg_eip+=adj;						\
+		IDLE_CHECK_BACKJUMP(adj);				\
+	}								\
 	continue;							\
 }
 
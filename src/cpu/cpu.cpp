@@ -32,7 +32,10 @@
 #include "lazyflags.h"
 #include "support.h"
 #include "control.h"
+#include "cross.h"
 #include "zipfile.h"
+#include "pic.h"
+#include "inout.h"
 
 #if defined(_MSC_VER)
 /* we don't care about switch statements with no case labels */
@@ -178,6 +181,10 @@ void CPU_Core_Dyn_X86_Cache_Reset(void);
 void CPU_Core_Dynrec_Init(void);
 void CPU_Core_Dynrec_Cache_Init(bool enable_cache);
 void CPU_Core_Dynrec_Cache_Close(void);
+void CPU_Core_Dynrec_Cache_Size(Bitu megabytes);
+void CPU_Core_Dynrec_Cache_Persist(const char * filename);
+void CPU_Core_Dynrec_Fast_FPU(bool enable);
+void CPU_Core_Dynrec_DataHot_Threshold(Bitu threshold);
 #endif
 
 bool CPU_IsDynamicCore(void);
@@ -2831,6 +2838,260 @@ void CPU_HLT(Bit32u oldeip) {
 	cpudecoder=&HLT_Decode;
 }
 
+/* Idle skipping of polling loops.
+ *
+ * A loop that waits for something without changing anything, like
+ *
+ *     l: in al,dx          ; dx = 3DAh
+ *        test al,8
+ *        jz l
+ *
+ * or a loop comparing the BIOS tick count at 0040:006C, does exactly the same
+ * thing in every iteration until a PIC event (an IRQ, a keyboard transfer, ...)
+ * or the emulated time changes what it reads. The interpreter cores report every
+ * taken backward jump. If two iterations of the same loop started with the same
+ * registers and flags, no PIC event was serviced in between, and the loop body
+ * only reads memory and I/O ports, the following iterations will do the same.
+ * As many whole iterations as fit before the next PIC event are then skipped by
+ * removing their cycles, like HLT does, so emulated time advances exactly as if
+ * they had run. The I/O ports the loop reads must have an idle hint telling when
+ * their value can change without an event (3DAh) or that it can't (60h, 64h). */
+bool cpu_idle_skip = false;
+
+static struct {
+	Bit16u cs;
+	PhysPt csbase;
+	Bit32u eip,jend;				// loop start and the end of the backward jump
+	bool checked,readonly;			// loop body verified to only read
+	Bit32u regs[8];
+	Bitu flags,segs[6];
+	Bitu ticks,activity;
+	Bits index;						// PIC_TickIndexND() at the loop start
+	bool io_unknown;				// the iteration read a port without idle hint
+	double io_change;				// earliest time a port read by the iteration can change
+	Bitu skips;
+	Bit64u skipped;
+} cpu_idle;
+
+void CPU_IdleIORead(Bitu port) {
+	IO_IdleHint * hint=IO_GetIdleHint(port);
+	if (hint==NULL) {
+		cpu_idle.io_unknown=true;
+		return;
+	}
+	const double change=hint(port);
+	if (!(change>=cpu_idle.io_change)) cpu_idle.io_change=change;
+}
+
+static void CPU_IdleSnapshot(void) {
+	for (Bitu i=0;i<8;i++) cpu_idle.regs[i]=cpu_regs.regs[i].dword[DW_INDEX];
+	cpu_idle.flags=reg_flags;
+	for (Bitu i=0;i<6;i++) cpu_idle.segs[i]=Segs.val[i];
+	cpu_idle.ticks=PIC_Ticks;
+	cpu_idle.activity=PIC_Activity;
+	cpu_idle.index=PIC_TickIndexND();
+	cpu_idle.io_unknown=false;
+	cpu_idle.io_change=IO_IDLE_EVENTS_ONLY;
+}
+
+static bool CPU_IdleSameState(void) {
+	if (cpu_idle.io_unknown || cpu_idle.ticks!=PIC_Ticks || cpu_idle.activity!=PIC_Activity) return false;
+	if (cpu_idle.flags!=reg_flags) return false;
+	for (Bitu i=0;i<8;i++)
+		if (cpu_idle.regs[i]!=cpu_regs.regs[i].dword[DW_INDEX]) return false;
+	for (Bitu i=0;i<6;i++)
+		if (cpu_idle.segs[i]!=Segs.val[i]) return false;
+	return true;
+}
+
+static INLINE bool CPU_IdleFetch(PhysPt &p,Bit8u &val) {
+	if (mem_readb_checked(p,&val)) return false;
+	p++;
+	return true;
+}
+
+// skip the modrm byte and the memory operand, mod is 3 for a register operand
+static bool CPU_IdleModrm(PhysPt &p,bool addr32,Bit8u &mod,Bit8u &reg) {
+	Bit8u modrm;
+	if (!CPU_IdleFetch(p,modrm)) return false;
+	mod=modrm>>6;
+	reg=(modrm>>3)&7;
+	const Bit8u rm=modrm&7;
+	if (mod==3) return true;
+	if (addr32) {
+		if (rm==4) {
+			Bit8u sib;
+			if (!CPU_IdleFetch(p,sib)) return false;
+			if (mod==0 && (sib&7)==5) p+=4;
+		} else if (mod==0 && rm==5) p+=4;
+		if (mod==1) p+=1;
+		else if (mod==2) p+=4;
+	} else {
+		if (mod==0 && rm==6) p+=2;
+		else if (mod==1) p+=1;
+		else if (mod==2) p+=2;
+	}
+	return true;
+}
+
+/* check that the loop body from start up to end (the end of the backward jump) only
+ * writes registers. The register results are checked by comparing two iterations. */
+static bool CPU_IdleVerifyLoop(PhysPt start,PhysPt end,bool big) {
+	if (end<=start || (end-start)>64) return false;
+	PhysPt p=start;
+	while (p<end) {
+		bool op32=big,addr32=big;
+		Bit8u op,mod,reg;
+		for (;;) {
+			if (!CPU_IdleFetch(p,op)) return false;
+			if (op==0x66) op32=!op32;
+			else if (op==0x67) addr32=!addr32;
+			else if (op!=0x26 && op!=0x2e && op!=0x36 && op!=0x3e && op!=0x64 && op!=0x65) break;
+		}
+		const PhysPt immv=op32 ? 4 : 2;
+		if (op<0x40 && (op&7)<6 && op!=0x0f) {
+			switch (op&7) {
+			case 0:case 1:case 2:case 3:		// ALU with modrm, the memory operand may only be read
+				if (!CPU_IdleModrm(p,addr32,mod,reg)) return false;
+				if (mod!=3 && !(op&2) && (op&0x38)!=0x38) return false;
+				break;
+			case 4:p+=1;break;					// ALU AL,Ib
+			case 5:p+=immv;break;				// ALU eAX,Iv
+			}
+			continue;
+		}
+		switch (op) {
+		case 0x40:case 0x41:case 0x42:case 0x43:case 0x44:case 0x45:case 0x46:case 0x47:	// INC reg
+		case 0x48:case 0x49:case 0x4a:case 0x4b:case 0x4c:case 0x4d:case 0x4e:case 0x4f:	// DEC reg
+		case 0x90:case 0x91:case 0x92:case 0x93:case 0x94:case 0x95:case 0x96:case 0x97:	// NOP, XCHG eAX,reg
+		case 0x98:case 0x99:case 0x9e:case 0x9f:		// CBW CWD SAHF LAHF
+		case 0xec:case 0xed:							// IN AL/eAX,DX
+		case 0xf5:case 0xf8:case 0xf9:case 0xfc:case 0xfd:	// CMC CLC STC CLD STD
+			break;
+		case 0x70:case 0x71:case 0x72:case 0x73:case 0x74:case 0x75:case 0x76:case 0x77:	// Jcc Jb
+		case 0x78:case 0x79:case 0x7a:case 0x7b:case 0x7c:case 0x7d:case 0x7e:case 0x7f:
+		case 0xa8:case 0xe4:case 0xe5:					// TEST AL,Ib  IN AL/eAX,Ib
+		case 0xb0:case 0xb1:case 0xb2:case 0xb3:case 0xb4:case 0xb5:case 0xb6:case 0xb7:	// MOV reg8,Ib
+			p+=1;
+			break;
+		case 0xa9:										// TEST eAX,Iv
+		case 0xb8:case 0xb9:case 0xba:case 0xbb:case 0xbc:case 0xbd:case 0xbe:case 0xbf:	// MOV reg,Iv
+			p+=immv;
+			break;
+		case 0xa0:case 0xa1:							// MOV AL/eAX,Ov
+			p+=addr32 ? 4 : 2;
+			break;
+		case 0xeb:										// JMP Jb, only as the backward jump
+			p+=1;
+			if (p!=end) return false;
+			break;
+		case 0xe9:										// JMP Jv, only as the backward jump
+			p+=immv;
+			if (p!=end) return false;
+			break;
+		case 0xf3:										// PAUSE
+			if (!CPU_IdleFetch(p,op) || op!=0x90) return false;
+			break;
+		case 0x80:case 0x82:case 0x83:					// ALU Eb/Ev,Ib, only CMP on memory
+			if (!CPU_IdleModrm(p,addr32,mod,reg)) return false;
+			if (mod!=3 && reg!=7) return false;
+			p+=1;
+			break;
+		case 0x81:										// ALU Ev,Iv, only CMP on memory
+			if (!CPU_IdleModrm(p,addr32,mod,reg)) return false;
+			if (mod!=3 && reg!=7) return false;
+			p+=immv;
+			break;
+		case 0x84:case 0x85:case 0x8a:case 0x8b:case 0x8d:	// TEST, MOV reg,E, LEA
+			if (!CPU_IdleModrm(p,addr32,mod,reg)) return false;
+			break;
+		case 0x86:case 0x87:case 0x88:case 0x89:case 0x8c:	// XCHG, MOV E,reg/sreg: registers only
+		case 0xd0:case 0xd1:case 0xd2:case 0xd3:			// shifts
+			if (!CPU_IdleModrm(p,addr32,mod,reg)) return false;
+			if (mod!=3) return false;
+			break;
+		case 0xc0:case 0xc1:								// shifts by Ib
+			if (!CPU_IdleModrm(p,addr32,mod,reg)) return false;
+			if (mod!=3) return false;
+			p+=1;
+			break;
+		case 0xf6:case 0xf7:								// TEST E,I, NOT/NEG on registers
+			if (!CPU_IdleModrm(p,addr32,mod,reg)) return false;
+			if (reg<2) p+=(op==0xf6) ? 1 : immv;
+			else if (reg>3 || mod!=3) return false;
+			break;
+		case 0xfe:case 0xff:								// INC/DEC on registers
+			if (!CPU_IdleModrm(p,addr32,mod,reg)) return false;
+			if (reg>1 || mod!=3) return false;
+			break;
+		case 0x0f:
+			if (!CPU_IdleFetch(p,op)) return false;
+			if (op>=0x80 && op<=0x8f) {						// Jcc Jv
+				p+=immv;
+			} else if (op>=0x90 && op<=0x9f) {				// SETcc on registers
+				if (!CPU_IdleModrm(p,addr32,mod,reg)) return false;
+				if (mod!=3) return false;
+			} else if (op==0xa3 || op==0xb6 || op==0xb7 || op==0xbe || op==0xbf) {	// BT, MOVZX, MOVSX
+				if (!CPU_IdleModrm(p,addr32,mod,reg)) return false;
+			} else if (op==0xba) {							// BT E,Ib
+				if (!CPU_IdleModrm(p,addr32,mod,reg)) return false;
+				if (reg!=4) return false;
+				p+=1;
+			} else return false;
+			break;
+		default:
+			return false;
+		}
+	}
+	return p==end;
+}
+
+/* called by the interpreter cores after a taken backward jump, reg_eip is the jump target */
+void CPU_IdleBackJump(Bit32u jend) {
+	if (!cpu.code.big && jend>0xffff) return;	// wrapped around the segment
+	if (reg_eip!=cpu_idle.eip || jend!=cpu_idle.jend || SegValue(cs)!=cpu_idle.cs || SegPhys(cs)!=cpu_idle.csbase) {
+		/* another loop, start watching this one */
+		cpu_idle.cs=SegValue(cs);
+		cpu_idle.csbase=SegPhys(cs);
+		cpu_idle.eip=reg_eip;
+		cpu_idle.jend=jend;
+		cpu_idle.checked=false;
+		FillFlags();
+		CPU_IdleSnapshot();
+		return;
+	}
+
+	FillFlags();
+	if (!CPU_IdleSameState()) {
+		/* the loop is still working. verify the body again once it settles, it may have changed meanwhile */
+		cpu_idle.checked=false;
+		CPU_IdleSnapshot();
+		return;
+	}
+	if (!cpu_idle.checked) {
+		cpu_idle.checked=true;
+		cpu_idle.readonly=CPU_IdleVerifyLoop(cpu_idle.csbase+cpu_idle.eip,cpu_idle.csbase+cpu_idle.jend,cpu.code.big);
+	}
+
+	const Bits cost=PIC_TickIndexND()-cpu_idle.index;
+	if (cpu_idle.readonly && cost>0 && !GETFLAG(TF)) {
+		Bits avail=CPU_Cycles;
+		if (cpu_idle.io_change<IO_IDLE_EVENTS_ONLY) {
+			const double limit=(cpu_idle.io_change-PIC_FullIndex())*CPU_CycleMax;
+			if (!(limit>0)) avail=0;
+			else if (limit<(double)avail) avail=(Bits)limit;
+		}
+		const Bits skip=(avail/cost)*cost;
+		if (skip>0) {
+			CPU_Cycles-=skip;
+			CPU_IODelayRemoved+=skip;
+			cpu_idle.skips++;
+			cpu_idle.skipped+=(Bit64u)skip;
+		}
+	}
+	CPU_IdleSnapshot();
+}
+
 void CPU_ENTER(bool use32,Bitu bytes,Bitu level) {
 	level&=0x1f;
 	Bit32u sp_index=reg_esp&cpu.stack.mask;
@@ -3252,12 +3513,32 @@ public:
             LOG(LOG_CPU,LOG_DEBUG)("Emulation of the B (big) bit in real mode enabled\n");
         }
 
+		cpu_idle_skip = section->Get_bool("idle skip");
+
 		always_report_double_fault = section->Get_bool("always report double fault");
 		always_report_triple_fault = section->Get_bool("always report triple fault");
 
 		dynamic_core_cache_block_size = section->Get_int("dynamic core cache block size");
 		if (dynamic_core_cache_block_size < 1 || dynamic_core_cache_block_size > 65536) dynamic_core_cache_block_size = 32;
 
+#if (C_DYNREC)
+		{
+			std::string persist_file = section->Get_string("dynamic core persistent cache");
+			// a relative path is placed next to the last loaded config file
+			if (!persist_file.empty() && control->configfiles.size() && !Cross::IsPathAbsolute(persist_file)) {
+				std::string lastconfigdir(control->configfiles[control->configfiles.size()-1]);
+				std::string::size_type pos = lastconfigdir.rfind(CROSS_FILESPLIT);
+				if (pos == std::string::npos) pos = 0;
+				lastconfigdir.erase(pos);
+				if (lastconfigdir.length()) persist_file = lastconfigdir + CROSS_FILESPLIT + persist_file;
+			}
+			CPU_Core_Dynrec_Cache_Persist(persist_file.c_str());
+		}
+		CPU_Core_Dynrec_Cache_Size((Bitu)section->Get_int("dynamic core cache size"));
+		CPU_Core_Dynrec_Fast_FPU(section->Get_bool("dynamic core fast fpu"));
+		CPU_Core_Dynrec_DataHot_Threshold((Bitu)section->Get_int("dynamic core data hot threshold"));
+#endif
+
 		Prop_multival* p = section->Get_multival("cycles");
 		std::string type = p->GetSection()->Get_string("type");
 		std::string str ;
@@ -3601,6 +3882,10 @@ static CPU * test;
 void CPU_ShutDown(Section* sec) {
     (void)sec;//UNUSED
 
+	if (cpu_idle.skips)
+		LOG_MSG("CPU: Idle skipping skipped %llu cycles in %lu polling loops",
+			(unsigned long long)cpu_idle.skipped,(unsigned long)cpu_idle.skips);
+
 #if (C_DYNAMIC_X86)
 	CPU_Core_Dyn_X86_Cache_Close();
 #elif (C_DYNREC)
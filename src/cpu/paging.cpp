@@ -819,6 +819,7 @@ void PAGING_ClearTLB(void) {
 	paging.krw_links.used=0;
 	paging.kr_links.used=0;
 	paging.links.used=0;
+	paging.stats.flushes++;
 }
 
 void PAGING_UnlinkPages(Bitu lin_page,Bitu pages) {
@@ -917,6 +918,7 @@ static void PAGING_LinkPageNew(Bitu lin_page, Bitu phys_page, Bitu linkmode, boo
 		break;
 	}
 	paging.links.entries[paging.links.used++]= (Bit32u)lin_page; // "master table"
+	paging.stats.links++;
 }
 
 void PAGING_LinkPage(Bitu lin_page,Bitu phys_page) {
@@ -937,6 +939,7 @@ void PAGING_LinkPage(Bitu lin_page,Bitu phys_page) {
 	else paging.tlb.write[lin_page]=0;
 
 	paging.links.entries[paging.links.used++]= (Bit32u)lin_page;
+	paging.stats.links++;
 	paging.tlb.readhandler[lin_page]=handler;
 	paging.tlb.writehandler[lin_page]=handler;
 }
@@ -1078,6 +1081,7 @@ void PAGING_ClearTLB(void) {
 		entry->writehandler=&init_page_handler;
 	}
 	paging.links.used=0;
+	paging.stats.flushes++;
 }
 
 void PAGING_UnlinkPages(Bitu lin_page,Bitu pages) {
@@ -1122,6 +1126,7 @@ void PAGING_LinkPage(Bitu lin_page,Bitu phys_page) {
 	else entry->write=0;
 
  	paging.links.entries[paging.links.used++]=lin_page;
+	paging.stats.links++;
 	entry->readhandler=handler;
 	entry->writehandler=handler;
 }
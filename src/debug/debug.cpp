@@ -144,6 +144,7 @@ static void LogXMS(void);
 static void LogEMS(void);
 static void LogFNKEY(void);
 static void LogPages(char* selname);
+static void LogTLBInfo(char* arg);
 static void LogCPUInfo(void);
 static void OutputVecTable(char* filename);
 static void DrawVariables(void);
@@ -1795,6 +1796,7 @@ bool ParseCommand(char* str) {
         void DEBUG_PICMask(int irq,bool mask);
         void DEBUG_PICAck(int irq);
         void DEBUG_LogPIC(void);
+        void DEBUG_LogPICEvents(bool reset);
 
         DEBUG_BeginPagedContent();
 
@@ -1831,6 +1833,11 @@ bool ParseCommand(char* str) {
             int irq = atoi(what.c_str());
             DEBUG_PICSignal(irq,true);
         }
+        else if (command == "EVENTS") { /* event queue statistics per event handler */
+            std::string what;
+            stream >> what;
+            DEBUG_LogPICEvents(what == "RESET");
+        }
         else if (command == "") {
             DEBUG_LogPIC();
         }
@@ -1844,6 +1851,60 @@ bool ParseCommand(char* str) {
         return true;
     }
 
+    if (command == "PROFILE") { // sampling profiler of guest code
+        void DEBUG_ProfileStart(double interval);
+        void DEBUG_ProfileStop(void);
+        void DEBUG_ProfileClear(void);
+        void DEBUG_ProfileShow(unsigned int top);
+        bool DEBUG_ProfileSave(const char *path);
+        bool DEBUG_ProfileLoadSymbols(const char *path,Bit16u base);
+
+        command.clear();
+        stream >> command;
+
+        /* file names are taken from the command line as typed, not upper cased */
+        std::string path;
+        {
+            istringstream orig(str);
+            std::string tmp;
+            orig >> tmp >> tmp >> path;
+        }
+
+        if (command == "ON") {
+            double interval = 0;
+            stream >> interval;
+            DEBUG_ProfileStart(interval);
+        }
+        else if (command == "OFF") {
+            DEBUG_ProfileStop();
+        }
+        else if (command == "CLEAR") {
+            DEBUG_ProfileClear();
+        }
+        else if (command == "SAVE") {
+            if (path.empty()) path = "profile.txt";
+            DEBUG_ProfileSave(path.c_str());
+        }
+        else if (command == "SYMBOLS") {
+            std::string what;
+            stream >> what >> what;
+            if (path.empty()) return false;
+            DEBUG_ProfileLoadSymbols(path.c_str(),(Bit16u)strtoul(what.c_str(),NULL,16));
+        }
+        else if (command == "" || command == "SHOW") {
+            unsigned int top = 20;
+            stream >> top;
+            DEBUG_BeginPagedContent();
+            DEBUG_ProfileShow(top);
+            DEBUG_EndPagedContent();
+        }
+        else {
+            return false;
+        }
+
+        return true;
+    }
+
 	if (command == "C") { // Set code overview
 		Bit16u codeSeg = (Bit16u)GetHexValue(found,found); found++;
 		Bit32u codeOfs = GetHexValue(found,found);
@@ -2459,6 +2520,16 @@ bool ParseCommand(char* str) {
 	
 	if (command == "PAGING") {LogPages(found); return true;}
 
+	if (command == "TLB") {LogTLBInfo(found); return true;}
+
+#if (C_DYNREC)
+	if (command == "DYNREC") {
+		void CPU_Core_Dynrec_LogStats(bool reset);
+		CPU_Core_Dynrec_LogStats(strncmp(found,"RESET",5)==0);
+		return true;
+	}
+#endif
+
 	if (command == "CPU") {LogCPUInfo(); return true;}
 
 	if (command == "FPU") {LogFPUInfo(); return true;}
@@ -2571,6 +2642,16 @@ bool ParseCommand(char* str) {
 		DEBUG_ShowMsg("LDT                       - Lists descriptors of the LDT.\n");
 		DEBUG_ShowMsg("IDT                       - Lists descriptors of the IDT.\n");
 		DEBUG_ShowMsg("PAGING [page]             - Display content of page table.\n");
+		DEBUG_ShowMsg("TLB [RESET]               - Display (or reset) the TLB counters.\n");
+#if (C_DYNREC)
+		DEBUG_ShowMsg("DYNREC [RESET]            - Display (or reset) the dynamic core counters.\n");
+#endif
+		DEBUG_ShowMsg("PIC EVENTS [RESET]        - Display (or reset) the event counters per handler.\n");
+		DEBUG_ShowMsg("PROFILE ON [ms] / OFF     - Start/stop sampling CS:EIP, every [ms] of emulated time.\n");
+		DEBUG_ShowMsg("PROFILE [SHOW [n]]        - Show the [n] most sampled addresses, per core and mode.\n");
+		DEBUG_ShowMsg("PROFILE CLEAR             - Discard the samples.\n");
+		DEBUG_ShowMsg("PROFILE SAVE [file]       - Write the samples as collapsed stacks for flame graphs.\n");
+		DEBUG_ShowMsg("PROFILE SYMBOLS f [seg]   - Load seg:off or linear symbols (e.g. a .MAP file).\n");
 		DEBUG_ShowMsg("EXTEND                    - Toggle additional info.\n");
 		DEBUG_ShowMsg("TIMERIRQ                  - Run the system timer.\n");
 
@@ -3763,6 +3844,24 @@ void LogPages(char* selname) {
     DEBUG_EndPagedContent();
 }
 
+static void LogTLBInfo(char* arg) {
+	if (strncmp(arg,"RESET",5)==0) {
+		memset(&paging.stats,0,sizeof(paging.stats));
+		DEBUG_ShowMsg("DEBUG: TLB counters reset.\n");
+		return;
+	}
+
+	DEBUG_ShowMsg("TLB: %lu pages linked (%lu in total), %lu flushes",
+		(unsigned long)paging.links.used,
+		(unsigned long)paging.stats.links,
+		(unsigned long)paging.stats.flushes);
+#if defined(PAGING_TLB_STATS)
+	DEBUG_ShowMsg("TLB: %llu accesses through host pointers, %llu through page handlers",
+		(unsigned long long)paging.stats.hits,
+		(unsigned long long)paging.stats.misses);
+#endif
+}
+
 const char *FPU_tag(unsigned int i) {
     switch (i) {
         case TAG_Valid: return "Valid";
@@ -4095,6 +4194,10 @@ void DEBUG_Init() {
     mainMenu.get_item("mapper_debugger").enable(allow).refresh_item(mainMenu);
 #endif
 
+	/* the profiler stops at a reset */
+	void DEBUG_ProfileInit(void);
+	DEBUG_ProfileInit();
+
 	/* shutdown function */
 	AddExitFunction(AddExitFunctionFuncPair(DEBUG_ShutDown));
 }
@@ -0,0 +1,293 @@
+/*
+ *  Copyright (C) 2002-2019  The DOSBox Team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1335, USA.
+ */
+
+/* Sampling profiler of guest code (debugger PROFILE command).
+ *
+ * A PIC event takes a sample of CS:EIP, the CPU mode and the core running the guest
+ * at a jittered interval of emulated time, so a periodic guest routine such as a timer
+ * interrupt handler does not always get sampled at the same point of its loop. Events
+ * only run between two runs of the core, the dynamic core samples at block boundaries.
+ *
+ * The histogram can be exported as "collapsed stacks", one line per address with the
+ * core, mode and routine as the frames, which flamegraph.pl and speedscope read as is. */
+
+#include "dosbox.h"
+
+#if C_DEBUG
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <map>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include "cpu.h"
+#include "regs.h"
+#include "paging.h"
+#include "pic.h"
+#include "setup.h"
+#include "logging.h"
+
+enum {
+    PROF_CORE_NORMAL=0,
+    PROF_CORE_PREFETCH,
+    PROF_CORE_SIMPLE,
+    PROF_CORE_FULL,
+    PROF_CORE_DYNAMIC,
+    PROF_CORE_HLT,
+    PROF_CORE_OTHER,
+
+    PROF_CORE_MAX
+};
+
+enum {
+    PROF_MODE_REAL=0,
+    PROF_MODE_V86,
+    PROF_MODE_PM16,
+    PROF_MODE_PM32,
+
+    PROF_MODE_MAX
+};
+
+static const char *prof_core_names[PROF_CORE_MAX] = {
+    "normal", "prefetch", "simple", "full", "dynamic", "hlt", "other"
+};
+
+static const char *prof_mode_names[PROF_MODE_MAX] = {
+    "real", "v86", "pm16", "pm32"
+};
+
+struct ProfileEntry {
+    PhysPt          linear = 0;
+    Bit64u          count = 0;
+};
+
+/* key: mode(8) core(8) cs(16) eip(32) */
+static std::map<Bit64u,ProfileEntry>    prof_hist;
+static std::map<PhysPt,std::string>     prof_symbols;
+static Bit64u                           prof_samples = 0;
+static pic_tickindex_t                  prof_interval = 0.5;
+static Bit32u                           prof_seed = 0x12345678u;
+static bool                             prof_running = false;
+
+bool CPU_IsDynamicCore(void);
+Bits HLT_Decode(void);
+
+static unsigned int PROFILE_Core(void) {
+    if (CPU_IsDynamicCore())
+        return PROF_CORE_DYNAMIC;
+    if (cpudecoder == &CPU_Core_Normal_Run || cpudecoder == &CPU_Core_Normal_Trap_Run ||
+        cpudecoder == &CPU_Core286_Normal_Run || cpudecoder == &CPU_Core286_Normal_Trap_Run ||
+        cpudecoder == &CPU_Core8086_Normal_Run || cpudecoder == &CPU_Core8086_Normal_Trap_Run)
+        return PROF_CORE_NORMAL;
+    if (cpudecoder == &CPU_Core_Prefetch_Run || cpudecoder == &CPU_Core_Prefetch_Trap_Run ||
+        cpudecoder == &CPU_Core286_Prefetch_Run || cpudecoder == &CPU_Core8086_Prefetch_Run)
+        return PROF_CORE_PREFETCH;
+    if (cpudecoder == &CPU_Core_Simple_Run || cpudecoder == &CPU_Core_Simple_Trap_Run)
+        return PROF_CORE_SIMPLE;
+    if (cpudecoder == &CPU_Core_Full_Run)
+        return PROF_CORE_FULL;
+    if (cpudecoder == &HLT_Decode)
+        return PROF_CORE_HLT;
+    return PROF_CORE_OTHER;
+}
+
+static unsigned int PROFILE_Mode(void) {
+    if (!cpu.pmode) return PROF_MODE_REAL;
+    if (GETFLAG(VM)) return PROF_MODE_V86;
+    return cpu.code.big ? PROF_MODE_PM32 : PROF_MODE_PM16;
+}
+
+static pic_tickindex_t PROFILE_NextDelay(void) {
+    /* somewhere between half and one and a half of the interval */
+    prof_seed = prof_seed * 1103515245u + 12345u;
+    return prof_interval * (0.5 + (double)(prof_seed >> 8u) / (double)(1u << 24u));
+}
+
+static void PROFILE_Sample(Bitu /*val*/) {
+    const Bit16u sel = SegValue(cs);
+    const Bit32u eip = reg_eip;
+    const Bit64u key = ((Bit64u)PROFILE_Mode() << 56ull) | ((Bit64u)PROFILE_Core() << 48ull) |
+        ((Bit64u)sel << 32ull) | (Bit64u)eip;
+
+    ProfileEntry &ent = prof_hist[key];
+    ent.linear = (PhysPt)(SegPhys(cs) + eip);
+    ent.count++;
+    prof_samples++;
+
+    PIC_AddEvent(PROFILE_Sample,PROFILE_NextDelay());
+}
+
+static const char *PROFILE_Symbol(PhysPt linear,Bit32u &offset) {
+    std::map<PhysPt,std::string>::const_iterator it = prof_symbols.upper_bound(linear);
+    if (it == prof_symbols.begin()) return NULL;
+    --it;
+    offset = (Bit32u)(linear - it->first);
+    return it->second.c_str();
+}
+
+static std::string PROFILE_Routine(const ProfileEntry &ent,Bit16u sel) {
+    char tmp[32];
+    Bit32u offset;
+    const char *sym = PROFILE_Symbol(ent.linear,offset);
+    if (sym != NULL) return sym;
+    sprintf(tmp,"seg_%04X",sel);
+    return tmp;
+}
+
+void DEBUG_ProfileStart(double interval) {
+    if (interval > 0) prof_interval = interval;
+    PIC_RemoveEvents(PROFILE_Sample);
+    PIC_AddEvent(PROFILE_Sample,PROFILE_NextDelay());
+    prof_running = true;
+    LOG_MSG("PROFILE: Sampling every %.3fms of emulated time on average",(double)prof_interval);
+}
+
+void DEBUG_ProfileStop(void) {
+    PIC_RemoveEvents(PROFILE_Sample);
+    prof_running = false;
+    LOG_MSG("PROFILE: Stopped, %llu samples",(unsigned long long)prof_samples);
+}
+
+/* a reset of the machine ends the sampling, the samples are kept */
+static void PROFILE_OnReset(Section *sec) {
+    (void)sec;//UNUSED
+    if (!prof_running) return;
+    PIC_RemoveEvents(PROFILE_Sample);
+    prof_running = false;
+    LOG_MSG("PROFILE: Stopped by the reset, %llu samples",(unsigned long long)prof_samples);
+}
+
+void DEBUG_ProfileInit(void) {
+    AddVMEventFunction(VM_EVENT_RESET,AddVMEventFunctionFuncPair(PROFILE_OnReset));
+}
+
+void DEBUG_ProfileClear(void) {
+    prof_hist.clear();
+    prof_samples = 0;
+    LOG_MSG("PROFILE: Samples cleared");
+}
+
+/* One symbol per line, "SSSS:OOOO name" or "LLLLLLLL name" with hexadecimal numbers.
+ * The "Publics by Value" part of a linker .MAP file has that form. The segment of a
+ * SSSS:OOOO address is relative to the segment given, the load segment of the program. */
+bool DEBUG_ProfileLoadSymbols(const char *path,Bit16u base) {
+    FILE *fp = fopen(path,"r");
+    if (fp == NULL) {
+        LOG_MSG("PROFILE: Unable to open %s",path);
+        return false;
+    }
+
+    char line[512],name[256];
+    unsigned int seg,off;
+    unsigned int count = 0;
+    int n;
+
+    prof_symbols.clear();
+    while (fgets(line,sizeof(line),fp) != NULL) {
+        /* the number must end with a blank, so that "0001FH" of a segment list is not taken */
+        n = 0;
+        if (sscanf(line," %x:%x%n",&seg,&off,&n) == 2 && n > 0 && isspace((unsigned char)line[n]) &&
+            sscanf(line+n," %255s",name) == 1) {
+            prof_symbols[(PhysPt)(((seg + base) & 0xFFFFu) << 4u) + (PhysPt)off] = name;
+            count++;
+            continue;
+        }
+        n = 0;
+        if (sscanf(line," %x%n",&off,&n) == 1 && n > 0 && isspace((unsigned char)line[n]) &&
+            sscanf(line+n," %255s",name) == 1) {
+            prof_symbols[(PhysPt)off] = name;
+            count++;
+        }
+    }
+    fclose(fp);
+
+    LOG_MSG("PROFILE: %u symbols loaded from %s",count,path);
+    return true;
+}
+
+void DEBUG_ProfileShow(unsigned int top) {
+    LOG_MSG("PROFILE: %s, %llu samples, %u addresses, %u symbols",
+        prof_running ? "running" : "stopped",(unsigned long long)prof_samples,
+        (unsigned int)prof_hist.size(),(unsigned int)prof_symbols.size());
+    if (prof_samples == 0) return;
+
+    /* share of each core and mode */
+    Bit64u per_core[PROF_CORE_MAX] = {0};
+    Bit64u per_mode[PROF_MODE_MAX] = {0};
+    std::vector< std::pair<Bit64u,Bit64u> > order; /* count, key */
+    order.reserve(prof_hist.size());
+    for (std::map<Bit64u,ProfileEntry>::const_iterator it=prof_hist.begin();it!=prof_hist.end();++it) {
+        per_mode[(it->first >> 56ull) & 0xFFu] += it->second.count;
+        per_core[(it->first >> 48ull) & 0xFFu] += it->second.count;
+        order.push_back(std::make_pair(it->second.count,it->first));
+    }
+    for (unsigned int i=0;i < PROF_CORE_MAX;i++) {
+        if (per_core[i] != 0)
+            LOG_MSG("  core %-9s %10llu %6.2f%%",prof_core_names[i],(unsigned long long)per_core[i],
+                (double)per_core[i] * 100.0 / (double)prof_samples);
+    }
+    for (unsigned int i=0;i < PROF_MODE_MAX;i++) {
+        if (per_mode[i] != 0)
+            LOG_MSG("  mode %-9s %10llu %6.2f%%",prof_mode_names[i],(unsigned long long)per_mode[i],
+                (double)per_mode[i] * 100.0 / (double)prof_samples);
+    }
+
+    std::sort(order.begin(),order.end(),std::greater< std::pair<Bit64u,Bit64u> >());
+    if (order.size() > top) order.resize(top);
+
+    LOG_MSG("Address        Linear       Samples      %%  Mode  Core      Symbol");
+    for (size_t i=0;i < order.size();i++) {
+        const Bit64u key = order[i].second;
+        const ProfileEntry &ent = prof_hist[key];
+        Bit32u offset = 0;
+        const char *sym = PROFILE_Symbol(ent.linear,offset);
+        char symtmp[300] = "";
+        if (sym != NULL) sprintf(symtmp,"%.255s+%X",sym,offset);
+
+        LOG_MSG("%04X:%08X  %08X %10llu %6.2f  %-5s %-9s %s",
+            (unsigned int)((key >> 32ull) & 0xFFFFu),(unsigned int)(key & 0xFFFFFFFFu),
+            (unsigned int)ent.linear,(unsigned long long)ent.count,
+            (double)ent.count * 100.0 / (double)prof_samples,
+            prof_mode_names[(key >> 56ull) & 0xFFu],prof_core_names[(key >> 48ull) & 0xFFu],symtmp);
+    }
+}
+
+bool DEBUG_ProfileSave(const char *path) {
+    FILE *fp = fopen(path,"w");
+    if (fp == NULL) {
+        LOG_MSG("PROFILE: Unable to create %s",path);
+        return false;
+    }
+
+    /* core;mode;routine;address count */
+    for (std::map<Bit64u,ProfileEntry>::const_iterator it=prof_hist.begin();it!=prof_hist.end();++it) {
+        const Bit64u key = it->first;
+        const Bit16u sel = (Bit16u)(key >> 32ull);
+        fprintf(fp,"%s;%s;%s;%04X:%08X %llu\n",
+            prof_core_names[(key >> 48ull) & 0xFFu],prof_mode_names[(key >> 56ull) & 0xFFu],
+            PROFILE_Routine(it->second,sel).c_str(),(unsigned int)sel,(unsigned int)(key & 0xFFFFFFFFu),
+            (unsigned long long)it->second.count);
+    }
+    fclose(fp);
+
+    LOG_MSG("PROFILE: %u addresses written to %s",(unsigned int)prof_hist.size(),path);
+    return true;
+}
+#endif
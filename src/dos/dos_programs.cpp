@@ -43,9 +43,13 @@
 #include "setup.h"
 #include "control.h"
 #include <time.h>
+#include <chrono>
 #include "menu.h"
 #include "render.h"
+#include "vga.h"
 #include "mouse.h"
+#include "pic.h"
+#include "timer.h"
 bool Mouse_Drv=true;
 bool Mouse_Vertical = false;
 
@@ -4309,6 +4313,7 @@ static void MORE_ProgramStart(Program * * make) {
 
 void REDOS_ProgramStart(Program * * make);
 void A20GATE_ProgramStart(Program * * make);
+void IOSTATS_ProgramStart(Program * * make);
 void PC98UTIL_ProgramStart(Program * * make);
 void VESAMOED_ProgramStart(Program * * make);
 
@@ -4323,6 +4328,352 @@ static void NMITEST_ProgramStart(Program * * make) {
     *make=new NMITEST;
 }
 
+/* CPU benchmark. Each workload is a small real mode routine entered with SI = number
+ * of outer loop iterations and BP = a 128KB data segment, ending with RETF. The number
+ * of instructions it executes is known from the loop counts, a repeated string
+ * instruction counts once per element. */
+struct CPUBENCH_Workload {
+    const char *name;
+    const char *desc;
+    const Bit8u *code;
+    Bitu code_size;
+    Bitu setup;                 // instructions outside the outer loop
+    Bitu per_outer;             // instructions per outer loop iteration
+    Bitu outer;                 // default outer loop iterations
+    bool fpu;
+};
+
+static const Bit8u cpubench_alu[] = {
+    0xB9,0x00,0x80,             // 00: mov cx,8000h
+    0x01,0xD8,                  // 03: add ax,bx
+    0x31,0xCB,                  //     xor bx,cx
+    0xD1,0xE0,                  //     shl ax,1
+    0x11,0xC7,                  //     adc di,ax
+    0x29,0xFA,                  //     sub dx,di
+    0x49,                       //     dec cx
+    0x75,0xF3,                  //     jnz 03
+    0x4E,                       //     dec si
+    0x75,0xED,                  //     jnz 00
+    0xCB                        //     retf
+};
+
+static const Bit8u cpubench_string[] = {
+    0xFC,                       //     cld
+    0x8E,0xDD,                  //     mov ds,bp
+    0x8D,0x86,0x00,0x08,        //     lea ax,[bp+800h]
+    0x8E,0xC0,                  //     mov es,ax
+    0xB9,0x00,0x40,             // 09: mov cx,4000h
+    0x31,0xFF,                  //     xor di,di
+    0xF3,0xAB,                  //     rep stosw
+    0x56,                       //     push si
+    0xB9,0x00,0x40,             //     mov cx,4000h
+    0x31,0xF6,                  //     xor si,si
+    0x31,0xFF,                  //     xor di,di
+    0xF3,0xA5,                  //     rep movsw
+    0xB9,0x00,0x40,             //     mov cx,4000h
+    0x31,0xF6,                  //     xor si,si
+    0x31,0xFF,                  //     xor di,di
+    0xF3,0xA7,                  //     repe cmpsw
+    0x5E,                       //     pop si
+    0x4E,                       //     dec si
+    0x75,0xE2,                  //     jnz 09
+    0x0E,                       //     push cs
+    0x1F,                       //     pop ds
+    0xCB                        //     retf
+};
+
+static const Bit8u cpubench_fpu[] = {
+    0xDB,0xE3,                  //     fninit
+    0xD9,0xE8,                  //     fld1
+    0xD9,0xEE,                  //     fldz
+    0xB9,0x00,0x20,             // 06: mov cx,2000h
+    0xD8,0xC1,                  // 09: fadd st,st(1)
+    0xD8,0xC9,                  //     fmul st,st(1)
+    0xD9,0xC0,                  //     fld st(0)
+    0xD9,0xFA,                  //     fsqrt
+    0xDD,0xD8,                  //     fstp st(0)
+    0x49,                       //     dec cx
+    0x75,0xF3,                  //     jnz 09
+    0x4E,                       //     dec si
+    0x75,0xED,                  //     jnz 06
+    0xDB,0xE3,                  //     fninit
+    0xCB                        //     retf
+};
+
+static const Bit8u cpubench_pages[] = {
+    0x30,0xDB,                  //     xor bl,bl
+    0xB9,0x00,0x80,             // 02: mov cx,8000h
+    0x88,0xCF,                  // 05: mov bh,cl
+    0x80,0xE7,0x1F,             //     and bh,1Fh
+    0x01,0xEB,                  //     add bx,bp
+    0x8E,0xC3,                  //     mov es,bx
+    0x26,0xA1,0x00,0x00,        //     mov ax,es:[0]
+    0x26,0x01,0x06,0x02,0x00,   //     add es:[2],ax
+    0x30,0xDB,                  //     xor bl,bl
+    0x49,                       //     dec cx
+    0x75,0xE9,                  //     jnz 05
+    0x4E,                       //     dec si
+    0x75,0xE3,                  //     jnz 02
+    0xCB                        //     retf
+};
+
+static const Bit8u cpubench_smc[] = {
+    0xB9,0x00,0x10,             // 00: mov cx,1000h
+    0x2E,0x88,0x0E,0x09,0x00,   // 03: mov cs:[09],cl
+    0x05,0x34,0x12,             // 08: add ax,1234h
+    0x49,                       //     dec cx
+    0x75,0xF5,                  //     jnz 03
+    0x4E,                       //     dec si
+    0x75,0xEF,                  //     jnz 00
+    0xCB                        //     retf
+};
+
+static const Bit8u cpubench_io[] = {
+    0xBA,0xDA,0x03,             //     mov dx,3DAh
+    0xB9,0x00,0x10,             // 03: mov cx,1000h
+    0xE4,0x61,                  // 06: in al,61h
+    0xEC,                       //     in al,dx
+    0x49,                       //     dec cx
+    0x75,0xFA,                  //     jnz 06
+    0x4E,                       //     dec si
+    0x75,0xF4,                  //     jnz 03
+    0xCB                        //     retf
+};
+
+static const CPUBENCH_Workload cpubench_workloads[] = {
+    {"alu",   "integer ALU loop",                cpubench_alu,   sizeof(cpubench_alu),   1, 3+0x8000*7,  128,false},
+    {"string","REP STOSW/MOVSW/CMPSW, 32KB",     cpubench_string,sizeof(cpubench_string),7, 12+0x4000*3, 512,false},
+    {"fpu",   "FADD/FMUL/FSQRT loop",            cpubench_fpu,   sizeof(cpubench_fpu),   5, 3+0x2000*7,  256,true },
+    {"pages", "loads/stores spread over 32 pages",cpubench_pages,sizeof(cpubench_pages), 2, 3+0x8000*9,  96, false},
+    {"smc",   "self-modifying code",             cpubench_smc,   sizeof(cpubench_smc),   1, 3+0x1000*4,  256,false},
+    {"io",    "port 61h/3DAh reads",             cpubench_io,    sizeof(cpubench_io),    2, 3+0x1000*4,  256,false}
+};
+
+/* the outer loop count is kept in SI, /N is limited so it stays below 10000h for every workload */
+static int CPUBENCH_MaxScale(void) {
+    Bitu outer = 1;
+    for (size_t i=0;i < sizeof(cpubench_workloads)/sizeof(cpubench_workloads[0]);i++)
+        if (cpubench_workloads[i].outer > outer) outer = cpubench_workloads[i].outer;
+    return (int)(0xFFFFu / outer);
+}
+
+#if (C_DYNAMIC_X86)
+void CPU_Core_Dyn_X86_Cache_Init(bool enable_cache);
+#elif (C_DYNREC)
+void CPU_Core_Dynrec_Cache_Init(bool enable_cache);
+#endif
+extern bool enable_fpu;
+
+class CPUBENCH : public Program {
+public:
+    static CPU_Decoder *FindCore(const std::string &name) {
+        if (name == "normal") return &CPU_Core_Normal_Run;
+#if !defined(C_EMSCRIPTEN)
+        if (name == "simple") return &CPU_Core_Simple_Run;
+        if (name == "full") return &CPU_Core_Full_Run;
+#endif
+        if (name == "prefetch") return &CPU_Core_Prefetch_Run;
+#if (C_DYNAMIC_X86)
+        if (name == "dynamic") {
+            CPU_Core_Dyn_X86_Cache_Init(true);
+            return &CPU_Core_Dyn_X86_Run;
+        }
+#elif (C_DYNREC)
+        if (name == "dynamic") {
+            CPU_Core_Dynrec_Cache_Init(true);
+            return &CPU_Core_Dynrec_Run;
+        }
+#endif
+        return NULL;
+    }
+
+    /*! \brief      Program entry point, when the command is run */
+    void Run(void) {
+        if (cmd->FindExist("/?",false)) {
+            WriteOut("Runs CPU workloads and reports the emulated instructions per host second.\n\n");
+            WriteOut("CPUBENCH [workload ...] [/CORE:core] [/CYCLES:n] [/N:n]\n");
+            WriteOut("  workload  one or more of the following, default all\n");
+            for (size_t i=0;i < sizeof(cpubench_workloads)/sizeof(cpubench_workloads[0]);i++)
+                WriteOut("    %-8s%s\n",cpubench_workloads[i].name,cpubench_workloads[i].desc);
+            WriteOut("  /CORE     normal, simple, full, prefetch or dynamic, default the current core\n");
+            WriteOut("  /CYCLES   cycles per emulated millisecond to run with, default 200000\n");
+            WriteOut("  /N        run each workload n times longer (1-%d), default 1\n\n",CPUBENCH_MaxScale());
+            WriteOut("The workloads run in virtual time with interrupts disabled, so the results do not\n");
+            WriteOut("depend on the cycles setting or the host clock. A REP string instruction counts\n");
+            WriteOut("once per element.\n");
+            return;
+        }
+
+        CPU_Decoder *core = cpudecoder;
+        std::string core_name = "current";
+        int cycles = 200000;
+        int scale = 1;
+        std::vector<const CPUBENCH_Workload*> run;
+
+        for (unsigned int i=1;cmd->FindCommand(i,temp_line);i++) {
+            lowcase(temp_line);
+            if (temp_line.compare(0,6,"/core:") == 0) {
+                core_name = temp_line.substr(6);
+                core = FindCore(core_name);
+                if (core == NULL) {
+                    WriteOut("Core %s is not available\n",core_name.c_str());
+                    return;
+                }
+            }
+            else if (temp_line.compare(0,8,"/cycles:") == 0) {
+                cycles = atoi(temp_line.c_str()+8);
+            }
+            else if (temp_line.compare(0,3,"/n:") == 0) {
+                scale = atoi(temp_line.c_str()+3);
+            }
+            else {
+                const CPUBENCH_Workload *w = NULL;
+                for (size_t j=0;j < sizeof(cpubench_workloads)/sizeof(cpubench_workloads[0]);j++) {
+                    if (temp_line == cpubench_workloads[j].name) w = &cpubench_workloads[j];
+                }
+                if (w == NULL) {
+                    WriteOut("Unknown workload %s\n",temp_line.c_str());
+                    return;
+                }
+                run.push_back(w);
+            }
+        }
+        if (cycles < 100 || scale < 1 || scale > CPUBENCH_MaxScale()) {
+            WriteOut("Invalid /CYCLES or /N value\n");
+            return;
+        }
+        if (run.empty()) {
+            for (size_t j=0;j < sizeof(cpubench_workloads)/sizeof(cpubench_workloads[0]);j++)
+                run.push_back(&cpubench_workloads[j]);
+        }
+
+        /* 1KB of code followed by 128KB of data */
+        Bit16u seg,blocks = 0x40 + 0x2000;
+        if (!DOS_AllocateMemory(&seg,&blocks)) {
+            WriteOut("Not enough conventional memory, 129KB needed\n");
+            return;
+        }
+
+        WriteOut("Core %s, %d cycles per emulated ms\n\n",core_name.c_str(),cycles);
+        WriteOut("Workload       Instructions   Host ms       MIPS  Emulated ms\n");
+
+        const CPU_Regs saved_regs = cpu_regs;
+        const Bit16u saved_ds = SegValue(ds),saved_es = SegValue(es);
+        CPU_Decoder * const saved_core = cpudecoder;
+        const cpu_cycles_count_t saved_max = CPU_CycleMax;
+        const bool saved_auto = CPU_CycleAutoAdjust;
+        const bool saved_virtual = ticksVirtual;
+        double total_instr = 0,total_sec = 0;
+
+        for (size_t i=0;i < run.size();i++) {
+            const CPUBENCH_Workload &w = *run[i];
+            if (w.fpu && !enable_fpu) {
+                WriteOut("%-10s     skipped, no FPU\n",w.name);
+                continue;
+            }
+
+            MEM_BlockWrite(PhysMake(seg,0),w.code,w.code_size);
+            const Bitu outer = w.outer * (Bitu)scale;
+            const double instr = (double)w.setup + (double)outer * (double)w.per_outer;
+
+            reg_esi = (Bit32u)outer;
+            reg_ebp = (Bit32u)(seg + 0x40);
+            SETFLAGBIT(IF,false);
+            cpudecoder = core;
+            CPU_CycleMax = (cpu_cycles_count_t)cycles;
+            CPU_CycleAutoAdjust = false;
+            ticksVirtual = true;
+
+            const double emu_start = PIC_FullIndex();
+            const auto host_start = std::chrono::steady_clock::now();
+            CALLBACK_RunRealFar(seg,0);
+            const double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - host_start).count();
+            const double emu_ms = PIC_FullIndex() - emu_start;
+
+            ticksVirtual = saved_virtual;
+            CPU_CycleAutoAdjust = saved_auto;
+            CPU_CycleMax = saved_max;
+            cpudecoder = saved_core;
+            cpu_regs = saved_regs;
+            SegSet16(ds,saved_ds);
+            SegSet16(es,saved_es);
+
+            total_instr += instr;
+            total_sec += sec;
+            WriteOut("%-10s %16.0f %9.0f %10.2f %12.0f\n",w.name,instr,sec * 1000,sec > 0 ? instr / sec / 1e6 : 0.0,emu_ms);
+        }
+
+        DOS_FreeMemory(seg);
+        if (total_sec > 0) WriteOut("%-10s %16.0f %9.0f %10.2f\n","total",total_instr,total_sec * 1000,total_instr / total_sec / 1e6);
+    }
+};
+
+static void CPUBENCH_ProgramStart(Program * * make) {
+    *make=new CPUBENCH;
+}
+
+/* every converter runs /N lines twice on the emulation thread, /N times /W is limited to
+ * ten times the default to keep that to some seconds */
+static const unsigned int VGABENCH_MaxPixels = 640u * 1000000u;
+
+/* Benchmark of the VGA scanline converters, the same line through the scalar and the
+ * SIMD version of each one. */
+
+class VGABENCH : public Program {
+public:
+    /*! \brief      Program entry point, when the command is run */
+    void Run(void) {
+        if (cmd->FindExist("/?",false)) {
+            WriteOut("Measures the VGA scanline converters with and without SIMD instructions.\n\n");
+            WriteOut("VGABENCH [/W:width] [/N:lines]\n");
+            WriteOut("  /W        pixels per line, default 640\n");
+            WriteOut("  /N        lines converted by each converter, default 100000\n");
+            WriteOut("            /N times /W is at most %u\n\n",VGABENCH_MaxPixels);
+            WriteOut("Results are in millions of pixels per host second. The lines use the current\n");
+            WriteOut("palette, the emulation is stopped while the benchmark runs.\n");
+            return;
+        }
+
+        int width = 640;
+        int lines = 100000;
+
+        for (unsigned int i=1;cmd->FindCommand(i,temp_line);i++) {
+            lowcase(temp_line);
+            if (temp_line.compare(0,3,"/w:") == 0) {
+                width = atoi(temp_line.c_str()+3);
+            }
+            else if (temp_line.compare(0,3,"/n:") == 0) {
+                lines = atoi(temp_line.c_str()+3);
+            }
+            else {
+                WriteOut("Unknown option %s\n",temp_line.c_str());
+                return;
+            }
+        }
+        if (width < 1 || width > 8192 || lines < 1 || (unsigned int)lines > VGABENCH_MaxPixels / (unsigned int)width) {
+            WriteOut("Invalid width or number of lines\n");
+            return;
+        }
+
+        std::vector<VGA_DrawBenchResult> res;
+        VGA_DrawBenchmark(res,(unsigned int)width,(unsigned int)lines);
+
+        WriteOut("%-20s %10s %10s %8s\n","converter","scalar","SIMD","speedup");
+        for (size_t i=0;i < res.size();i++) {
+            const VGA_DrawBenchResult &r = res[i];
+            if (r.simd <= 0)
+                WriteOut("%-20s %10.1f %10s %8s\n",r.name,r.scalar,"-","-");
+            else
+                WriteOut("%-20s %10.1f %10.1f %7.2fx%s\n",r.name,r.scalar,r.simd,
+                    r.scalar > 0 ? r.simd / r.scalar : 0.0,r.same ? "" : " MISMATCH");
+        }
+    }
+};
+
+static void VGABENCH_ProgramStart(Program * * make) {
+    *make=new VGABENCH;
+}
+
 class CAPMOUSE : public Program
 {
 public:
@@ -4906,6 +5257,9 @@ void DOS_SetupPrograms(void) {
     PROGRAMS_MakeFile("A20GATE.COM",A20GATE_ProgramStart);
     PROGRAMS_MakeFile("SHOWGUI.COM",SHOWGUI_ProgramStart);
     PROGRAMS_MakeFile("NMITEST.COM",NMITEST_ProgramStart);
+    PROGRAMS_MakeFile("CPUBENCH.COM",CPUBENCH_ProgramStart);
+    PROGRAMS_MakeFile("VGABENCH.COM",VGABENCH_ProgramStart);
+    PROGRAMS_MakeFile("IOSTATS.COM",IOSTATS_ProgramStart);
     PROGRAMS_MakeFile("RE-DOS.COM",REDOS_ProgramStart);
 
     if (IS_VGA_ARCH && svgaCard != SVGA_None)
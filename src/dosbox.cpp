@@ -74,6 +74,7 @@
 #include "pci_bus.h"
 #include "parport.h"
 #include "clockdomain.h"
+#include "replay.h"
 
 #if C_EMSCRIPTEN
 # include <emscripten.h>
@@ -87,8 +88,10 @@
 #include <list>
 
 /*===================================TODO: Move to it's own file==============================*/
-#if defined(__SSE__) && !defined(_M_AMD64)
+/* x86-64 always has SSE2, but SSSE3 still needs the CPUID check there */
+#if defined(__SSE__)
 bool sse2_available = false;
+bool ssse3_available = false;
 
 # ifdef __GNUC__
 #  define cpuid(func,ax,bx,cx,dx)\
@@ -96,7 +99,13 @@ bool sse2_available = false;
     "=a" (ax), "=b" (bx), "=c" (cx), "=d" (dx) : "a" (func));
 # endif /* __GNUC__ */
 
-# if defined(_MSC_VER)
+# if defined(_MSC_VER) && defined(_M_AMD64)
+#  include <intrin.h>
+#  define cpuid(func,a,b,c,d) {\
+    int cpuinfo[4];\
+    __cpuid(cpuinfo,func);\
+    a = (Bitu)cpuinfo[0]; b = (Bitu)cpuinfo[1]; c = (Bitu)cpuinfo[2]; d = (Bitu)cpuinfo[3]; }
+# elif defined(_MSC_VER)
 #  define cpuid(func,a,b,c,d)\
     __asm mov eax, func\
     __asm cpuid\
@@ -112,6 +121,7 @@ void CheckSSESupport()
     Bitu a, b, c, d;
     cpuid(1, a, b, c, d);
     sse2_available = ((d >> 26) & 1)?true:false;
+    ssse3_available = ((c >> 9) & 1)?true:false;
 #endif
 }
 #endif
@@ -171,6 +181,8 @@ bool                SDLNetInited;
 Bit32s              ticksDone;
 Bit32u              ticksScheduled;
 bool                ticksLocked;
+bool                ticksVirtual = false;   // virtual time, emulated time advances as fast as the emulation runs
+bool                ticksGuestPauses = false;   // the BIOS and shell pauses count emulated time (see GetGuestTicks)
 bool                mono_cga=false;
 bool                ignore_opcode_63 = true;
 int             dynamic_core_cache_block_size = 32;
@@ -370,7 +382,7 @@ static Bitu Normal_Loop(void) {
                     return 0;
 #endif
             } else {
-                GFX_Events();
+                REPLAY_Events();
                 if (DOSBox_Paused() == false && ticksRemain > 0) {
                     TIMER_AddTick();
                     ticksRemain--;
@@ -406,6 +418,17 @@ static Bitu Normal_Loop(void) {
 void increaseticks() { //Make it return ticksRemain and set it in the function above to remove the global variable.
     static Bit32s lastsleepDone = -1;
     static Bitu sleep1count = 0;
+    if (GCC_UNLIKELY(ticksVirtual)) { // Virtual time, never wait for the host clock
+        /* The cycles are left as they are (no auto adjustment against the host clock) so a run
+         * with fixed cycles executes the same instructions per emulated millisecond every time. */
+        ticksRemainSpeedFrac = 0;
+        ticksRemain = 20;
+        ticksLast = GetTicks();
+        ticksAdded = 0;
+        ticksDone = 0;
+        ticksScheduled = 0;
+        return;
+    }
     if (GCC_UNLIKELY(ticksLocked)) { // For Fast Forward Mode
         ticksRemainSpeedFrac = 0;
         ticksRemain = 5;
@@ -845,6 +868,13 @@ void DOSBOX_RealInit() {
     //       on the title= setting now to auto-update the titlebar when this changes.
     dosbox_title = section->Get_string("title");
 
+    ticksVirtual = section->Get_bool("virtual time") || control->opt_virtual_time;
+    if (ticksVirtual) LOG_MSG("Virtual time: emulation is not paced to the host clock, host audio output is muted");
+
+    /* a replay switches to virtual time itself */
+    REPLAY_Init(control->opt_record.c_str(),control->opt_replay.c_str());
+    ticksGuestPauses = ticksVirtual || replay_mode != REPLAY_OFF;
+
     // TODO: these should be parsed by DOS kernel at startup
     dosbox_shell_env_size = (unsigned int)section->Get_int("shell environment size");
 
@@ -1092,7 +1122,7 @@ void DOSBOX_SetupConfigSections(void) {
         0
     };
 
-#if defined(__SSE__) && !defined(_M_AMD64) && !defined(EMSCRIPTEN)
+#if defined(__SSE__) && !defined(EMSCRIPTEN)
     CheckSSESupport();
 #endif
     SDLNetInited = false;
@@ -1104,6 +1134,12 @@ void DOSBOX_SetupConfigSections(void) {
     Pstring = secprop->Add_path("title",Property::Changeable::Always,"");
     Pstring->Set_help("Additional text to place in the title bar of the window");
 
+    Pbool = secprop->Add_bool("virtual time",Property::Changeable::OnlyAtStart,false);
+    Pbool->Set_help("If set, emulated time is not paced to the host clock but advances as fast as the emulation runs, without\n"
+            "sleeping. Host audio output is muted, audio and video capture still record in emulated time. Use fixed cycles for\n"
+            "runs that behave the same every time. Meant for automated tests, see also the -time-limit command line option.\n"
+            "The -virtual-time command line option sets this as well.");
+
     Pbool = secprop->Add_bool("enable 8-bit dac",Property::Changeable::OnlyAtStart,true);
     Pbool->Set_help("If set, allow VESA BIOS calls in IBM PC mode to set DAC width. Has no effect in PC-98 mode.");
 
@@ -1412,6 +1448,13 @@ void DOSBOX_SetupConfigSections(void) {
         "        or 386DX and 486 systems where the CPU communicated directly with the ISA bus (A24-A31 tied off)\n"
         "    26: 64MB aliasing. Some 486s had only 26 external address bits, some motherboards tied off A26-A31");
 
+    Pstring = secprop->Add_path("shared rom cache",Property::Changeable::WhenIdle,"");
+    Pstring->Set_help(
+        "Directory where the ROM BIOS, VGA BIOS and PC-98 font images are kept as files.\n"
+        "Instances using the same directory map the same files and share the memory of\n"
+        "the images instead of each holding a copy. A directory on a RAM disk like /dev/shm works well.\n"
+        "Leave empty to disable. Not available on Windows.");
+
     Pbool = secprop->Add_bool("pc-98 BIOS copyright string",Property::Changeable::WhenIdle,false);
     Pbool->Set_help("If set, the PC-98 BIOS copyright string is placed at E800:0000. Enable this for software that detects PC-98 vs Epson.");
 
@@ -1680,6 +1723,17 @@ void DOSBOX_SetupConfigSections(void) {
             "the larger the number, the more averaging is applied. This is intended to emulate the inertia\n"
             "of the electron beam in a CRT monitor");
 
+    Pbool = secprop->Add_bool("skip unchanged scanlines",Property::Changeable::Always,true);
+    Pbool->Set_help("If set, scanlines of EGA/VGA text and 16-color modes (and 320x200 256-color mode) are only converted\n"
+            "again if the video memory they show or the palette or display registers were written since.\n"
+            "This saves host CPU time on mostly static screens. Modes where the guest writes video memory\n"
+            "directly (SVGA, linear framebuffer, CGA/Tandy/Hercules) always convert every scanline.");
+
+    Pbool = secprop->Add_bool("skip unchanged frames",Property::Changeable::Always,true);
+    Pbool->Set_help("If set, a frame of the same modes is not drawn at all if neither video memory nor the palette or\n"
+            "display registers were written since the last frame. The host window is then not updated either,\n"
+            "which brings the host CPU and GPU load of an idle DOS screen close to zero.");
+
     Pint = secprop->Add_int("vesa modelist cap",Property::Changeable::Always,0);
     Pint->Set_help("IF nonzero, the VESA modelist is capped so that it contains no more than the specified number of video modes.");
 
@@ -1793,6 +1847,11 @@ void DOSBOX_SetupConfigSections(void) {
     Pbool = secprop->Add_bool("alt render",Property::Changeable::Always,false);
     Pbool->Set_help("If set, use a new experimental rendering engine");
 
+    Pbool = secprop->Add_bool("render thread",Property::Changeable::OnlyAtStart,false);
+    Pbool->Set_help("If set, the scaler runs on a thread of its own, behind the emulated raster, instead of the emulation thread.\n"
+                    "This keeps the cost of expensive scalers like hq3x or 2xsai off the emulation. The frame is presented once\n"
+                    "the render thread has scaled its last line.");
+
     Pstring = secprop->Add_string("aspect", Property::Changeable::Always, "false");
     Pstring->Set_values(aspectmodes);
     Pstring->Set_help(
@@ -1867,6 +1926,11 @@ void DOSBOX_SetupConfigSections(void) {
     Pint = secprop->Add_int("xbrz max scale factor",Property::Changeable::OnlyAtStart, 0);
     Pint->SetMinMax(0,6);
     Pint->Set_help("To cap maximum xBRZ scale factor used (i.e. to attune performance), set it to 2-6, 0 - use scaler allowed maximum (default)");
+
+    Pint = secprop->Add_int("xbrz threads",Property::Changeable::OnlyAtStart, 0);
+    Pint->SetMinMax(0,64);
+    Pint->Set_help("Number of threads sharing the xBRZ scaler work, the emulation thread included, 0 - one per host CPU (default).\n"
+                   "Builds using the Microsoft PPL (Visual Studio) size their own thread pool and ignore this setting.");
 #endif
 
     Pbool = secprop->Add_bool("autofit",Property::Changeable::Always,true);
@@ -1956,6 +2020,31 @@ void DOSBOX_SetupConfigSections(void) {
             "also causes problems with 32-bit protected mode DOS games and reduces the performance\n"
             "of the dynamic core.\n");
 
+    Pint = secprop->Add_int("dynamic core cache size",Property::Changeable::OnlyAtStart,8);
+    Pint->SetMinMax(1,512);
+    Pint->Set_help("Size of the dynamic core code cache in megabytes. When the cache is full, the code that has not been run\n"
+            "for the longest time is replaced first. Large protected mode programs (Windows 9x for example) run more smoothly\n"
+            "with a larger cache.");
+
+    Pstring = secprop->Add_string("dynamic core persistent cache",Property::Changeable::Always,"");
+    Pstring->Set_help("If set, the dynamic core saves a translation profile to this file on exit. The profile lists which code\n"
+            "blocks were translated, keyed by a hash of the guest memory page contents and the CPU mode. When the same code\n"
+            "is run again, the known blocks of a page are translated in one go instead of one at a time while running.\n"
+            "A relative path is relative to the directory of the last loaded config file. Leave empty to disable.");
+
+    Pbool = secprop->Add_bool("dynamic core fast fpu",Property::Changeable::Always,true);
+    Pbool->Set_help("If set, the dynamic core translates common FPU instructions (FADD, FMUL, FSUB, FDIV, FLD, FST, FCOM on\n"
+            "registers and memory operands) into host FPU code on 64-bit x86 hosts. This is a lot faster. The precision and\n"
+            "rounding settings of the guest control word apply and the exception flags of the status word are kept.\n"
+            "Turn this off to use the helper functions. Only affects code translated after the setting is changed.");
+
+    Pint = secprop->Add_int("dynamic core data hot threshold",Property::Changeable::Always,128);
+    Pint->SetMinMax(0,1000000);
+    Pint->Set_help("If writes invalidate the translated code of a memory page this many times within a second, the dynamic core\n"
+            "stops translating the page and runs it with the normal core for a while. This avoids retranslating the same\n"
+            "code over and over when code and often written data share a page, or when code modifies itself a lot.\n"
+            "Set to 0 to always translate.");
+
     Pstring = secprop->Add_string("cputype",Property::Changeable::Always,"auto");
     Pstring->Set_values(cputype_values);
     Pstring->Set_help("CPU Type used in emulation. auto emulates a 486 which tolerates Pentium instructions.");
@@ -1991,6 +2080,12 @@ void DOSBOX_SetupConfigSections(void) {
                     "If the game becomes unstable, turn off this option.\n"
                     "WARNING: Do NOT use this option with preemptive multitasking OSes including Windows 95 and Windows NT.");
             
+    Pbool = secprop->Add_bool("idle skip",Property::Changeable::Always,false);
+    Pbool->Set_help("Skip the iterations of polling loops that only read memory and I/O ports (waiting for the retrace on 3DAh,\n"
+            "the BIOS tick count or the keyboard) up to the next event, like HLT does. The emulated time advances exactly as\n"
+            "if the loop had run, but an idle guest uses much less host CPU time. Only the normal, simple and prefetch cores\n"
+            "detect these loops.");
+
     Pbool = secprop->Add_bool("ignore opcode 63",Property::Changeable::Always,true);
     Pbool->Set_help("When debugging, do not report illegal opcode 0x63.\n"
             "Enable this option to ignore spurious errors while debugging from within Windows 3.1/9x/ME");
@@ -20,6 +20,8 @@
 #include <sys/types.h>
 #include <assert.h>
 #include <math.h>
+#include <vector>
+#include <algorithm>
 
 #include "dosbox.h"
 #include "video.h"
@@ -119,6 +121,198 @@ static void RENDER_EmptyLineHandler(const void * src) {
     (void)src;//UNUSED
 }
 
+/* Render thread ("render thread" in [render]).
+ *
+ * The scalers run on a thread of their own while the emulation goes on. The lines the
+ * VGA emulation hands to RENDER_DrawLine are copied into a buffer that the render thread
+ * works through behind the raster, scaling into a frame buffer of its own. At the end of
+ * the frame the emulation thread waits for the last lines, then copies the changed lines
+ * to the output and presents it, because the output (SDL surface, OpenGL, Direct3D) can
+ * only be used from the thread that created it.
+ *
+ * The line handlers below switch the handler of the next line as they go. They do so
+ * through render_scaleline, which is RENDER_DrawLine itself when the scalers run inline. */
+static struct {
+    bool                enable = false;
+    SDL_Thread*         thread = NULL;
+    SDL_mutex*          lock = NULL;
+    SDL_sem*            work = NULL;    /* wakes the render thread */
+    SDL_sem*            idle = NULL;    /* the render thread caught up with the lines */
+    bool                sleeping = false;
+    bool                waiting = false;
+    bool                quit = false;
+    std::vector<Bit8u>  lines;          /* source lines, linePitch apart */
+    Bitu                linePitch = 0;
+    Bitu                lineCount = 0;
+    Bitu                written = 0;    /* lines copied (emulation thread only) */
+    Bitu                produced = 0;   /* lines handed to the render thread */
+    Bitu                consumed = 0;   /* lines scaled */
+    ScalerLineHandler_t drawLine = RENDER_EmptyLineHandler;
+    std::vector<Bit8u>  out;            /* the scaled frame */
+    Bitu                outPitch = 0;
+    Bitu                outHeight = 0;
+} render_thread;
+
+static ScalerLineHandler_t *render_scaleline = &RENDER_DrawLine;
+
+static int RENDER_ThreadMain(void *data) {
+    (void)data;//UNUSED
+
+    SDL_LockMutex(render_thread.lock);
+    for (;;) {
+        if (render_thread.quit) break;
+        if (render_thread.consumed == render_thread.produced) {
+            if (render_thread.waiting) {
+                render_thread.waiting = false;
+                SDL_SemPost(render_thread.idle);
+            }
+            render_thread.sleeping = true;
+            SDL_UnlockMutex(render_thread.lock);
+            SDL_SemWait(render_thread.work);
+            SDL_LockMutex(render_thread.lock);
+            continue;
+        }
+
+        const Bitu first = render_thread.consumed;
+        const Bitu last = render_thread.produced;
+        SDL_UnlockMutex(render_thread.lock);
+
+        for (Bitu i=first;i < last;i++)
+            render_thread.drawLine(&render_thread.lines[i * render_thread.linePitch]);
+
+        SDL_LockMutex(render_thread.lock);
+        render_thread.consumed = last;
+    }
+    SDL_UnlockMutex(render_thread.lock);
+
+    return 0;
+}
+
+static void RENDER_ThreadPublish(void) {
+    SDL_LockMutex(render_thread.lock);
+    render_thread.produced = render_thread.written;
+    const bool wake = render_thread.sleeping && render_thread.consumed != render_thread.produced;
+    if (wake) render_thread.sleeping = false;
+    SDL_UnlockMutex(render_thread.lock);
+
+    if (wake) SDL_SemPost(render_thread.work);
+}
+
+/* wait for the render thread to scale all the lines so far, the line buffer is empty afterwards */
+static void RENDER_ThreadSync(void) {
+    if (render_thread.thread == NULL) return;
+
+    RENDER_ThreadPublish();
+
+    SDL_LockMutex(render_thread.lock);
+    const bool wait = render_thread.consumed != render_thread.produced;
+    render_thread.waiting = wait;
+    SDL_UnlockMutex(render_thread.lock);
+
+    if (wait) SDL_SemWait(render_thread.idle);
+
+    SDL_LockMutex(render_thread.lock);
+    render_thread.written = render_thread.produced = render_thread.consumed = 0;
+    SDL_UnlockMutex(render_thread.lock);
+}
+
+static void RENDER_ThreadLineHandler(const void * s) {
+    if (GCC_UNLIKELY(render_thread.lineCount == 0))
+        return;
+    if (GCC_UNLIKELY(render_thread.written == render_thread.lineCount))
+        RENDER_ThreadSync();
+
+    memcpy(&render_thread.lines[render_thread.written * render_thread.linePitch],s,render.scale.cachePitch);
+    if ((++render_thread.written & 15) == 0)
+        RENDER_ThreadPublish();
+}
+
+static void RENDER_ThreadInit(void) {
+    if (render_thread.thread != NULL) return;
+
+    render_thread.lock = SDL_CreateMutex();
+    render_thread.work = SDL_CreateSemaphore(0);
+    render_thread.idle = SDL_CreateSemaphore(0);
+    if (render_thread.lock != NULL && render_thread.work != NULL && render_thread.idle != NULL) {
+#if defined(C_SDL2)
+        render_thread.thread = SDL_CreateThread(RENDER_ThreadMain, "Render", NULL);
+#else
+        render_thread.thread = SDL_CreateThread(RENDER_ThreadMain, NULL);
+#endif
+    }
+
+    if (render_thread.thread == NULL) {
+        LOG_MSG("RENDER: Unable to start the render thread, scaling on the emulation thread");
+        render_thread.enable = false;
+        return;
+    }
+
+    render_scaleline = &render_thread.drawLine;
+}
+
+/* the render thread must be gone before SDL quits, the scalers run inline afterwards */
+static void RENDER_ThreadShutDown(void) {
+    if (render_thread.thread != NULL) {
+        RENDER_ThreadSync();
+
+        SDL_LockMutex(render_thread.lock);
+        render_thread.quit = true;
+        const bool wake = render_thread.sleeping;
+        render_thread.sleeping = false;
+        SDL_UnlockMutex(render_thread.lock);
+
+        if (wake) SDL_SemPost(render_thread.work);
+        SDL_WaitThread(render_thread.thread, NULL);
+        render_thread.thread = NULL;
+        render_thread.quit = false;
+    }
+
+    if (render_thread.idle != NULL) SDL_DestroySemaphore(render_thread.idle);
+    if (render_thread.work != NULL) SDL_DestroySemaphore(render_thread.work);
+    if (render_thread.lock != NULL) SDL_DestroyMutex(render_thread.lock);
+    render_thread.idle = render_thread.work = NULL;
+    render_thread.lock = NULL;
+
+    render_thread.enable = false;
+    render_scaleline = &RENDER_DrawLine;
+}
+
+/* where the scalers write: the frame of the render thread, or the output itself */
+static bool RENDER_StartOutput(void) {
+    if (render_thread.enable) {
+        if (render_thread.out.empty()) return false;
+        render.scale.outWrite = &render_thread.out[0];
+        render.scale.outPitch = render_thread.outPitch;
+        return true;
+    }
+
+    return GFX_StartUpdate( render.scale.outWrite, render.scale.outPitch );
+}
+
+static void RENDER_ThreadPresent(bool abort) {
+    Bit8u *pixels;
+    Bitu pitch;
+
+    /* the output missed the lines scaled this frame */
+    if (abort || !GFX_StartUpdate(pixels,pitch)) {
+        render.scale.clearCache = true;
+        return;
+    }
+
+    const Bitu bytes = std::min(pitch,render_thread.outPitch);
+    Bitu y = 0;
+    for (Bitu i=0;i <= Scaler_ChangedLineIndex;i++) {
+        const Bitu count = Scaler_ChangedLines[i];
+        if (i & 1) {
+            for (Bitu l=y;l < (y+count) && l < render_thread.outHeight;l++)
+                memcpy(pixels + l*pitch,&render_thread.out[l*render_thread.outPitch],bytes);
+        }
+        y += count;
+    }
+
+    GFX_EndUpdate( Scaler_ChangedLines );
+}
+
 /*HACK*/
 #if defined(__SSE__) && defined(_M_AMD64)
 # define sse2_available (1) /* SSE2 is always available on x86_64 */
@@ -206,15 +400,15 @@ static void RENDER_DrawLine_countdown_wait(const void * s) {
     }
     else {
         RENDER_scaler_countdown = RENDER_scaler_countdown_init;
-        RENDER_DrawLine = RENDER_DrawLine_countdown;
-        RENDER_DrawLine( s );
+        *render_scaleline = RENDER_DrawLine_countdown;
+        (*render_scaleline)( s );
     }
 }
 
 static void RENDER_DrawLine_countdown(const void * s) {
     render.scale.lineHandler(s);
     if (--RENDER_scaler_countdown == 0)
-        RENDER_DrawLine = RENDER_DrawLine_countdown_wait;
+        *render_scaleline = RENDER_DrawLine_countdown_wait;
 }
 #endif
 
@@ -226,18 +420,18 @@ static void RENDER_StartLineHandler(const void * s) {
         render.scale.outLine++;
     }
     else {
-        if (!GFX_StartUpdate( render.scale.outWrite, render.scale.outPitch )) {
-            RENDER_DrawLine = RENDER_EmptyLineHandler;
+        if (!RENDER_StartOutput()) {
+            *render_scaleline = RENDER_EmptyLineHandler;
             return;
         }
         render.scale.outWrite += render.scale.outPitch * Scaler_ChangedLines[0];
 #if defined(C_SCALER_FULL_LINE)
         RENDER_scaler_countdown = RENDER_scaler_countdown_init;
-        RENDER_DrawLine = RENDER_DrawLine_countdown;
+        *render_scaleline = RENDER_DrawLine_countdown;
 #else
-        RENDER_DrawLine = render.scale.lineHandler;
+        *render_scaleline = render.scale.lineHandler;
 #endif
-        RENDER_DrawLine( s );
+        (*render_scaleline)( s );
     }
 }
 
@@ -277,8 +471,11 @@ bool RENDER_StartUpdate(void) {
         return false;
     }
     render.frameskip.count=0;
+    RENDER_ThreadSync();
     if (render.scale.inMode == scalerMode8) {
         Check_Palette();
+        /* the render thread is idle here, so this is where the scalers get the palette of the frame */
+        Scaler_Pal = render.pal;
     }
     render.scale.inLine = 0;
     render.scale.outLine = 0;
@@ -291,48 +488,68 @@ bool RENDER_StartUpdate(void) {
     if (GCC_UNLIKELY( render.scale.clearCache) ) {
 //      LOG_MSG("Clearing cache");
         //Will always have to update the screen with this one anyway, so let's update already
-        if (GCC_UNLIKELY(!GFX_StartUpdate( render.scale.outWrite, render.scale.outPitch )))
+        if (GCC_UNLIKELY(!RENDER_StartOutput()))
             return false;
         render.fullFrame = true;
-        RENDER_DrawLine = RENDER_ClearCacheHandler;
+        *render_scaleline = RENDER_ClearCacheHandler;
     } else {
         if (render.pal.changed) {
             /* Assume pal changes always do a full screen update anyway */
-            if (GCC_UNLIKELY(!GFX_StartUpdate( render.scale.outWrite, render.scale.outPitch )))
+            if (GCC_UNLIKELY(!RENDER_StartOutput()))
                 return false;
-            RENDER_DrawLine = render.scale.linePalHandler;
+            *render_scaleline = render.scale.linePalHandler;
             render.fullFrame = true;
         } else {
-            RENDER_DrawLine = RENDER_StartLineHandler;
+            *render_scaleline = RENDER_StartLineHandler;
             if (GCC_UNLIKELY(CaptureState & (CAPTURE_IMAGE|CAPTURE_VIDEO))) 
                 render.fullFrame = true;
             else
                 render.fullFrame = false;
         }
     }
+    if (render_thread.enable)
+        RENDER_DrawLine = RENDER_ThreadLineHandler;
     render.updating = true;
     return true;
 }
 
+extern bool pause_on_vsync;
+
+/* The output shows the last frame completely and needs nothing else before the next one, so the
+ * VGA emulation may leave out a frame it knows to be the same without calling RENDER_StartUpdate. */
+bool RENDER_CanSkipFrame(void) {
+    if (GCC_UNLIKELY(render.updating) || GCC_UNLIKELY(!render.active))
+        return false;
+    if (render.scale.clearCache || render.pal.changed || render.forceUpdate || pause_on_vsync)
+        return false;
+    if (CaptureState & (CAPTURE_IMAGE|CAPTURE_VIDEO))
+        return false;
+    return true;
+}
+
 static void RENDER_Halt( void ) {
+    RENDER_ThreadSync();
     RENDER_DrawLine = RENDER_EmptyLineHandler;
+    *render_scaleline = RENDER_EmptyLineHandler;
     GFX_EndUpdate( 0 );
     render.updating=false;
     render.active=false;
 }
 
 extern Bitu PIC_Ticks;
-extern bool pause_on_vsync;
 void PauseDOSBox(bool pressed);
 
 void RENDER_EndUpdate( bool abort ) {
     if (GCC_UNLIKELY(!render.updating))
         return;
 
-    if (!abort && render.active && RENDER_DrawLine == RENDER_ClearCacheHandler)
+    RENDER_ThreadSync();
+
+    if (!abort && render.active && *render_scaleline == RENDER_ClearCacheHandler)
         render.scale.clearCache = false;
 
     RENDER_DrawLine = RENDER_EmptyLineHandler;
+    *render_scaleline = RENDER_EmptyLineHandler;
     if (GCC_UNLIKELY(CaptureState & (CAPTURE_IMAGE|CAPTURE_VIDEO))) {
         Bitu pitch, flags;
         flags = 0;
@@ -352,7 +569,10 @@ void RENDER_EndUpdate( bool abort ) {
             flags, fps, (Bit8u *)&scalerSourceCache, (Bit8u*)&render.pal.rgb );
     }
     if ( render.scale.outWrite ) {
-        GFX_EndUpdate( abort? NULL : Scaler_ChangedLines );
+        if (render_thread.enable)
+            RENDER_ThreadPresent( abort );
+        else
+            GFX_EndUpdate( abort? NULL : Scaler_ChangedLines );
         render.frameskip.hadSkip[render.frameskip.index] = 0;
     } else {
 #if 0
@@ -408,6 +628,8 @@ void RENDER_Reset( void ) {
 
     if (width == 0 || height == 0)
         return;
+
+    RENDER_ThreadSync();
     
     Bitu gfx_flags, xscale, yscale;
     ScalerSimpleBlock_t     *simpleBlock = &ScaleNormal1x;
@@ -741,8 +963,19 @@ forcenormal:
     render.pal.last = 255;
     render.pal.changed = false;
     memset(render.pal.modified, 0, sizeof(render.pal.modified));
+    if (render_thread.enable) {
+        static const Bitu outBytes[4] = { 1, 2, 2, 4 }; /* scalerMode8, 15, 16, 32 */
+        render_thread.linePitch = (render.scale.cachePitch + 15u) & ~((Bitu)15u);
+        render_thread.lineCount = render.src.height;
+        render_thread.lines.resize(render_thread.linePitch * render_thread.lineCount);
+        render_thread.outPitch = width * outBytes[render.scale.outMode];
+        render_thread.outHeight = height;
+        render_thread.out.assign(render_thread.outPitch * render_thread.outHeight,0);
+    }
     //Finish this frame using a copy only handler
-    RENDER_DrawLine = RENDER_FinishLineHandler;
+    *render_scaleline = RENDER_FinishLineHandler;
+    if (render_thread.enable)
+        RENDER_DrawLine = RENDER_ThreadLineHandler;
     render.scale.outWrite = 0;
     /* Signal the next frame to first reinit the cache */
     render.scale.clearCache = true;
@@ -992,6 +1225,10 @@ void RENDER_UpdateFromScalerSetting(void) {
     if (reset) RENDER_CallBack(GFX_CallBackReset);
 }
 
+static void RENDER_ShutDown(Section * /*sec*/) {
+    RENDER_ThreadShutDown();
+}
+
 void RENDER_Init() {
     Section_prop * section=static_cast<Section_prop *>(control->GetSection("render"));
 
@@ -1073,6 +1310,9 @@ void RENDER_Init() {
 
     render.autofit=section->Get_bool("autofit");
 
+    render_thread.enable=section->Get_bool("render thread");
+    if (render_thread.enable) RENDER_ThreadInit();
+
     //If something changed that needs a ReInit
     // Only ReInit when there is a src.bpp (fixes crashes on startup and directly changing the scaler without a screen specified yet)
     if(running && render.src.bpp && ((render.aspect != aspect) || (render.scale.op != scaleOp) || 
@@ -1080,7 +1320,10 @@ void RENDER_Init() {
                    render.scale.forced))
         RENDER_CallBack( GFX_CallBackReset );
 
-    if(!running) render.updating=true;
+    if(!running) {
+        render.updating=true;
+        AddExitFunction(AddExitFunctionFuncPair(RENDER_ShutDown));
+    }
     running = true;
 
     MAPPER_AddHandler(DecreaseFrameSkip,MK_nothing,0,"decfskip","Dec Fskip");
@@ -28,6 +28,7 @@
 Bit8u Scaler_Aspect[SCALER_MAXHEIGHT];
 Bit16u Scaler_ChangedLines[SCALER_MAXHEIGHT];
 Bitu Scaler_ChangedLineIndex;
+RenderPal_t Scaler_Pal;
 
 static union {
 	Bit32u b32 [4][SCALER_MAXWIDTH*3];
@@ -31,14 +31,14 @@ static inline void conc4d_sub_func(const SRCTYPE* &src, SRCTYPE* &cache, PTYPE*
         if (memcmp(src,cache,block_proc * sizeof(SRCTYPE)) == 0
 # if (SBPP == 9)
             && !(
-			render.pal.modified[src[0]] | 
-			render.pal.modified[src[1]] | 
-			render.pal.modified[src[2]] | 
-			render.pal.modified[src[3]] |
-            render.pal.modified[src[4]] | 
-            render.pal.modified[src[5]] | 
-			render.pal.modified[src[6]] | 
-			render.pal.modified[src[7]])
+			Scaler_Pal.modified[src[0]] | 
+			Scaler_Pal.modified[src[1]] | 
+			Scaler_Pal.modified[src[2]] | 
+			Scaler_Pal.modified[src[3]] |
+            Scaler_Pal.modified[src[4]] | 
+            Scaler_Pal.modified[src[5]] | 
+			Scaler_Pal.modified[src[6]] | 
+			Scaler_Pal.modified[src[7]])
 # endif
             ) {
 			src   += block_proc;
@@ -3024,6 +3024,10 @@ static void GUI_ShutDown(Section * /*sec*/) {
         default:
                 break;
     }
+
+#if C_XBRZ
+    xBRZ_Shutdown();
+#endif
 }
 
 static void SetPriority(PRIORITY_LEVELS level) {
@@ -6114,6 +6118,9 @@ bool DOSBOX_parse_argv() {
             fprintf(stderr,"                                          Make sure to surround the command in quotes to cover spaces.\n");
             fprintf(stderr,"  -break-start                            Break into debugger at startup\n");
             fprintf(stderr,"  -time-limit <n>                         Kill the emulator after 'n' seconds\n");
+            fprintf(stderr,"  -virtual-time                           Run as fast as possible instead of in real time\n");
+            fprintf(stderr,"  -record <file>                          Record the keyboard and mouse input to a file\n");
+            fprintf(stderr,"  -replay <file>                          Replay recorded input in virtual time, ignoring the host input\n");
             fprintf(stderr,"  -fastbioslogo                           Fast BIOS logo (skip 1-second pause)\n");
             fprintf(stderr,"  -log-con                                Log CON output to a log file\n");
 
@@ -6137,6 +6144,17 @@ bool DOSBOX_parse_argv() {
             if (!control->cmdline->NextOptArgv(tmp)) return false;
             control->opt_time_limit = atof(tmp.c_str());
         }
+        else if (optname == "virtual-time") {
+            control->opt_virtual_time = true;
+        }
+        else if (optname == "record") {
+            if (!control->cmdline->NextOptArgv(tmp)) return false;
+            control->opt_record = tmp;
+        }
+        else if (optname == "replay") {
+            if (!control->cmdline->NextOptArgv(tmp)) return false;
+            control->opt_replay = tmp;
+        }
         else if (optname == "break-start") {
             control->opt_break_start = true;
         }
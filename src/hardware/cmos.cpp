@@ -30,6 +30,7 @@
 #include "setup.h"
 #include "cross.h" //fmod on certain platforms
 #include "control.h"
+#include "replay.h"
 bool date_host_forced=false;
 #if defined (WIN32) && !defined (__MINGW32__)
 #include "sys/timeb.h"
@@ -376,7 +377,7 @@ static Bitu cmos_readreg(Bitu port,Bitu iolen) {
     time_t curtime;
     struct tm *loctime;
     /* Get the current time. */
-    curtime = time (NULL);
+    curtime = REPLAY_Time();
 
     /* Convert it to local time representation. */
     loctime = localtime (&curtime);
@@ -25,10 +25,14 @@
 #include "cpu.h"
 #include "../src/cpu/lazyflags.h"
 #include "callback.h"
+#include "programs.h"
 
 //#define ENABLE_PORTLOG
 
 #include <vector>
+#include <map>
+#include <algorithm>
+#include <chrono>
 
 extern bool pcibus_enable;
 
@@ -353,6 +357,25 @@ void IO_InvalidateCachedHandler(Bitu port,Bitu range) {
     }
 }
 
+/* idle hints, looked up on every port read while idle skipping is enabled,
+ * so they are kept in a flat table like the handlers */
+static IO_IdleHint * io_idlehints[IO_MAX];
+
+void IO_RegisterIdleHint(Bitu port,IO_IdleHint * hint,Bitu range) {
+    assert((port+range) <= IO_MAX);
+    while (range--) io_idlehints[port++] = hint;
+}
+
+IO_IdleHint * IO_GetIdleHint(Bitu port) {
+    return io_idlehints[port];
+}
+
+/* hint for ports that only change through PIC events and writes */
+double IO_IdleHintEventsOnly(Bitu port) {
+    (void)port;//UNUSED
+    return IO_IDLE_EVENTS_ONLY;
+}
+
 void IO_ReadHandleObject::Install(Bitu port,IO_ReadHandler * handler,Bitu mask,Bitu range) {
 	if(!installed) {
 		installed=true;
@@ -402,12 +425,27 @@ IO_WriteHandleObject::~IO_WriteHandleObject(){
 /* how much delay to add to I/O in nanoseconds */
 int io_delay_ns[3] = {-1,-1,-1};
 
+/* the same delay in cycles. polled status ports are read millions of times a second,
+ * so the division is only done again when the cycle count changes */
+static Bits io_delay_read_cycles[3];
+static Bits io_delay_write_cycles[3];
+static cpu_cycles_count_t io_delay_cyclemax = -1;
+
 /* nonzero if we're in a callback */
 extern unsigned int last_callback;
 
+static void IO_UpdateDelayCycles(void) {
+	for (unsigned int szidx=0;szidx < 3;szidx++) {
+		io_delay_read_cycles[szidx] = (CPU_CycleMax * io_delay_ns[szidx]) / 1000000;
+		io_delay_write_cycles[szidx] = (CPU_CycleMax * io_delay_ns[szidx] * 3) / (1000000 * 4);
+	}
+	io_delay_cyclemax = CPU_CycleMax;
+}
+
 inline void IO_USEC_read_delay(const unsigned int szidx) {
 	if (io_delay_ns[szidx] > 0 && last_callback == 0/*NOT running within a callback function*/) {
-		Bits delaycyc = (CPU_CycleMax * io_delay_ns[szidx]) / 1000000;
+		if (GCC_UNLIKELY(CPU_CycleMax != io_delay_cyclemax)) IO_UpdateDelayCycles();
+		Bits delaycyc = io_delay_read_cycles[szidx];
 		CPU_Cycles -= delaycyc;
 		CPU_IODelayRemoved += delaycyc;
 	}
@@ -415,12 +453,62 @@ inline void IO_USEC_read_delay(const unsigned int szidx) {
 
 inline void IO_USEC_write_delay(const unsigned int szidx) {
 	if (io_delay_ns[szidx] > 0 && last_callback == 0/*NOT running within a callback function*/) {
-		Bits delaycyc = (CPU_CycleMax * io_delay_ns[szidx] * 3) / (1000000 * 4);
+		if (GCC_UNLIKELY(CPU_CycleMax != io_delay_cyclemax)) IO_UpdateDelayCycles();
+		Bits delaycyc = io_delay_write_cycles[szidx];
 		CPU_Cycles -= delaycyc;
 		CPU_IODelayRemoved += delaycyc;
 	}
 }
 
+/* I/O port statistics, collected while enabled by the IOSTATS command.
+ * Counts the accesses and the host time spent in the handler per port, the
+ * sizes are added together. The handler is the one that served the last access. */
+struct IO_ReadStat {
+	Bit64u count;
+	Bit64u host_ns;
+	IO_ReadHandler * handler;
+};
+
+struct IO_WriteStat {
+	Bit64u count;
+	Bit64u host_ns;
+	IO_WriteHandler * handler;
+};
+
+static bool io_stats_enabled = false;
+static IO_ReadStat * io_stats_read = NULL;		// [IO_MAX], allocated on first use
+static IO_WriteStat * io_stats_write = NULL;
+
+static inline Bit64u IO_StatsClock(void) {
+	return (Bit64u)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static Bitu IO_StatsRead(const unsigned int szidx,Bitu port,Bitu iolen) {
+	IO_ReadStat &s = io_stats_read[port];
+	const Bit64u start = IO_StatsClock();
+	Bitu ret = io_readhandlers[szidx][port](port,iolen);
+	s.host_ns += IO_StatsClock() - start;
+	s.count++;
+	s.handler = io_readhandlers[szidx][port]; /* after the slow path resolved it */
+	return ret;
+}
+
+static void IO_StatsWrite(const unsigned int szidx,Bitu port,Bitu val,Bitu iolen) {
+	IO_WriteStat &s = io_stats_write[port];
+	const Bit64u start = IO_StatsClock();
+	io_writehandlers[szidx][port](port,val,iolen);
+	s.host_ns += IO_StatsClock() - start;
+	s.count++;
+	s.handler = io_writehandlers[szidx][port];
+}
+
+static void IO_StatsReset(void) {
+	if (io_stats_read == NULL) io_stats_read = new IO_ReadStat[IO_MAX];
+	if (io_stats_write == NULL) io_stats_write = new IO_WriteStat[IO_MAX];
+	memset(io_stats_read,0,sizeof(IO_ReadStat)*IO_MAX);
+	memset(io_stats_write,0,sizeof(IO_WriteStat)*IO_MAX);
+}
+
 #ifdef ENABLE_PORTLOG
 static Bit8u crtc_index = 0;
 const char* const len_type[] = {" 8","16","32"};
@@ -494,7 +582,8 @@ void IO_WriteB(Bitu port,Bit8u val) {
 	}
 	else {
 		IO_USEC_write_delay(0);
-		io_writehandlers[0][port](port,val,1);
+		if (GCC_UNLIKELY(io_stats_enabled)) IO_StatsWrite(0,port,val,1);
+		else io_writehandlers[0][port](port,val,1);
 	}
 }
 
@@ -505,7 +594,8 @@ void IO_WriteW(Bitu port,Bit16u val) {
 	}
 	else {
 		IO_USEC_write_delay(1);
-		io_writehandlers[1][port](port,val,2);
+		if (GCC_UNLIKELY(io_stats_enabled)) IO_StatsWrite(1,port,val,2);
+		else io_writehandlers[1][port](port,val,2);
 	}
 }
 
@@ -516,7 +606,8 @@ void IO_WriteD(Bitu port,Bit32u val) {
 	}
 	else {
 		IO_USEC_write_delay(2);
-		io_writehandlers[2][port](port,val,4);
+		if (GCC_UNLIKELY(io_stats_enabled)) IO_StatsWrite(2,port,val,4);
+		else io_writehandlers[2][port](port,val,4);
 	}
 }
 
@@ -527,7 +618,9 @@ Bit8u IO_ReadB(Bitu port) {
 	}
 	else {
 		IO_USEC_read_delay(0);
-		retval = (Bit8u)io_readhandlers[0][port](port,1);
+		if (GCC_UNLIKELY(cpu_idle_skip)) CPU_IdleIORead(port);
+		if (GCC_UNLIKELY(io_stats_enabled)) retval = (Bit8u)IO_StatsRead(0,port,1);
+		else retval = (Bit8u)io_readhandlers[0][port](port,1);
 	}
 	log_io(0, false, port, retval);
 	return retval;
@@ -540,7 +633,9 @@ Bit16u IO_ReadW(Bitu port) {
 	}
 	else {
 		IO_USEC_read_delay(1);
-		retval = (Bit16u)io_readhandlers[1][port](port,2);
+		if (GCC_UNLIKELY(cpu_idle_skip)) CPU_IdleIORead(port);
+		if (GCC_UNLIKELY(io_stats_enabled)) retval = (Bit16u)IO_StatsRead(1,port,2);
+		else retval = (Bit16u)io_readhandlers[1][port](port,2);
 	}
 	log_io(1, false, port, retval);
 	return retval;
@@ -553,7 +648,9 @@ Bit32u IO_ReadD(Bitu port) {
 	}
 	else {
 		IO_USEC_read_delay(2);
-		retval = (Bit32u)io_readhandlers[2][port](port,4);
+		if (GCC_UNLIKELY(cpu_idle_skip)) CPU_IdleIORead(port);
+		if (GCC_UNLIKELY(io_stats_enabled)) retval = (Bit32u)IO_StatsRead(2,port,4);
+		else retval = (Bit32u)io_readhandlers[2][port](port,4);
 	}
 	log_io(2, false, port, retval);
 	return retval;
@@ -586,6 +683,8 @@ void IO_Reset(Section * /*sec*/) { // Reset or power on
 	LOG(LOG_IO,LOG_DEBUG)("I/O 8-bit delay %uns",io_delay_ns[0]);
 	LOG(LOG_IO,LOG_DEBUG)("I/O 16-bit delay %uns",io_delay_ns[1]);
 	LOG(LOG_IO,LOG_DEBUG)("I/O 32-bit delay %uns",io_delay_ns[2]);
+
+	io_delay_cyclemax = -1; /* recompute the delay in cycles */
 }
 
 void IO_Init() {
@@ -827,3 +926,130 @@ void IO_PutCallout(IO_CalloutObject *obj) {
     obj->getcounter--;
 }
 
+
+static const char *IO_StatsHandlerName(bool write,uintptr_t f,char *tmp) {
+	if (write) {
+		if (f == reinterpret_cast<uintptr_t>(IO_WriteSlowPath)) return "slow path";
+		if (f == reinterpret_cast<uintptr_t>(IO_WriteDefault)) return "split";
+		if (f == reinterpret_cast<uintptr_t>(IO_WriteBlocked)) return "unassigned";
+	}
+	else {
+		if (f == reinterpret_cast<uintptr_t>(IO_ReadSlowPath)) return "slow path";
+		if (f == reinterpret_cast<uintptr_t>(IO_ReadDefault)) return "split";
+		if (f == reinterpret_cast<uintptr_t>(IO_ReadBlocked)) return "unassigned";
+	}
+	sprintf(tmp,"%llx",(unsigned long long)f);
+	return tmp;
+}
+
+/*! \brief          IOSTATS.COM built-in command on drive Z:
+ *  
+ *  \description    Utility command to collect and show I/O port access statistics
+ */
+class IOSTATS : public Program {
+public:
+    struct PortEntry {
+        Bit16u port;
+        bool write;
+        Bit64u count;
+        Bit64u host_ns;
+        uintptr_t handler;
+        bool operator<(const PortEntry &o) const { return host_ns > o.host_ns; }
+    };
+    struct HandlerEntry {
+        HandlerEntry() : count(0), host_ns(0), ports(0), lo(0xFFFF), hi(0) { }
+        Bit64u count;
+        Bit64u host_ns;
+        Bitu ports;
+        Bit16u lo,hi;
+    };
+
+    /*! \brief      Program entry point, when the command is run */
+    void Run(void) {
+        if (cmd->FindExist("/?",false)) {
+            WriteOut("Collects how often each I/O port is accessed and the host time spent in its handler.\n\n");
+            WriteOut("IOSTATS [/ON | /OFF | /RESET] [/ALL]\n");
+            WriteOut("  /ON    start collecting\n");
+            WriteOut("  /OFF   stop collecting\n");
+            WriteOut("  /RESET clear the statistics\n");
+            WriteOut("  /ALL   list all ports instead of the 20 most expensive\n");
+            return;
+        }
+        if (cmd->FindExist("/ON",false)) {
+            if (io_stats_read == NULL) IO_StatsReset();
+            io_stats_enabled = true;
+            WriteOut("I/O statistics enabled\n");
+            return;
+        }
+        if (cmd->FindExist("/OFF",false)) {
+            io_stats_enabled = false;
+            WriteOut("I/O statistics disabled\n");
+            return;
+        }
+        if (cmd->FindExist("/RESET",false)) {
+            if (io_stats_read != NULL) IO_StatsReset();
+            WriteOut("I/O statistics cleared\n");
+            return;
+        }
+        if (io_stats_read == NULL) {
+            WriteOut("No I/O statistics collected, start with IOSTATS /ON\n");
+            return;
+        }
+
+        const bool all = cmd->FindExist("/ALL",false);
+        std::vector<PortEntry> ports;
+        std::map<std::pair<bool,uintptr_t>,HandlerEntry> handlers;
+        Bit64u total_count = 0,total_ns = 0;
+
+        for (Bitu p=0;p < 0x10000;p++) {
+            for (unsigned int w=0;w < 2;w++) {
+                PortEntry e;
+                e.port = (Bit16u)p;
+                e.write = w != 0;
+                if (e.write) {
+                    const IO_WriteStat &s = io_stats_write[p];
+                    e.count = s.count; e.host_ns = s.host_ns; e.handler = reinterpret_cast<uintptr_t>(s.handler);
+                }
+                else {
+                    const IO_ReadStat &s = io_stats_read[p];
+                    e.count = s.count; e.host_ns = s.host_ns; e.handler = reinterpret_cast<uintptr_t>(s.handler);
+                }
+                if (e.count == 0) continue;
+                ports.push_back(e);
+                total_count += e.count;
+                total_ns += e.host_ns;
+
+                HandlerEntry &h = handlers[std::make_pair(e.write,e.handler)];
+                h.count += e.count;
+                h.host_ns += e.host_ns;
+                h.ports++;
+                if (h.lo > e.port) h.lo = e.port;
+                if (h.hi < e.port) h.hi = e.port;
+            }
+        }
+        std::sort(ports.begin(),ports.end());
+
+        char tmp[32];
+        WriteOut("I/O statistics %s: %llu accesses, %.3fms in handlers\n\n",io_stats_enabled ? "enabled" : "disabled",
+            (unsigned long long)total_count,(double)total_ns / 1000000.0);
+        WriteOut("Port Dir     Accesses   Time(ms) ns/acc Handler\n");
+        for (size_t i=0;i < ports.size() && (all || i < 20);i++) {
+            const PortEntry &e = ports[i];
+            WriteOut("%04X  %c  %12llu %10.3f %6u %s\n",(unsigned int)e.port,e.write ? 'W' : 'R',
+                (unsigned long long)e.count,(double)e.host_ns / 1000000.0,(unsigned int)(e.host_ns / e.count),
+                IO_StatsHandlerName(e.write,e.handler,tmp));
+        }
+
+        WriteOut("\nHandler            Dir     Accesses   Time(ms) Ports\n");
+        for (std::map<std::pair<bool,uintptr_t>,HandlerEntry>::iterator i=handlers.begin();i!=handlers.end();++i) {
+            const HandlerEntry &h = i->second;
+            WriteOut("%-18s  %c  %12llu %10.3f %u in %04X-%04X\n",IO_StatsHandlerName(i->first.first,i->first.second,tmp),
+                i->first.first ? 'W' : 'R',(unsigned long long)h.count,(double)h.host_ns / 1000000.0,
+                (unsigned int)h.ports,(unsigned int)h.lo,(unsigned int)h.hi);
+        }
+    }
+};
+
+void IOSTATS_ProgramStart(Program * * make) {
+    *make=new IOSTATS;
+}
@@ -30,6 +30,7 @@
 #include "timer.h"
 #include <math.h>
 #include "8255.h"
+#include "replay.h"
 
 #if defined(_MSC_VER)
 # pragma warning(disable:4244) /* const fmath::local::uint64_t to double possible loss of data */
@@ -1635,6 +1636,9 @@ static void KEYBOARD_TickHandler(void) {
 }
 
 void KEYBOARD_AddKey(KBD_KEYS keytype,bool pressed) {
+    if (GCC_UNLIKELY(replay_mode != REPLAY_OFF) && !REPLAY_Key(keytype,pressed))
+        return;
+
     if (IS_PC98_ARCH) {
         KEYBOARD_PC98_AddKey(keytype,pressed);
     }
@@ -2588,6 +2592,9 @@ void KEYBOARD_OnReset(Section *sec) {
         if (machine==MCH_CGA || machine==MCH_HERC) IO_RegisterReadHandler(0x62,read_p62,IO_MB);
         IO_RegisterWriteHandler(0x64,write_p64,IO_MB);
         IO_RegisterReadHandler(0x64,read_p64,IO_MB);
+        /* the data and status only change through the transfer events */
+        IO_RegisterIdleHint(0x60,IO_IdleHintEventsOnly);
+        IO_RegisterIdleHint(0x64,IO_IdleHintEventsOnly);
     }
 
     TIMER_AddTickHandler(&KEYBOARD_TickHandler);
@@ -28,11 +28,18 @@
 #include "programs.h"
 #include "zipfile.h"
 #include "regs.h"
+#include "sharedrom.h"
 #ifndef WIN32
 # include <stdlib.h>
 # include <unistd.h>
 # include <stdio.h>
 #endif
+#if defined(WIN32)
+# include <windows.h>
+#elif (C_HAVE_MPROTECT)
+# include <sys/mman.h>
+#endif
+#include <new>
 
 #include "voodoo.h"
 
@@ -698,45 +705,94 @@ void mem_strcpy(PhysPt dest,PhysPt src) {
     mem_writeb_inline(dest,0);
 }
 
+/* The block functions below work a page at a time. A page the TLB maps to host memory is
+ * copied with memcpy, any other page (MMIO, code pages of the dynamic core) goes through
+ * its page handler a byte at a time. When the TLB has no entry yet, the first byte goes
+ * through the handler, which sets up the entry if the page is plain RAM. */
+static INLINE Bitu MEM_PageChunk(const PhysPt pt,const Bitu size) {
+    const Bitu left = 0x1000u - (pt & 0xfffu);
+    return (size < left) ? size : left;
+}
+
 void mem_memcpy(PhysPt dest,PhysPt src,Bitu size) {
-    while (size--) mem_writeb_inline(dest++,mem_readb_inline(src++));
+    while (size != 0) {
+        Bitu chunk = MEM_PageChunk(src,MEM_PageChunk(dest,size));
+        HostPt tlb_read=get_tlb_read(src);
+        HostPt tlb_write=get_tlb_write(dest);
+        size -= chunk;
+
+        if (!tlb_read || !tlb_write) {
+            mem_writeb_inline(dest++,mem_readb_inline(src++));
+            if (--chunk == 0) continue;
+            tlb_read=get_tlb_read(src);
+            tlb_write=get_tlb_write(dest);
+        }
+
+        if (tlb_read && tlb_write) {
+            const HostPt hs = tlb_read+src,hd = tlb_write+dest;
+            /* copying byte by byte repeats the source when the destination overlaps it from above, keep that */
+            if (hd >= hs+chunk || hs >= hd+chunk) {
+                memcpy(hd,hs,chunk);
+                src += (PhysPt)chunk;
+                dest += (PhysPt)chunk;
+                continue;
+            }
+        }
+
+        // Slow path
+        while (chunk--) mem_writeb_inline(dest++,mem_readb_inline(src++));
+    }
 }
 
 void MEM_BlockRead(PhysPt pt,void * data,Bitu size) {
     Bit8u * write=reinterpret_cast<Bit8u *>(data);
-    while (size--) {
-        *write++=mem_readb_inline(pt++);
+    while (size != 0) {
+        Bitu chunk = MEM_PageChunk(pt,size);
+        HostPt tlb_addr=get_tlb_read(pt);
+        size -= chunk;
+
+        if (!tlb_addr) {
+            *write++ = (Bit8u)get_tlb_readhandler(pt)->readb(pt);
+            pt++;
+            if (--chunk == 0) continue;
+            tlb_addr=get_tlb_read(pt);
+            if (!tlb_addr) {
+                // Slow path
+                while (chunk--) *write++ = mem_readb_inline(pt++);
+                continue;
+            }
+        }
+
+        // Fast path
+        memcpy(write, tlb_addr+pt, chunk);
+        write += chunk;
+        pt += (PhysPt)chunk;
     }
 }
 
 void MEM_BlockWrite(PhysPt pt,void const * const data,Bitu size) {
     Bit8u const* read = reinterpret_cast<Bit8u const*>(data);
-    if (size==0)
-        return;
-
-    if ((pt >> 12) == ((pt+size-1)>>12)) { // Always same TLB entry
+    while (size != 0) {
+        Bitu chunk = MEM_PageChunk(pt,size);
         HostPt tlb_addr=get_tlb_write(pt);
+        size -= chunk;
+
         if (!tlb_addr) {
-            Bit8u val = *read++;
-            get_tlb_writehandler(pt)->writeb(pt,val);
+            get_tlb_writehandler(pt)->writeb(pt,*read++);
+            pt++;
+            if (--chunk == 0) continue;
             tlb_addr=get_tlb_write(pt);
-            pt++; size--;
             if (!tlb_addr) {
                 // Slow path
-                while (size--) {
-                    mem_writeb_inline(pt++,*read++);
-                }
-                return;
+                while (chunk--) mem_writeb_inline(pt++,*read++);
+                continue;
             }
         }
+
         // Fast path
-        memcpy(tlb_addr+pt, read, size);
-    }
-    else {
-        const Bitu current = (((pt>>12)+1)<<12) - pt;
-        Bitu remainder = size - current;
-        MEM_BlockWrite(pt, data, current);
-        MEM_BlockWrite((PhysPt)(pt + current), reinterpret_cast<Bit8u const*>(data) + current, remainder);
+        memcpy(tlb_addr+pt, read, chunk);
+        read += chunk;
+        pt += (PhysPt)chunk;
     }
 }
 
@@ -1716,10 +1772,43 @@ void Init_AddressLimitAndGateMask() {
     LOG(LOG_MISC,LOG_DEBUG)("Memory: address_bits=%u alias_pagemask=%lx",(unsigned int)memory.address_bits,(unsigned long)memory.mem_alias_pagemask);
 }
 
+/* Guest RAM is demand-zero memory reserved from the host. The host provides a page
+ * the first time the guest touches it, so a large memsize costs nothing up front
+ * and the RAM the guest never uses is never allocated. */
+static HostPt MEM_AllocateRAM(size_t size) {
+#if defined(WIN32)
+    return (HostPt)VirtualAlloc(NULL,size,MEM_RESERVE|MEM_COMMIT,PAGE_READWRITE);
+#elif (C_HAVE_MPROTECT)
+    int flags = MAP_PRIVATE|MAP_ANONYMOUS;
+# if defined(MAP_NORESERVE)
+    flags |= MAP_NORESERVE;
+# endif
+    void *p = mmap(NULL,size,PROT_READ|PROT_WRITE,flags,-1,0);
+    return (p != MAP_FAILED) ? (HostPt)p : NULL;
+#else
+    HostPt p = new(std::nothrow) Bit8u[size];
+    /* new[] does not initialize the array, and Visual C debug mode fills it */
+    if (p != NULL) memset((void*)p,0,size);
+    return p;
+#endif
+}
+
+static void MEM_FreeRAM(HostPt p,size_t size) {
+#if defined(WIN32)
+    (void)size;//UNUSED
+    VirtualFree(p,0,MEM_RELEASE);
+#elif (C_HAVE_MPROTECT)
+    munmap(p,size);
+#else
+    (void)size;//UNUSED
+    delete [] p;
+#endif
+}
+
 void ShutDownRAM(Section * sec) {
     (void)sec;//UNUSED
     if (MemBase != NULL) {
-        delete [] MemBase;
+        MEM_FreeRAM(MemBase,memory.pages*4096);
         MemBase = NULL;
     }
 }
@@ -1778,6 +1867,16 @@ void MEM_SaveState(Section *sec) {
     }
 }
 
+/* The adapter ROM and ROM BIOS area (0xC0000-0xFFFFF) is complete by the time the BIOS boots,
+ * and comes out the same in every instance with the same configuration. Callbacks the DOS
+ * kernel installs later only unshare the pages they write to. */
+void MEM_ShareROM(Section *sec) {
+    (void)sec;//UNUSED
+
+    if (MemBase != NULL)
+        SHAREDROM_Share(MemBase+0xC0000,0x40000,"rom");
+}
+
 void Init_RAM() {
     Section_prop * section=static_cast<Section_prop *>(control->GetSection("dosbox"));
     Bitu i;
@@ -1786,6 +1885,7 @@ void Init_RAM() {
     if (!has_Init_RAM) {
         AddVMEventFunction(VM_EVENT_LOAD_STATE,AddVMEventFunctionFuncPair(MEM_LoadState));
         AddVMEventFunction(VM_EVENT_SAVE_STATE,AddVMEventFunctionFuncPair(MEM_SaveState));
+        AddVMEventFunction(VM_EVENT_BIOS_BOOT,AddVMEventFunctionFuncPair(MEM_ShareROM));
 
         AddExitFunction(AddExitFunctionFuncPair(ShutDownRAM));
         has_Init_RAM = true;
@@ -1864,13 +1964,9 @@ void Init_RAM() {
     assert(memory.handler_pages >= memory.reported_pages);
     assert(memory.handler_pages >= 0x100); /* enough for at minimum 1MB of addressable memory */
 
-    /* Allocate the RAM. We alloc as a large unsigned char array. new[] does not initialize the array,
-     * so we then must zero the buffer. */
-    MemBase = new Bit8u[memory.pages*4096];
+    /* Allocate the RAM. It comes zeroed, pages are only committed by the host when first touched. */
+    MemBase = MEM_AllocateRAM(memory.pages*4096);
     if (!MemBase) E_Exit("Can't allocate main memory of %d KB",(int)memsizekb);
-    /* Clear the memory, as new doesn't always give zeroed memory
-     * (Visual C debug mode). We want zeroed memory though. */
-    memset((void*)MemBase,0,memory.reported_pages*4096);
     /* the rest of "ROM" is for unmapped devices so we need to fill it appropriately */
     if (memory.reported_pages < memory.pages)
         memset((char*)MemBase+(memory.reported_pages*4096),0xFF,
@@ -733,6 +733,7 @@ void MixerChannel::AddSamples_s32_nonnative(Bitu len,const Bit32s * data) {
 }
 
 extern bool ticksLocked;
+extern bool ticksVirtual;
 
 #if 0//unused
 static inline bool Mixer_irq_important(void) {
@@ -876,8 +877,10 @@ static void SDLCALL MIXER_CallBack(void * userdata, Uint8 *stream, int len) {
     Bitu need = (Bitu)len/MIXER_SSIZE;
     Bit16s *output = (Bit16s*)stream;
     int remains;
+    /* in virtual time the emulation runs faster than the host plays, output silence */
+    const bool mute = mixer.mute || ticksVirtual;
 
-    if (mixer.mute) {
+    if (mute) {
         if ((CaptureState & (CAPTURE_WAVE|CAPTURE_VIDEO|CAPTURE_MULTITRACK_WAVE)) != 0)
             mixer.work_out = mixer.work_in;
         else
@@ -893,7 +896,7 @@ static void SDLCALL MIXER_CallBack(void * userdata, Uint8 *stream, int len) {
             mixer.prebuffer_wait = false;
     }
 
-    if (!mixer.prebuffer_wait && !mixer.mute) {
+    if (!mixer.prebuffer_wait && !mute) {
         Bit32s *in = &mixer.work[mixer.work_out][0];
         while (need > 0) {
             if (mixer.work_out == mixer.work_in) break;
@@ -25,11 +25,14 @@
 #include "setup.h"
 #include "control.h"
 
+#include <map>
+#include <vector>
+
 #if defined(_MSC_VER)
 # pragma warning(disable:4244) /* const fmath::local::uint64_t to double possible loss of data */
 #endif
 
-#define PIC_QUEUESIZE 512
+#define PIC_QUEUESIZE 512		/* event entries allocated at a time, the pool grows as needed */
 
 unsigned long PIC_irq_delay_ns = 0;
 
@@ -108,6 +111,7 @@ static PIC_Controller pics[2];
 static PIC_Controller& master = pics[0];
 static PIC_Controller& slave  = pics[1];
 Bitu PIC_Ticks = 0;
+Bitu PIC_Activity = 0;
 Bitu PIC_IRQCheck = 0; //Maybe make it a bool and/or ensure 32bit size (x86 dynamic core seems to assume 32 bit variable size)
 Bitu PIC_IRQCheckPending = 0; //Maybe make it a bool and/or ensure 32bit size (x86 dynamic core seems to assume 32 bit variable size)
 bool enable_slave_pic = true; /* if set, emulate slave with cascade to master. if clear, emulate only master, and no cascade (IRQ 2 is open) */
@@ -214,17 +218,41 @@ void PIC_Controller::start_irq(Bit8u val){
     }
 }
 
+struct PICHandlerInfo;
+
 struct PICEntry {
     pic_tickindex_t index;
     Bitu value;
     PIC_EventHandler pic_event;
-    PICEntry * next;
+    PICEntry * next;                /* free list, or the pending events of the same handler */
+    PICEntry * prev;
+    PICHandlerInfo * info;
+    size_t heap_pos;                /* position in pic_queue.heap */
+    Bit64u seq;                     /* events with the same index run in the order they were added */
+};
+
+/* pending events and statistics of one event handler */
+struct PICHandlerInfo {
+    PICEntry * pending;
+    Bitu count;                     /* number of pending events */
+    Bit64u events;                  /* events run */
+    Bit64u removed;                 /* events removed before they were due */
+    pic_tickindex_t latency;        /* sum of the time events were run after they were due */
+    pic_tickindex_t max_latency;
 };
 
+/* The event queue is a binary min-heap ordered by index (and seq), so adding,
+ * running and removing an event is O(log n). The events of every handler are
+ * also kept in a list so removing them by handler doesn't search the queue. */
 static struct {
-    PICEntry entries[PIC_QUEUESIZE];
+    std::vector<PICEntry*> heap;
+    std::vector<PICEntry*> pools;
+    std::map<PIC_EventHandler,PICHandlerInfo> handlers;
     PICEntry * free_entry;
-    PICEntry * next_entry;
+    PICHandlerInfo * last_info;     /* handlers tend to add several events in a row */
+    Bit64u seq;
+    size_t allocated;
+    size_t max_pending;
 } pic_queue;
 
 static void write_command(Bitu port,Bitu val,Bitu iolen) {
@@ -370,6 +398,8 @@ static void pc_xt_nmi_write(Bitu port,Bitu val,Bitu iolen) {
 /* FIXME: This should be called something else that's true to the ISA bus, like PIC_PulseIRQ, not Activate IRQ.
  *        ISA interrupts are edge triggered, not level triggered. */
 void PIC_ActivateIRQ(Bitu irq) {
+    PIC_Activity++;
+
     /* Remember what was once IRQ 2 on PC/XT is IRQ 9 on PC/AT */
     if (IS_PC98_ARCH) {
         if (irq == 7) {
@@ -589,31 +619,108 @@ void DEBUG_PICMask(int irq,bool mask) {
         PIC_SetIRQMask((unsigned int)irq,mask);
 }
 
-static void AddEntry(PICEntry * entry) {
-    PICEntry * find_entry=pic_queue.next_entry;
-    if (GCC_UNLIKELY(find_entry ==0)) {
-        entry->next=0;
-        pic_queue.next_entry=entry;
-    } else if (find_entry->index>entry->index) {
-        pic_queue.next_entry=entry;
-        entry->next=find_entry;
-    } else while (find_entry) {
-        if (find_entry->next) {
-            /* See if the next index comes later than this one */
-            if (find_entry->next->index > entry->index) {
-                entry->next=find_entry->next;
-                find_entry->next=entry;
-                break;
-            } else {
-                find_entry=find_entry->next;
-            }
-        } else {
-            entry->next=find_entry->next;
-            find_entry->next=entry;
-            break;
+static INLINE bool PIC_EntryBefore(const PICEntry * a,const PICEntry * b) {
+    if (a->index != b->index) return a->index < b->index;
+    return a->seq < b->seq;
+}
+
+static void PIC_HeapSiftUp(size_t pos) {
+    PICEntry * entry=pic_queue.heap[pos];
+    while (pos > 0) {
+        size_t parent=(pos-1)/2;
+        if (!PIC_EntryBefore(entry,pic_queue.heap[parent])) break;
+        pic_queue.heap[pos]=pic_queue.heap[parent];
+        pic_queue.heap[pos]->heap_pos=pos;
+        pos=parent;
+    }
+    pic_queue.heap[pos]=entry;
+    entry->heap_pos=pos;
+}
+
+static void PIC_HeapSiftDown(size_t pos) {
+    const size_t size=pic_queue.heap.size();
+    PICEntry * entry=pic_queue.heap[pos];
+    for (;;) {
+        size_t child=pos*2+1;
+        if (child >= size) break;
+        if (child+1 < size && PIC_EntryBefore(pic_queue.heap[child+1],pic_queue.heap[child])) child++;
+        if (!PIC_EntryBefore(pic_queue.heap[child],entry)) break;
+        pic_queue.heap[pos]=pic_queue.heap[child];
+        pic_queue.heap[pos]->heap_pos=pos;
+        pos=child;
+    }
+    pic_queue.heap[pos]=entry;
+    entry->heap_pos=pos;
+}
+
+/* take the entry out of the queue and the list of its handler */
+static void PIC_UnlinkEntry(PICEntry * entry) {
+    size_t pos=entry->heap_pos;
+    PICEntry * last=pic_queue.heap.back();
+    pic_queue.heap.pop_back();
+    if (last != entry) {
+        pic_queue.heap[pos]=last;
+        last->heap_pos=pos;
+        if (pos > 0 && PIC_EntryBefore(last,pic_queue.heap[(pos-1)/2])) PIC_HeapSiftUp(pos);
+        else PIC_HeapSiftDown(pos);
+    }
+
+    PICHandlerInfo * info=entry->info;
+    if (entry->prev) entry->prev->next=entry->next;
+    else info->pending=entry->next;
+    if (entry->next) entry->next->prev=entry->prev;
+    info->count--;
+}
+
+static void PIC_FreeEntry(PICEntry * entry) {
+    entry->next=pic_queue.free_entry;
+    entry->prev=0;
+    pic_queue.free_entry=entry;
+}
+
+static PICEntry * PIC_AllocEntry(void) {
+    if (GCC_UNLIKELY(!pic_queue.free_entry)) {
+        PICEntry * pool=new PICEntry[PIC_QUEUESIZE];
+        for (Bitu i=0;i<PIC_QUEUESIZE;i++) {
+            pool[i].pic_event=0;
+            PIC_FreeEntry(&pool[i]);
         }
+        pic_queue.pools.push_back(pool);
+        pic_queue.allocated+=PIC_QUEUESIZE;
     }
-    Bits cycles=PIC_MakeCycles(pic_queue.next_entry->index-PIC_TickIndex());
+    PICEntry * entry=pic_queue.free_entry;
+    pic_queue.free_entry=entry->next;
+    return entry;
+}
+
+static PICHandlerInfo * PIC_GetHandlerInfo(PIC_EventHandler handler) {
+    PICHandlerInfo * info=pic_queue.last_info;
+    if (info != NULL && info->pending != NULL && info->pending->pic_event == handler) return info;
+    std::map<PIC_EventHandler,PICHandlerInfo>::iterator it=pic_queue.handlers.find(handler);
+    if (it == pic_queue.handlers.end()) {
+        PICHandlerInfo newinfo;
+        memset(&newinfo,0,sizeof(newinfo));
+        it=pic_queue.handlers.insert(std::make_pair(handler,newinfo)).first;
+    }
+    pic_queue.last_info=&it->second;
+    return &it->second;
+}
+
+static void AddEntry(PICEntry * entry) {
+    PICHandlerInfo * info=PIC_GetHandlerInfo(entry->pic_event);
+    entry->info=info;
+    entry->prev=0;
+    entry->next=info->pending;
+    if (info->pending) info->pending->prev=entry;
+    info->pending=entry;
+    info->count++;
+
+    entry->seq=pic_queue.seq++;
+    pic_queue.heap.push_back(entry);
+    PIC_HeapSiftUp(pic_queue.heap.size()-1);
+    if (pic_queue.heap.size() > pic_queue.max_pending) pic_queue.max_pending=pic_queue.heap.size();
+
+    Bits cycles=PIC_MakeCycles(pic_queue.heap[0]->index-PIC_TickIndex());
     if (cycles<CPU_Cycles) {
         CPU_CycleLeft+=CPU_Cycles;
         CPU_Cycles=0;
@@ -631,68 +738,39 @@ pic_tickindex_t PIC_GetCurrentEventTime(void) {
 }
 
 void PIC_AddEvent(PIC_EventHandler handler,pic_tickindex_t delay,Bitu val) {
-    if (GCC_UNLIKELY(!pic_queue.free_entry)) {
-        LOG(LOG_PIC,LOG_ERROR)("Event queue full");
-        return;
-    }
-    PICEntry * entry=pic_queue.free_entry;
+    PICEntry * entry=PIC_AllocEntry();
     if(InEventService) entry->index = delay + srv_lag;
     else entry->index = delay + PIC_TickIndex();
 
     entry->pic_event=handler;
     entry->value=val;
-    pic_queue.free_entry=pic_queue.free_entry->next;
     AddEntry(entry);
 }
 
 void PIC_RemoveSpecificEvents(PIC_EventHandler handler, Bitu val) {
-    PICEntry * entry=pic_queue.next_entry;
-    PICEntry * prev_entry;
-    prev_entry = 0;
+    std::map<PIC_EventHandler,PICHandlerInfo>::iterator it=pic_queue.handlers.find(handler);
+    if (it == pic_queue.handlers.end()) return;
+    PICEntry * entry=it->second.pending;
     while (entry) {
-        if (GCC_UNLIKELY((entry->pic_event == handler)) && (entry->value == val)) {
-            if (prev_entry) {
-                prev_entry->next=entry->next;
-                entry->next=pic_queue.free_entry;
-                pic_queue.free_entry=entry;
-                entry=prev_entry->next;
-                continue;
-            } else {
-                pic_queue.next_entry=entry->next;
-                entry->next=pic_queue.free_entry;
-                pic_queue.free_entry=entry;
-                entry=pic_queue.next_entry;
-                continue;
-            }
+        PICEntry * next_entry=entry->next;
+        if (entry->value == val) {
+            PIC_UnlinkEntry(entry);
+            PIC_FreeEntry(entry);
+            it->second.removed++;
         }
-        prev_entry=entry;
-        entry=entry->next;
-    }   
+        entry=next_entry;
+    }
 }
 
 void PIC_RemoveEvents(PIC_EventHandler handler) {
-    PICEntry * entry=pic_queue.next_entry;
-    PICEntry * prev_entry;
-    prev_entry=0;
-    while (entry) {
-        if (GCC_UNLIKELY(entry->pic_event==handler)) {
-            if (prev_entry) {
-                prev_entry->next=entry->next;
-                entry->next=pic_queue.free_entry;
-                pic_queue.free_entry=entry;
-                entry=prev_entry->next;
-                continue;
-            } else {
-                pic_queue.next_entry=entry->next;
-                entry->next=pic_queue.free_entry;
-                pic_queue.free_entry=entry;
-                entry=pic_queue.next_entry;
-                continue;
-            }
-        }
-        prev_entry=entry;
-        entry=entry->next;
-    }   
+    std::map<PIC_EventHandler,PICHandlerInfo>::iterator it=pic_queue.handlers.find(handler);
+    if (it == pic_queue.handlers.end()) return;
+    while (it->second.pending) {
+        PICEntry * entry=it->second.pending;
+        PIC_UnlinkEntry(entry);
+        PIC_FreeEntry(entry);
+        it->second.removed++;
+    }
 }
 
 extern ClockDomain clockdom_DOSBox_cycles;
@@ -731,22 +809,28 @@ bool PIC_RunQueue(void) {
         /* Check the queue for an entry */
         Bits index_nd=PIC_TickIndexND();
         InEventService = true;
-        while (pic_queue.next_entry && (pic_queue.next_entry->index*CPU_CycleMax<=index_nd)) {
-            PICEntry * entry=pic_queue.next_entry;
-            pic_queue.next_entry=entry->next;
+        while (!pic_queue.heap.empty() && (pic_queue.heap[0]->index*CPU_CycleMax<=index_nd)) {
+            PICEntry * entry=pic_queue.heap[0];
+            PIC_UnlinkEntry(entry);
+
+            PICHandlerInfo * info=entry->info;
+            pic_tickindex_t latency=((pic_tickindex_t)index_nd/CPU_CycleMax)-entry->index;
+            info->events++;
+            info->latency+=latency;
+            if (info->max_latency < latency) info->max_latency=latency;
 
             srv_lag = entry->index;
+            PIC_Activity++;
             (entry->pic_event)(entry->value); // call the event handler
 
             /* Put the entry in the free list */
-            entry->next=pic_queue.free_entry;
-            pic_queue.free_entry=entry;
+            PIC_FreeEntry(entry);
         }
         InEventService = false;
 
         /* Check when to set the new cycle end */
-        if (pic_queue.next_entry) {
-            Bits cycles=(Bits)(pic_queue.next_entry->index*CPU_CycleMax-index_nd);
+        if (!pic_queue.heap.empty()) {
+            Bits cycles=(Bits)(pic_queue.heap[0]->index*CPU_CycleMax-index_nd);
             if (GCC_UNLIKELY(!cycles)) cycles=1;
             if (cycles<CPU_CycleLeft) {
                 CPU_Cycles=cycles;
@@ -835,12 +919,10 @@ void TIMER_AddTick(void) {
     if (time_limit_ms != 0 && PIC_Ticks >= time_limit_ms)
         throw int(1);
 
-    /* Go through the list of scheduled events and lower their index with 1000 */
-    PICEntry * entry=pic_queue.next_entry;
-    while (entry) {
-        entry->index -= 1.0;
-        entry=entry->next;
-    }
+    /* Go through the list of scheduled events and lower their index with 1000,
+     * all of them move by the same amount so the order of the queue stays intact */
+    for (size_t i=0;i<pic_queue.heap.size();i++)
+        pic_queue.heap[i]->index -= 1.0;
 
     /* Call our list of ticker handlers */
     TickerBlock * ticker=firstticker;
@@ -988,6 +1070,8 @@ void PIC_Reset(Section *sec) {
     ReadHandler[1].Install(IS_PC98_ARCH ? 0x02 : 0x21,read_data,IO_MB);
     WriteHandler[0].Install(IS_PC98_ARCH ? 0x00 : 0x20,write_command,IO_MB);
     WriteHandler[1].Install(IS_PC98_ARCH ? 0x02 : 0x21,write_data,IO_MB);
+    IO_RegisterIdleHint(IS_PC98_ARCH ? 0x00 : 0x20,IO_IdleHintEventsOnly);
+    IO_RegisterIdleHint(IS_PC98_ARCH ? 0x02 : 0x21,IO_IdleHintEventsOnly);
 
     /* the secondary slave PIC takes priority over PC/XT NMI mask emulation */
     if (enable_slave_pic) {
@@ -995,6 +1079,8 @@ void PIC_Reset(Section *sec) {
         ReadHandler[3].Install(IS_PC98_ARCH ? 0x0A : 0xa1,read_data,IO_MB);
         WriteHandler[2].Install(IS_PC98_ARCH ? 0x08 : 0xa0,write_command,IO_MB);
         WriteHandler[3].Install(IS_PC98_ARCH ? 0x0A : 0xa1,write_data,IO_MB);
+        IO_RegisterIdleHint(IS_PC98_ARCH ? 0x08 : 0xa0,IO_IdleHintEventsOnly);
+        IO_RegisterIdleHint(IS_PC98_ARCH ? 0x0A : 0xa1,IO_IdleHintEventsOnly);
     }
     else if (!IS_PC98_ARCH && enable_pc_xt_nmi_mask) {
         PCXT_NMI_WriteHandler.Install(0xa0,pc_xt_nmi_write,IO_MB);
@@ -1003,23 +1089,26 @@ void PIC_Reset(Section *sec) {
 
 void PIC_Destroy(Section* sec) {
     (void)sec;//UNUSED
+
+    /* the pending events and the handler lists point into the pools */
+    for (size_t i=0;i<pic_queue.pools.size();i++)
+        delete[] pic_queue.pools[i];
+    pic_queue.pools.clear();
+    pic_queue.heap.clear();
+    pic_queue.handlers.clear();
+    pic_queue.free_entry=0;
+    pic_queue.last_info=0;
+    pic_queue.allocated=0;
+    pic_queue.max_pending=0;
 }
 
 void Init_PIC() {
-    Bitu i;
-
     LOG(LOG_MISC,LOG_DEBUG)("Init_PIC()");
 
-    /* Initialize the pic queue */
-    for (i=0;i<PIC_QUEUESIZE-1;i++) {
-        pic_queue.entries[i].next=&pic_queue.entries[i+1];
-
-        // savestate compatibility
-        pic_queue.entries[i].pic_event = 0;
-    }
-    pic_queue.entries[PIC_QUEUESIZE-1].next=0;
-    pic_queue.free_entry=&pic_queue.entries[0];
-    pic_queue.next_entry=0;
+    /* Initialize the pic queue, the first pool is allocated with the first event */
+    pic_queue.heap.reserve(PIC_QUEUESIZE);
+    pic_queue.free_entry=0;
+    pic_queue.last_info=0;
 
     AddExitFunction(AddExitFunctionFuncPair(PIC_Destroy));
     AddVMEventFunction(VM_EVENT_RESET,AddVMEventFunctionFuncPair(PIC_Reset));
@@ -1061,6 +1150,37 @@ void DEBUG_LogPIC(void) {
     DEBUG_LogPIC_C(master);
     if (enable_slave_pic) DEBUG_LogPIC_C(slave);
 }
+
+void DEBUG_LogPICEvents(bool reset) {
+    std::map<PIC_EventHandler,PICHandlerInfo>::iterator it;
+
+    if (reset) {
+        for (it=pic_queue.handlers.begin();it!=pic_queue.handlers.end();++it) {
+            it->second.events=0;
+            it->second.removed=0;
+            it->second.latency=0;
+            it->second.max_latency=0;
+        }
+        pic_queue.max_pending=pic_queue.heap.size();
+        LOG_MSG("PIC event counters reset");
+        return;
+    }
+
+    LOG_MSG("PIC event queue: %u pending (at most %u), %u entries allocated",
+        (unsigned int)pic_queue.heap.size(),(unsigned int)pic_queue.max_pending,(unsigned int)pic_queue.allocated);
+    LOG_MSG("Handler            Pending       Run   Removed  Avg late(ms)  Max late(ms)");
+    for (it=pic_queue.handlers.begin();it!=pic_queue.handlers.end();++it) {
+        const PICHandlerInfo &info = it->second;
+        if (info.count == 0 && info.events == 0 && info.removed == 0) continue;
+        LOG_MSG("%-16p %9u %9llu %9llu %13.4f %13.4f",
+            (void*)it->first,
+            (unsigned int)info.count,
+            (unsigned long long)info.events,
+            (unsigned long long)info.removed,
+            info.events ? (double)(info.latency/info.events) : 0.0,
+            (double)info.max_latency);
+    }
+}
 #endif
 
 
@@ -231,6 +231,8 @@ bool enable_page_flip_debugging_marker = false;
 bool enable_vretrace_poll_debugging_marker = false;
 bool vga_enable_hretrace_effects = false;
 bool vga_enable_hpel_effects = false;
+bool vga_skip_unchanged_lines = true;
+bool vga_skip_unchanged_frames = true;
 bool vga_enable_3C6_ramdac = false;
 bool vga_sierra_lock_565 = false;
 bool enable_vga_resize_delay = false;
@@ -810,6 +812,8 @@ void VGA_Reset(Section*) {
     ignore_vblank_wraparound = section->Get_bool("ignore vblank wraparound");
     int10_vesa_map_as_128kb = section->Get_bool("vesa map non-lfb modes to 128kb region");
     vga_enable_hretrace_effects = section->Get_bool("allow hretrace effects");
+    vga_skip_unchanged_lines = section->Get_bool("skip unchanged scanlines");
+    vga_skip_unchanged_frames = section->Get_bool("skip unchanged frames");
     enable_page_flip_debugging_marker = section->Get_bool("page flip debug line");
     vga_palette_update_on_full_load = section->Get_bool("vga palette update on full load");
     non_cga_ignore_oddeven = section->Get_bool("ignore odd-even mode in non-cga modes");
@@ -1496,6 +1500,7 @@ bool debugpollvga_pf_menu_callback(DOSBoxMenu * const xmenu, DOSBoxMenu::item *
 
     enable_page_flip_debugging_marker = !enable_page_flip_debugging_marker;
     mainMenu.get_item("debug_pageflip").check(enable_page_flip_debugging_marker).refresh_item(mainMenu);
+    vga.dirty.state++; /* redraw without the marker */
 
     return true;
 }
@@ -1506,6 +1511,7 @@ bool debugpollvga_rtp_menu_callback(DOSBoxMenu * const xmenu, DOSBoxMenu::item *
 
     enable_vretrace_poll_debugging_marker = !enable_vretrace_poll_debugging_marker;
     mainMenu.get_item("debug_retracepoll").check(enable_vretrace_poll_debugging_marker).refresh_item(mainMenu);
+    vga.dirty.state++; /* redraw without the marker */
 
     return true;
 }
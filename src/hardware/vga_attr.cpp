@@ -75,6 +75,7 @@ void VGA_ATTR_SetPalette(Bit8u index, Bit8u val) {
 	// the attribute table stores only 6 bits
 	val &= 63; 
 	vga.attr.palette[index] = val;
+	vga.dirty.state++;
 
     if (IS_VGA_ARCH) {
         // apply the plane mask
@@ -131,6 +132,7 @@ void write_p3c0(Bitu /*port*/,Bitu val,Bitu iolen) {
 	if (!vga.internal.attrindex) {
 		attr(index)=val & 0x1F;
 		vga.internal.attrindex=true;
+		if ((attr(disabled) & 1) != ((val & 0x20) ? 0 : 1)) vga.dirty.state++;
 		if (val & 0x20) attr(disabled) &= ~1;
 		else attr(disabled) |= 1;
 		/* 
@@ -152,6 +154,7 @@ void write_p3c0(Bitu /*port*/,Bitu val,Bitu iolen) {
 		return;
 	} else {
 		vga.internal.attrindex=false;
+		vga.dirty.state++;
 		switch (attr(index)) {
 			/* Palette */
 		case 0x00:		case 0x01:		case 0x02:		case 0x03:
@@ -71,6 +71,8 @@ void vga_write_p3d5(Bitu port,Bitu val,Bitu iolen) {
     (void)port;//UNUSED
 //	if((crtc(index)!=0xe)&&(crtc(index)!=0xf)) 
 //		LOG_MSG("CRTC w #%2x val %2x",crtc(index),val);
+	/* the start address and the cursor location are compared per scanline by the drawing code */
+	if (crtc(index) < 0x0C || crtc(index) > 0x0F) vga.dirty.state++;
 	switch(crtc(index)) {
 	case 0x00:	/* Horizontal Total Register */
 		if (crtc(read_only)) break;
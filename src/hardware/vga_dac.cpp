@@ -59,6 +59,8 @@ static void VGA_DAC_SendColor( Bitu index, Bitu src ) {
     const Bit8u green = vga.dac.rgb[src].green << dacshift;
     const Bit8u blue = vga.dac.rgb[src].blue << dacshift;
 
+    vga.dirty.state++;
+
     /* FIXME: CGA composite mode calls RENDER_SetPal itself, which conflicts with this code */
     if (vga.mode == M_CGA16)
         return;
@@ -20,6 +20,8 @@
 #include <string.h>
 #include <math.h>
 #include <stdio.h>
+#include <chrono>
+#include <vector>
 #include "dosbox.h"
 #if defined (WIN32)
 #include <d3d9.h>
@@ -90,6 +92,10 @@ extern bool vga_3da_polled;
 extern bool vga_page_flip_occurred;
 extern bool vga_enable_hpel_effects;
 extern bool vga_enable_hretrace_effects;
+extern bool vga_skip_unchanged_lines;
+extern bool vga_skip_unchanged_frames;
+extern bool enable_page_flip_debugging_marker;
+extern bool enable_vretrace_poll_debugging_marker;
 extern unsigned int vga_display_start_hretrace;
 extern float hretrace_fx_avg_weight;
 extern bool ignore_vblank_wraparound;
@@ -466,10 +472,301 @@ static Bit8u * VGA_Draw_CGA16_Line(Bitu vidstart, Bitu line) {
 #undef CGA16_READER
 }
 
+/* Line converters that have a SIMD version. Each takes the source of a whole line as one
+ * contiguous block of n units (bytes, or 32-bit latches of the four planes), the line
+ * handlers use them when the line does not wrap around the end of video memory and keep
+ * the masked per pixel loop for when it does.
+ *
+ * The SIMD versions use PSHUFB of SSSE3, which looks up 16 pixels in a 16 entry table at
+ * once, what the 16 colour modes need. SSSE3 is not part of the baseline of the x86 builds,
+ * CheckSSESupport() tells whether the host has it. Lookups in the 256 entry DAC table of
+ * the 8bpp modes have no vector form short of a gather, those stay scalar. */
+#if defined(__SSE__) && (defined(__GNUC__) || defined(__clang__)) && !defined(C_EMSCRIPTEN)
+# include <tmmintrin.h>
+# define VGA_DRAW_SSSE3 1
+# define VGA_DRAW_SSSE3_FUNC __attribute__((target("ssse3")))
+#endif
+
+typedef void (*VGA_Draw_Converter)(Bit8u *dst,const Bit8u *src,Bitu n);
+
+extern Bit32u Expand16Table[4][16];
+
+template <const unsigned int card,typename templine_type_t> static inline void EGA_Planar_Common_Block(templine_type_t * const temps,const Bit32u t1,const Bit32u t2);
+
+/* the source of a line, if it does not wrap around the mask. A mask with a hole, as the CGA
+ * compatible addressing of the EGA modes makes by clearing bit 15 or 16, always wraps. */
+static inline const Bit8u *VGA_Draw_Contiguous(const Bit8u *base,Bitu start,const Bitu mask,const Bitu bytes) {
+    if (bytes == 0u || (mask & (mask + 1u)) != 0u || bytes > mask + 1u) return NULL;
+    start &= mask;
+    if (start > mask + 1u - bytes) return NULL;
+    return base + start;
+}
+
+/* 16 colour planar, a latch is 8 pixels */
+static void VGA_Planar16_Xlat32_C(Bit8u *dst,const Bit8u *src,Bitu n) {
+    Bit32u *temps = (Bit32u*)dst;
+    while (n-- > 0u) {
+        const Bit32u t = *((const Bit32u*)src);
+        EGA_Planar_Common_Block<MCH_VGA,Bit32u>(temps,(t >> 4) & 0x0f0f0f0f,t & 0x0f0f0f0f);
+        src += 4;
+        temps += 8;
+    }
+}
+
+static void EGA_Planar16_Xlat8_C(Bit8u *dst,const Bit8u *src,Bitu n) {
+    while (n-- > 0u) {
+        const Bit32u t = *((const Bit32u*)src);
+        EGA_Planar_Common_Block<MCH_EGA,Bit8u>(dst,(t >> 4) & 0x0f0f0f0f,t & 0x0f0f0f0f);
+        src += 4;
+        dst += 8;
+    }
+}
+
+/* packed 4bpp, a byte is 2 pixels */
+static void VGA_Packed4_Xlat32_C(Bit8u *dst,const Bit8u *src,Bitu n) {
+    Bit32u *temps = (Bit32u*)dst;
+    while (n-- > 0u) {
+        const Bit8u t = *src++;
+        *temps++ = vga.dac.xlat32[(t>>4)&0xF];
+        *temps++ = vga.dac.xlat32[(t>>0)&0xF];
+    }
+}
+
+static void VGA_Packed4_Xlat8_C(Bit8u *dst,const Bit8u *src,Bitu n) {
+    while (n-- > 0u) {
+        const Bit8u t = *src++;
+        *dst++ = vga.attr.palette[t >> 4];
+        *dst++ = vga.attr.palette[t & 0x0f];
+    }
+}
+
+static void VGA_Packed4_Xlat8_Double_C(Bit8u *dst,const Bit8u *src,Bitu n) {
+    while (n-- > 0u) {
+        const Bit8u t = *src++;
+        dst[0] = dst[1] = vga.attr.palette[t >> 4];
+        dst[2] = dst[3] = vga.attr.palette[t & 0x0f];
+        dst += 4;
+    }
+}
+
+/* 8bpp through the DAC, a byte is a pixel */
+static void VGA_Linear8_Xlat32_C(Bit8u *dst,const Bit8u *src,Bitu n) {
+    const Bit32u * const xlat = vga.dac.xlat32;
+    Bit32u *temps = (Bit32u*)dst;
+    while (n >= 4u) {
+        temps[0] = xlat[src[0]];
+        temps[1] = xlat[src[1]];
+        temps[2] = xlat[src[2]];
+        temps[3] = xlat[src[3]];
+        temps += 4;
+        src += 4;
+        n -= 4u;
+    }
+    while (n-- > 0u) *temps++ = xlat[*src++];
+}
+
+#if defined(VGA_DRAW_SSSE3)
+/* 16 pixel indexes from 2 latches, bit 7 of a plane byte is the leftmost pixel */
+VGA_DRAW_SSSE3_FUNC static inline __m128i VGA_SSSE3_Planar16_Plane(const __m128i lat,const __m128i bits,const int p) {
+    /* the byte of plane p of each latch, once per pixel, then whether the bit of the pixel is set */
+    const __m128i sel = _mm_setr_epi8(p,p,p,p,p,p,p,p,4+p,4+p,4+p,4+p,4+p,4+p,4+p,4+p);
+    const __m128i b = _mm_and_si128(_mm_shuffle_epi8(lat,sel),bits);
+    return _mm_and_si128(_mm_cmpeq_epi8(b,bits),_mm_set1_epi8((char)(1 << p)));
+}
+
+VGA_DRAW_SSSE3_FUNC static inline __m128i VGA_SSSE3_Planar16_Index(const Bit8u *src) {
+    const __m128i bits = _mm_setr_epi8((char)0x80,64,32,16,8,4,2,1,(char)0x80,64,32,16,8,4,2,1);
+    const __m128i lat = _mm_loadl_epi64((const __m128i*)src);
+
+    return _mm_or_si128(
+        _mm_or_si128(VGA_SSSE3_Planar16_Plane(lat,bits,0),VGA_SSSE3_Planar16_Plane(lat,bits,1)),
+        _mm_or_si128(VGA_SSSE3_Planar16_Plane(lat,bits,2),VGA_SSSE3_Planar16_Plane(lat,bits,3)));
+}
+
+/* vga.dac.xlat32[0-15] as 4 tables of 16 bytes, one per byte of the pixel */
+VGA_DRAW_SSSE3_FUNC static inline void VGA_SSSE3_Xlat32_Tables(__m128i tab[4]) {
+    const __m128i tr = _mm_setr_epi8(0,4,8,12,1,5,9,13,2,6,10,14,3,7,11,15);
+    const __m128i e0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(vga.dac.xlat32+ 0)),tr);
+    const __m128i e1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(vga.dac.xlat32+ 4)),tr);
+    const __m128i e2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(vga.dac.xlat32+ 8)),tr);
+    const __m128i e3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(vga.dac.xlat32+12)),tr);
+    const __m128i t0 = _mm_unpacklo_epi32(e0,e1);
+    const __m128i t1 = _mm_unpacklo_epi32(e2,e3);
+    const __m128i t2 = _mm_unpackhi_epi32(e0,e1);
+    const __m128i t3 = _mm_unpackhi_epi32(e2,e3);
+
+    tab[0] = _mm_unpacklo_epi64(t0,t1);
+    tab[1] = _mm_unpackhi_epi64(t0,t1);
+    tab[2] = _mm_unpacklo_epi64(t2,t3);
+    tab[3] = _mm_unpackhi_epi64(t2,t3);
+}
+
+/* 16 pixels of 32bpp from 16 indexes */
+VGA_DRAW_SSSE3_FUNC static inline void VGA_SSSE3_Xlat32_Store(Bit8u *dst,const __m128i idx,const __m128i tab[4]) {
+    const __m128i b0 = _mm_shuffle_epi8(tab[0],idx);
+    const __m128i b1 = _mm_shuffle_epi8(tab[1],idx);
+    const __m128i b2 = _mm_shuffle_epi8(tab[2],idx);
+    const __m128i b3 = _mm_shuffle_epi8(tab[3],idx);
+    const __m128i lo01 = _mm_unpacklo_epi8(b0,b1);
+    const __m128i hi01 = _mm_unpackhi_epi8(b0,b1);
+    const __m128i lo23 = _mm_unpacklo_epi8(b2,b3);
+    const __m128i hi23 = _mm_unpackhi_epi8(b2,b3);
+
+    _mm_storeu_si128((__m128i*)(dst+ 0),_mm_unpacklo_epi16(lo01,lo23));
+    _mm_storeu_si128((__m128i*)(dst+16),_mm_unpackhi_epi16(lo01,lo23));
+    _mm_storeu_si128((__m128i*)(dst+32),_mm_unpacklo_epi16(hi01,hi23));
+    _mm_storeu_si128((__m128i*)(dst+48),_mm_unpackhi_epi16(hi01,hi23));
+}
+
+VGA_DRAW_SSSE3_FUNC static void VGA_Planar16_Xlat32_SSSE3(Bit8u *dst,const Bit8u *src,Bitu n) {
+    __m128i tab[4];
+    VGA_SSSE3_Xlat32_Tables(tab);
+    while (n >= 2u) {
+        VGA_SSSE3_Xlat32_Store(dst,VGA_SSSE3_Planar16_Index(src),tab);
+        dst += 16*4;
+        src += 8;
+        n -= 2u;
+    }
+    VGA_Planar16_Xlat32_C(dst,src,n);
+}
+
+VGA_DRAW_SSSE3_FUNC static void EGA_Planar16_Xlat8_SSSE3(Bit8u *dst,const Bit8u *src,Bitu n) {
+    const __m128i pal = _mm_loadu_si128((const __m128i*)vga.attr.palette);
+    const __m128i cpe = _mm_set1_epi8((char)vga.attr.color_plane_enable);
+    while (n >= 2u) {
+        const __m128i idx = _mm_and_si128(VGA_SSSE3_Planar16_Index(src),cpe);
+        _mm_storeu_si128((__m128i*)dst,_mm_shuffle_epi8(pal,idx));
+        dst += 16;
+        src += 8;
+        n -= 2u;
+    }
+    EGA_Planar16_Xlat8_C(dst,src,n);
+}
+
+VGA_DRAW_SSSE3_FUNC static void VGA_Packed4_Xlat32_SSSE3(Bit8u *dst,const Bit8u *src,Bitu n) {
+    const __m128i lowmask = _mm_set1_epi8(0x0F);
+    __m128i tab[4];
+    VGA_SSSE3_Xlat32_Tables(tab);
+    while (n >= 8u) {
+        const __m128i t = _mm_loadl_epi64((const __m128i*)src);
+        const __m128i hi = _mm_and_si128(_mm_srli_epi16(t,4),lowmask);
+        const __m128i lo = _mm_and_si128(t,lowmask);
+        VGA_SSSE3_Xlat32_Store(dst,_mm_unpacklo_epi8(hi,lo),tab);
+        dst += 16*4;
+        src += 8;
+        n -= 8u;
+    }
+    VGA_Packed4_Xlat32_C(dst,src,n);
+}
+
+VGA_DRAW_SSSE3_FUNC static void VGA_Packed4_Xlat8_SSSE3(Bit8u *dst,const Bit8u *src,Bitu n) {
+    const __m128i lowmask = _mm_set1_epi8(0x0F);
+    const __m128i pal = _mm_loadu_si128((const __m128i*)vga.attr.palette);
+    while (n >= 16u) {
+        const __m128i t = _mm_loadu_si128((const __m128i*)src);
+        const __m128i hi = _mm_shuffle_epi8(pal,_mm_and_si128(_mm_srli_epi16(t,4),lowmask));
+        const __m128i lo = _mm_shuffle_epi8(pal,_mm_and_si128(t,lowmask));
+        _mm_storeu_si128((__m128i*)(dst+ 0),_mm_unpacklo_epi8(hi,lo));
+        _mm_storeu_si128((__m128i*)(dst+16),_mm_unpackhi_epi8(hi,lo));
+        dst += 32;
+        src += 16;
+        n -= 16u;
+    }
+    VGA_Packed4_Xlat8_C(dst,src,n);
+}
+
+VGA_DRAW_SSSE3_FUNC static void VGA_Packed4_Xlat8_Double_SSSE3(Bit8u *dst,const Bit8u *src,Bitu n) {
+    const __m128i lowmask = _mm_set1_epi8(0x0F);
+    const __m128i pal = _mm_loadu_si128((const __m128i*)vga.attr.palette);
+    while (n >= 16u) {
+        const __m128i t = _mm_loadu_si128((const __m128i*)src);
+        const __m128i hi = _mm_shuffle_epi8(pal,_mm_and_si128(_mm_srli_epi16(t,4),lowmask));
+        const __m128i lo = _mm_shuffle_epi8(pal,_mm_and_si128(t,lowmask));
+        const __m128i p0 = _mm_unpacklo_epi8(hi,lo);
+        const __m128i p1 = _mm_unpackhi_epi8(hi,lo);
+        _mm_storeu_si128((__m128i*)(dst+ 0),_mm_unpacklo_epi8(p0,p0));
+        _mm_storeu_si128((__m128i*)(dst+16),_mm_unpackhi_epi8(p0,p0));
+        _mm_storeu_si128((__m128i*)(dst+32),_mm_unpacklo_epi8(p1,p1));
+        _mm_storeu_si128((__m128i*)(dst+48),_mm_unpackhi_epi8(p1,p1));
+        dst += 64;
+        src += 16;
+        n -= 16u;
+    }
+    VGA_Packed4_Xlat8_Double_C(dst,src,n);
+}
+
+# define VGA_DRAW_SIMD(f)       (ssse3_available ? f##_SSSE3 : f##_C)
+# define VGA_DRAW_SIMD_ONLY(f)  f##_SSSE3
+#else
+# define VGA_DRAW_SIMD(f)       f##_C
+# define VGA_DRAW_SIMD_ONLY(f)  NULL
+#endif
+
+struct VGA_Draw_ConverterInfo {
+    const char*                 name;
+    unsigned int                pixels;         // pixels per source unit
+    unsigned int                unit;           // bytes per source unit
+    unsigned int                bpp;            // bytes per output pixel
+    VGA_Draw_Converter          scalar;
+    VGA_Draw_Converter          simd;
+};
+
+static const VGA_Draw_ConverterInfo vga_draw_converters[] = {
+    {"planar16 to 32bpp",   8,4,4,  VGA_Planar16_Xlat32_C,      VGA_DRAW_SIMD_ONLY(VGA_Planar16_Xlat32)},
+    {"planar16 to 8bpp",    8,4,1,  EGA_Planar16_Xlat8_C,       VGA_DRAW_SIMD_ONLY(EGA_Planar16_Xlat8)},
+    {"packed4 to 32bpp",    2,1,4,  VGA_Packed4_Xlat32_C,       VGA_DRAW_SIMD_ONLY(VGA_Packed4_Xlat32)},
+    {"packed4 to 8bpp",     2,1,1,  VGA_Packed4_Xlat8_C,        VGA_DRAW_SIMD_ONLY(VGA_Packed4_Xlat8)},
+    {"packed4 to 8bpp x2",  4,1,1,  VGA_Packed4_Xlat8_Double_C, VGA_DRAW_SIMD_ONLY(VGA_Packed4_Xlat8_Double)},
+    {"8bpp to 32bpp",       1,1,4,  VGA_Linear8_Xlat32_C,       NULL}
+};
+
+static double VGA_DrawBenchmarkRun(VGA_Draw_Converter conv,Bit8u *dst,const Bit8u *src,Bitu n,Bitu pixels,unsigned int lines) {
+    const std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+    for (unsigned int l=0;l < lines;l++) conv(dst,src,n);
+    const double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    return secs > 0 ? ((double)pixels * lines) / secs / 1000000.0 : 0;
+}
+
+/* Runs each converter over the same random line of the given width, with the current palette */
+void VGA_DrawBenchmark(std::vector<VGA_DrawBenchResult> &res,unsigned int width,unsigned int lines) {
+    res.clear();
+    for (size_t i=0;i < sizeof(vga_draw_converters)/sizeof(vga_draw_converters[0]);i++) {
+        const VGA_Draw_ConverterInfo &c = vga_draw_converters[i];
+        const Bitu n = (width + c.pixels - 1u) / c.pixels;
+        const Bitu pixels = n * c.pixels;
+        std::vector<Bit8u> src(n * c.unit);
+        std::vector<Bit8u> out1(pixels * c.bpp),out2(pixels * c.bpp);
+        Bit32u seed = 0x12345678u;
+
+        for (size_t j=0;j < src.size();j++) {
+            seed = seed * 1103515245u + 12345u;
+            src[j] = (Bit8u)(seed >> 24u);
+        }
+
+        VGA_DrawBenchResult r;
+        r.name = c.name;
+        r.scalar = VGA_DrawBenchmarkRun(c.scalar,&out1[0],&src[0],n,pixels,lines);
+        r.simd = 0;
+        r.same = true;
+#if defined(VGA_DRAW_SSSE3)
+        if (c.simd != NULL && ssse3_available) {
+            r.simd = VGA_DrawBenchmarkRun(c.simd,&out2[0],&src[0],n,pixels,lines);
+            r.same = memcmp(&out1[0],&out2[0],out1.size()) == 0;
+        }
+#endif
+        res.push_back(r);
+    }
+}
+
 static Bit8u * VGA_Draw_4BPP_Line(Bitu vidstart, Bitu line) {
     const Bit8u *base = vga.tandy.draw_base + ((line & vga.tandy.line_mask) << vga.tandy.line_shift);
     Bit8u* draw=TempLine;
     Bitu end = vga.draw.blocks*2;
+    const Bit8u *src = VGA_Draw_Contiguous(base,vidstart,vga.tandy.addr_mask,end);
+    if (src != NULL) {
+        VGA_DRAW_SIMD(VGA_Packed4_Xlat8)(TempLine,src,end);
+        return TempLine;
+    }
     while(end) {
         Bit8u byte = base[vidstart & vga.tandy.addr_mask];
         *draw++=vga.attr.palette[byte >> 4];
@@ -484,6 +781,11 @@ static Bit8u * VGA_Draw_4BPP_Line_Double(Bitu vidstart, Bitu line) {
     const Bit8u *base = vga.tandy.draw_base + ((line & vga.tandy.line_mask) << vga.tandy.line_shift);
     Bit8u* draw=TempLine;
     Bitu end = vga.draw.blocks;
+    const Bit8u *src = VGA_Draw_Contiguous(base,vidstart,vga.tandy.addr_mask,end);
+    if (src != NULL) {
+        VGA_DRAW_SIMD(VGA_Packed4_Xlat8_Double)(TempLine,src,end);
+        return TempLine;
+    }
     while(end) {
         Bit8u byte = base[vidstart & vga.tandy.addr_mask];
         Bit8u data = vga.attr.palette[byte >> 4];
@@ -775,14 +1077,18 @@ static Bit8u * VGA_Draw_Xlat32_Linear_Line(Bitu vidstart, Bitu /*line*/) {
         vidstart += (Bitu)((int)x);
     }
 
+    const Bit8u *src = VGA_Draw_Contiguous(vga.draw.linear_base,vidstart,vga.draw.linear_mask,vga.draw.line_length>>2);
+    if (src != NULL) {
+        VGA_Linear8_Xlat32_C(TempLine,src,vga.draw.line_length>>2);
+        return TempLine;
+    }
+
     for(Bitu i = 0; i < (vga.draw.line_length>>2); i++)
         temps[i]=vga.dac.xlat32[vga.draw.linear_base[(vidstart+i)&vga.draw.linear_mask]];
 
     return TempLine;
 }
 
-extern Bit32u Expand16Table[4][16];
-
 template <const unsigned int card,typename templine_type_t> static inline templine_type_t EGA_Planar_Common_Block_xlat(const Bit8u t) {
     if (card == MCH_VGA)
         return vga.dac.xlat32[t];
@@ -843,6 +1149,17 @@ template <const unsigned int card,typename templine_type_t> static Bit8u * EGA_P
     Bitu count = vga.draw.blocks + ((vga.draw.panning + 7u) >> 3u);
     Bitu i = 0;
 
+    if (vga.config.addr_shift == 0) {
+        const Bit8u *src = VGA_Draw_Contiguous(vga.draw.linear_base,vidstart,vga.draw.linear_mask,count*4u);
+        if (src != NULL) {
+            if (card == MCH_VGA)
+                VGA_DRAW_SIMD(VGA_Planar16_Xlat32)(TempLine,src,count);
+            else
+                VGA_DRAW_SIMD(EGA_Planar16_Xlat8)(TempLine,src,count);
+            return TempLine + (vga.draw.panning*sizeof(templine_type_t));
+        }
+    }
+
     while (count > 0u) {
         Bit32u t1,t2;
         t1 = t2 = *((Bit32u*)(&vga.draw.linear_base[ vidstart & vga.draw.linear_mask ]));
@@ -889,6 +1206,12 @@ static Bit8u * Alt_VGA_Planar_Draw_Line(Bitu /*vidstart*/, Bitu /*line*/) {
 
 static Bit8u * VGA_Draw_VGA_Packed4_Xlat32_Line(Bitu vidstart, Bitu /*line*/) {
     Bit32u* temps = (Bit32u*) TempLine;
+    const Bitu count = ((vga.draw.line_length>>2)+vga.draw.panning+1u)>>1u;
+    const Bit8u *src = VGA_Draw_Contiguous(vga.draw.linear_base,vidstart,vga.draw.linear_mask,count);
+    if (src != NULL) {
+        VGA_DRAW_SIMD(VGA_Packed4_Xlat32)(TempLine,src,count);
+        return TempLine + (vga.draw.panning*4);
+    }
 
     for (Bitu i = 0; i < ((vga.draw.line_length>>2)+vga.draw.panning); i += 2) {
         Bit8u t = vga.draw.linear_base[ vidstart & vga.draw.linear_mask ];
@@ -2358,6 +2681,164 @@ void VGA_Alt_NextScanLine(void) {
     }
 }
 
+/* Converted scanlines of the last frames, one per line of the frame.
+ *
+ * The planar write handlers stamp each block of video memory they write with the frame number
+ * and register writes that change the picture count up vga.dirty.state. If a line is drawn from
+ * the same address by the same line handler, none of the memory it reads was written since it
+ * was converted and no register was written, the stored line is handed to the render code as is.
+ * The render cache then finds it unchanged, without the line having to be converted again. */
+struct VGA_DirtyLine {
+    VGA_Line_Handler    handler;
+    Bitu                address;
+    Bitu                line;
+    Bitu                key;        // panning, text cursor column and blink
+    Bit32u              state;      // vga.dirty.frame_state when converted
+    Bit8u               frame;      // vga.dirty.frame when converted
+    bool                valid;
+};
+
+static std::vector<VGA_DirtyLine>   vga_dirty_lines;
+static std::vector<Bit8u>           vga_dirty_store;
+
+#define VGA_DIRTY_KEY_CURSOR        0x100u
+#define VGA_DIRTY_KEY_CURSOR_ON     0x200u
+#define VGA_DIRTY_KEY_BLINK         0x400u
+#define VGA_DIRTY_KEY_FONT          0x800u
+
+/* The line handler only reads planar memory, and all writes to it go through the tracked handlers */
+static bool VGA_DirtyTracked(void) {
+    if (!vga.dirty.tracked || vga.lfb.handler != NULL)
+        return false;
+
+    return VGA_DrawLine == VGA_TEXT_Xlat32_Draw_Line || VGA_DrawLine == EGA_TEXT_Xlat8_Draw_Line ||
+        VGA_DrawLine == VGA_Draw_VGA_Planar_Xlat32_Line || VGA_DrawLine == EGA_Draw_VGA_Planar_Xlat8_Line ||
+        (VGA_DrawLine == VGA_Draw_Xlat32_VGA_CRTC_bmode_Line && !vga_enable_hretrace_effects);
+}
+
+/* Video memory read by a tracked line handler for this line, false if it wraps around the end
+ * or the mask has a hole (CGA compatible addressing of the EGA modes) */
+static bool VGA_DirtyRange(Bitu vidstart,Bitu line,Bitu &start,Bitu &bytes,Bitu &key) {
+    Bitu count;
+
+    key = vga.draw.panning;
+    if (VGA_DrawLine == VGA_TEXT_Xlat32_Draw_Line || VGA_DrawLine == EGA_TEXT_Xlat8_Draw_Line) {
+        start = (vidstart & vga.draw.planar_mask) * 4u;
+        count = vga.draw.blocks + (vga.draw.panning ? 1u : 0u);
+
+        const Bits attr_addr = ((Bits)vga.draw.cursor.address - (Bits)vidstart) >> (Bits)vga.config.addr_shift;
+        if (vga.draw.cursor.enabled && line >= vga.draw.cursor.sline && line <= vga.draw.cursor.eline &&
+            attr_addr >= 0 && attr_addr < (Bits)vga.draw.blocks) {
+            key |= VGA_DIRTY_KEY_CURSOR | ((Bitu)attr_addr << 12u);
+            if (vga.draw.cursor.count & 0x8) key |= VGA_DIRTY_KEY_CURSOR_ON;
+        }
+        if (vga.draw.blink) key |= VGA_DIRTY_KEY_BLINK;
+        key |= VGA_DIRTY_KEY_FONT;
+    }
+    else if (VGA_DrawLine == VGA_Draw_VGA_Planar_Xlat32_Line || VGA_DrawLine == EGA_Draw_VGA_Planar_Xlat8_Line) {
+        start = vidstart & vga.draw.linear_mask;
+        count = vga.draw.blocks + ((vga.draw.panning + 7u) >> 3u);
+    }
+    else {
+        start = vidstart & vga.draw.linear_mask & ~3ul;
+        count = (vga.draw.line_length >> 4u) + (((vidstart & 3u) + 3u) >> 2u);
+    }
+
+    const Bitu mask = (Bitu)vga.draw.linear_mask;
+    if (count == 0u || (mask & (mask + 1u)) != 0u) return false;
+    bytes = ((count - 1u) << (2u + vga.config.addr_shift)) + 4u;
+    return start + bytes <= mask + 1u;
+}
+
+static Bit8u * VGA_DrawLine_Tracked(Bitu vidstart,Bitu line) {
+    const Bitu index = vga.draw.lines_done;
+    Bitu start,bytes,key;
+
+    if (!vga_skip_unchanged_lines || index >= vga.draw.lines_total || !VGA_DirtyTracked() ||
+        !VGA_DirtyRange(vidstart,line,start,bytes,key))
+        return VGA_DrawLine(vidstart,line);
+
+    if (vga_dirty_lines.size() != vga.draw.lines_total || vga_dirty_store.size() != vga.draw.lines_total * vga.draw.line_length) {
+        vga_dirty_lines.assign(vga.draw.lines_total,VGA_DirtyLine());
+        vga_dirty_store.resize(vga.draw.lines_total * vga.draw.line_length);
+    }
+
+    VGA_DirtyLine &rec = vga_dirty_lines[index];
+    Bit8u *store = &vga_dirty_store[index * vga.draw.line_length];
+    const Bit8u age = (Bit8u)(vga.dirty.frame - rec.frame);
+
+    /* a write in the frame the line was converted in counts too, it may have come after */
+    if (rec.valid && rec.handler == VGA_DrawLine && rec.address == vidstart && rec.line == line && rec.key == key &&
+        rec.state == vga.dirty.frame_state && vga.dirty.state == vga.dirty.frame_state && age < 0x80u) {
+        bool same = !(key & VGA_DIRTY_KEY_FONT) || (Bit8u)(vga.dirty.font_stamp - rec.frame) > age;
+        const Bit8u *s = vga.dirty.stamp + (start >> VGA_DIRTY_SHIFT);
+        const Bit8u *e = vga.dirty.stamp + ((start + bytes - 1u) >> VGA_DIRTY_SHIFT);
+
+        for (;same && s <= e;s++) {
+            if ((Bit8u)(*s - rec.frame) <= age) same = false;
+        }
+
+        if (same) return store;
+    }
+
+    Bit8u *data = VGA_DrawLine(vidstart,line);
+    memcpy(store,data,vga.draw.line_length);
+
+    rec.handler = VGA_DrawLine;
+    rec.address = vidstart;
+    rec.line = line;
+    rec.key = key;
+    rec.state = vga.dirty.frame_state;
+    rec.frame = vga.dirty.frame;
+    rec.valid = true;
+    return data;
+}
+
+/* What a frame depends on besides video memory and vga.dirty.state. The display start, the
+ * cursor location and the panning are latched without counting up the state, and the text
+ * cursor and blinking attributes change with the frame count. */
+#define VGA_FRAME_KEY_SIZE 10
+
+static Bitu vga_frame_key[VGA_FRAME_KEY_SIZE];
+
+static void VGA_FrameKey(Bitu *key) {
+    const bool text = VGA_DrawLine == VGA_TEXT_Xlat32_Draw_Line || VGA_DrawLine == EGA_TEXT_Xlat8_Draw_Line;
+
+    key[0] = vga.config.display_start;
+    key[1] = vga.config.real_start;
+    key[2] = vga.config.bytes_skip;
+    key[3] = vga.draw.bytes_skip;
+    key[4] = vga.config.hlines_skip;
+    key[5] = vga.config.pel_panning;
+    key[6] = vga.draw.panning;
+    key[7] = vga.config.cursor_start;
+    key[8] = (text && vga.draw.cursor.enabled) ? (vga.draw.cursor.count & 0x8u) : 0u;
+    key[9] = (text && vga.draw.blinking) ? ((vga.draw.cursor.count >> 4u) & 1u) : 0u;
+}
+
+/* Nothing the next frame is drawn from changed since the last frame was drawn, so the host
+ * still shows the right picture and the frame can be left out altogether */
+static bool VGA_StaticFrame(void) {
+    Bitu key[VGA_FRAME_KEY_SIZE];
+
+    if (!vga_skip_unchanged_frames || !VGA_DirtyTracked())
+        return false;
+    if (enable_page_flip_debugging_marker || enable_vretrace_poll_debugging_marker || VGA_IsCaptureEnabled())
+        return false;
+
+    /* the last frame has to have been drawn completely */
+    if (vga.draw.lines_done < vga.draw.lines_total)
+        return false;
+    if (vga.dirty.written || vga.dirty.state != vga.dirty.frame_state)
+        return false;
+
+    VGA_FrameKey(key);
+    if (memcmp(key,vga_frame_key,sizeof(key)) != 0)
+        return false;
+
+    return RENDER_CanSkipFrame();
+}
+
 static void VGA_DrawSingleLine(Bitu /*blah*/) {
     unsigned int lines = 0;
     bool skiprender;
@@ -2440,7 +2921,13 @@ again:
             }
             RENDER_DrawLine(TempLine);
         } else {
-            Bit8u * data=VGA_DrawLine( vga.draw.address, vga.draw.address_line );
+            /* the debug markers below draw into the line, which must not end up in the stored lines */
+            Bit8u * data;
+            if (vga_page_flip_occurred || vga_3da_polled)
+                data=VGA_DrawLine( vga.draw.address, vga.draw.address_line );
+            else
+                data=VGA_DrawLine_Tracked( vga.draw.address, vga.draw.address_line );
+
             if (vga_page_flip_occurred) {
                 memxor(data,0xFF,vga.draw.width*(vga.draw.bpp>>3));
                 vga_page_flip_occurred = false;
@@ -2548,7 +3035,7 @@ static void VGA_DrawEGASingleLine(Bitu /*blah*/) {
                         break;
                 }
             }
-            Bit8u * data=VGA_DrawLine(address, vga.draw.address_line ); 
+            Bit8u * data=VGA_DrawLine_Tracked(address, vga.draw.address_line ); 
 
             if (VGA_IsCaptureEnabled())
                 VGA_ProcessScanline(data);
@@ -2597,6 +3084,7 @@ void VGA_SetBlinking(Bitu enabled) {
         vga.tandy.mode_control&=~0x20;
     }
     for (Bitu i=0;i<8;i++) TXT_BG_Table[i+8]=(b+i) | ((b+i) << 8)| ((b+i) <<16) | ((b+i) << 24);
+    vga.dirty.state++;
 }
 
 extern bool                        GDC_vsync_interrupt;
@@ -2958,6 +3446,7 @@ static void VGA_VerticalTimer(Bitu /*val*/) {
     }
     // for same blinking frequency with higher frameskip
     vga.draw.cursor.count++;
+    vga.dirty.frame++;
 
     if (IS_PC98_ARCH) {
         for (unsigned int i=0;i < 2;i++)
@@ -2965,8 +3454,19 @@ static void VGA_VerticalTimer(Bitu /*val*/) {
     }
 
     //Check if we can actually render, else skip the rest
-    if (vga.draw.vga_override || !RENDER_StartUpdate()) return;
+    if (vga.draw.vga_override) return;
+
+    if (VGA_StaticFrame()) {
+        /* counts as drawn, for the frame rate compensation above */
+        vga_mode_frames_since_time_base++;
+        return;
+    }
+
+    if (!RENDER_StartUpdate()) return;
 
+    vga.dirty.frame_state = vga.dirty.state;
+    vga.dirty.written = false;
+    VGA_FrameKey(vga_frame_key);
     vga.draw.address_line = vga.config.hlines_skip;
     if (IS_EGAVGA_ARCH) VGA_Update_SplitLineCompare();
     vga.draw.address = vga.config.real_start;
@@ -3345,6 +3845,7 @@ void VGA_ActivateHardwareCursor(void) {
 }
 
 void VGA_SetupDrawing(Bitu /*val*/) {
+    vga.dirty.state++;
     if (vga.mode==M_ERROR) {
         PIC_RemoveEvents(VGA_VerticalTimer);
         PIC_RemoveEvents(VGA_PanningLatch);
@@ -39,6 +39,7 @@ static Bitu read_p3ce(Bitu port,Bitu iolen) {
 static void write_p3cf(Bitu port,Bitu val,Bitu iolen) {
     (void)port;//UNUSED
     (void)iolen;//UNUSED
+	if (gfx(index) == 5 || gfx(index) == 6) vga.dirty.state++; /* the others only affect memory access */
 	switch (gfx(index)) {
 	case 0:	/* Set/Reset Register */
 		gfx(set_reset)=val & 0x0f;
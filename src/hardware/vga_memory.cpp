@@ -344,6 +344,11 @@ template <const bool chained> static inline void VGA_Generic_Write_Handler(PhysP
     vga.draw.font[planeaddr] = pixels.b[2];
 
     ((Bit32u*)vga.mem.linear)[planeaddr]=pixels.d;
+
+    /* so the drawing code knows which scanlines need to be converted again */
+    vga.dirty.stamp[planeaddr >> (VGA_DIRTY_SHIFT - 2u)] = vga.dirty.frame;
+    vga.dirty.written = true;
+    if (mask & 0x00FF0000u) vga.dirty.font_stamp = vga.dirty.frame;
 }
 
 // Slow accurate emulation.
@@ -2183,6 +2188,7 @@ void VGA_SetupHandlers(void) {
 	vga.svga.bank_write_full = vga.svga.bank_write*vga.svga.bank_size;
 
 	PageHandler *newHandler;
+	vga.dirty.tracked = false;
 	switch (machine) {
 	case MCH_CGA:
 		if (enableCGASnow && (vga.mode == M_TEXT || vga.mode == M_TANDY_TEXT))
@@ -2387,6 +2393,8 @@ void VGA_SetupHandlers(void) {
 	}
 	if(svgaCard == SVGA_S3Trio && (vga.s3.ext_mem_ctrl & 0x10))
 		MEM_SetPageHandler(VGA_PAGE_A0, 16, &vgaph.mmio);
+	else
+		vga.dirty.tracked = (newHandler == &vgaph.cvga_slow || newHandler == &vgaph.cvga_et4000_slow || newHandler == &vgaph.uvga);
 
     non_cga_ignore_oddeven_engage = (non_cga_ignore_oddeven && !(vga.mode == M_TEXT || vga.mode == M_CGA2 || vga.mode == M_CGA4));
 
@@ -2451,6 +2459,10 @@ static void VGA_Memory_ShutDown(Section * /*sec*/) {
 		vga.mem.linear_orgptr = NULL;
 		vga.mem.linear = NULL;
 	}
+	if (vga.dirty.stamp != NULL) {
+		delete[] vga.dirty.stamp;
+		vga.dirty.stamp = NULL;
+	}
 }
 
 void VGAMEM_LoadState(Section *sec) {
@@ -2460,8 +2472,10 @@ void VGAMEM_LoadState(Section *sec) {
         ZIPFileEntry *ent = savestate_zip.get_entry("vga.memory.bin");
         if (ent != NULL) {
             ent->rewind();
-            if (vga.mem.memsize == (uint32_t)ent->file_length)
+            if (vga.mem.memsize == (uint32_t)ent->file_length) {
                 ent->read(vga.mem.linear, vga.mem.memsize);
+                vga.dirty.state++;
+            }
             else
                 LOG_MSG("VGA Memory load state failure: VGA Memory size mismatch");
         }
@@ -2490,6 +2504,9 @@ void VGA_SetupMemory() {
         memset(vga.mem.linear_orgptr,0,vga.mem.memsize+32u);
         vga.mem.linear=(Bit8u*)(((uintptr_t)vga.mem.linear_orgptr + 16ull-1ull) & ~(16ull-1ull));
 
+        vga.dirty.stamp = new Bit8u[(vga.mem.memsize >> VGA_DIRTY_SHIFT) + 1u];
+        memset(vga.dirty.stamp,0,(vga.mem.memsize >> VGA_DIRTY_SHIFT) + 1u);
+
         /* HACK. try to avoid stale pointers */
 	    vga.draw.linear_base = vga.mem.linear;
         vga.tandy.draw_base = vga.mem.linear;
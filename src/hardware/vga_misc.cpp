@@ -73,11 +73,36 @@ Bitu vga_read_p3da(Bitu port,Bitu iolen) {
 	return retval;
 }
 
+/* idle hint for 3DAh: the next blanking or retrace edge, or the end of the frame.
+ * Returning an earlier time than the real change is always safe. */
+static double vga_idlehint_p3da(Bitu port) {
+    (void)port;//UNUSED
+	const double timeInFrame = PIC_FullIndex()-vga.draw.delay.framestart;
+	double next = vga.draw.delay.vtotal;
+
+	if (timeInFrame < vga.draw.delay.vdend) {
+		const double lineStart = timeInFrame - fmod(timeInFrame,vga.draw.delay.htotal);
+		const double timeInLine = timeInFrame - lineStart;
+		if (timeInLine < vga.draw.delay.hblkstart) next = lineStart + vga.draw.delay.hblkstart;
+		else if (timeInLine <= vga.draw.delay.hblkend) next = lineStart + vga.draw.delay.hblkend;
+		else next = lineStart + vga.draw.delay.htotal;
+		if (next > vga.draw.delay.vdend) next = vga.draw.delay.vdend;
+	}
+	if (timeInFrame < vga.draw.delay.vrstart) {
+		if (next > vga.draw.delay.vrstart) next = vga.draw.delay.vrstart;
+	}
+	else if (timeInFrame <= vga.draw.delay.vrend) {
+		if (next > vga.draw.delay.vrend) next = vga.draw.delay.vrend;
+	}
+	return vga.draw.delay.framestart + next;
+}
+
 static void write_p3c2(Bitu port,Bitu val,Bitu iolen) {
     (void)port;//UNUSED
     (void)iolen;//UNUSED
 	if((machine==MCH_EGA) && ((vga.misc_output^val)&0xc)) VGA_StartResize();
 	vga.misc_output=(Bit8u)val;
+	vga.dirty.state++;
 	Bitu base=(val & 0x1) ? 0x3d0 : 0x3b0;
 	Bitu free=(val & 0x1) ? 0x3b0 : 0x3d0;
 	Bitu first=2, last=2;
@@ -96,6 +121,8 @@ static void write_p3c2(Bitu port,Bitu val,Bitu iolen) {
 
 	IO_RegisterReadHandler(base+0xa,vga_read_p3da,IO_MB);
 	IO_FreeReadHandler(free+0xa,IO_MB);
+	IO_RegisterIdleHint(base+0xa,vga_idlehint_p3da);
+	IO_RegisterIdleHint(free+0xa,NULL);
 	
 	/*
 		0	If set Color Emulation. Base Address=3Dxh else Mono Emulation. Base Address=3Bxh.
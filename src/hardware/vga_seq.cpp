@@ -84,6 +84,7 @@ void VGA_Screenstate(bool enabled);
 
 void write_p3c5(Bitu /*port*/,Bitu val,Bitu iolen) {
 //	LOG_MSG("SEQ WRITE reg %X val %X",seq(index),val);
+	if (seq(index) != 2) vga.dirty.state++; /* the map mask does not change the picture */
 	switch(seq(index)) {
 	case 0:		/* Reset */
 		if((seq(reset)^val)&0x3) VGA_SequReset((val&0x3)!=0x3);
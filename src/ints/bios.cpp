@@ -44,6 +44,7 @@
 extern bool PS1AudioCard;
 #include "parport.h"
 #include "dma.h"
+#include "replay.h"
 #include <time.h>
 
 #if defined(DB_HAVE_CLOCK_GETTIME) && ! defined(WIN32)
@@ -4610,7 +4611,7 @@ static Bitu INT1C_PC98_Handler(void) {
     if (reg_ah == 0x00) { /* get time and date */
         time_t curtime;
         struct tm *loctime;
-        curtime = time (NULL);
+        curtime = REPLAY_Time();
         loctime = localtime (&curtime);
 
         unsigned char tmp[6];
@@ -5310,6 +5311,12 @@ static void BIOS_HostTimeSync() {
     loctime = localtime (&timebuffer.time);
     milli = (Bit32u) timebuffer.millitm;
 #endif
+    /* recording or replaying input, the clock follows the emulated time */
+    if (replay_mode != REPLAY_OFF) {
+        time_t curtime = REPLAY_Time();
+        loctime = localtime(&curtime);
+        milli = 0;
+    }
     /*
     loctime->tm_hour = 23;
     loctime->tm_min = 59;
@@ -7021,8 +7028,8 @@ private:
 
         if (bios_post_counter != 0 && reset_post_delay != 0) {
             /* reboot delay, in case the guest OS/application had something to day before hitting the "reset" signal */
-            Bit32u lasttick=GetTicks();
-            while ((GetTicks()-lasttick) < reset_post_delay) {
+            Bit32u lasttick=GetGuestTicks();
+            while ((GetGuestTicks()-lasttick) < reset_post_delay) {
                 void CALLBACK_IdleNoInts(void);
                 CALLBACK_IdleNoInts();
             }
@@ -8456,8 +8463,8 @@ private:
 #else
         if (!control->opt_fastbioslogo) {
             bool wait_for_user = false;
-            Bit32u lasttick=GetTicks();
-            while ((GetTicks()-lasttick)<1000) {
+            Bit32u lasttick=GetGuestTicks();
+            while ((GetGuestTicks()-lasttick)<1000) {
                 if (machine == MCH_PC98) {
                     reg_eax = 0x0100;   // sense key
                     CALLBACK_RunRealInt(0x18);
@@ -26,6 +26,7 @@
 #include "int10.h"
 #include "mouse.h"
 #include "setup.h"
+#include "sharedrom.h"
 
 Int10Data int10;
 static Bitu call_10 = 0;
@@ -1151,6 +1152,8 @@ void INT10_Startup(Section *sec) {
             /* Failing all else we can just re-use the IBM VGA 8x16 font to show SOMETHING on the screen.
              * Japanese text will not display properly though. */
             if (!ok) ok = Load_VGAFont_As_PC98();
+            /* the character generator RAM (gaiji) writes to it, which only unshares those pages */
+            SHAREDROM_Share(vga.draw.font,sizeof(vga.draw.font),"pc98font");
         }
 
         CurMode = &PC98_Mode;
@@ -38,6 +38,7 @@
 #include "support.h"
 #include "setup.h"
 #include "control.h"
+#include "replay.h"
 
 #if defined(_MSC_VER)
 # pragma warning(disable:4244) /* const fmath::local::uint64_t to double possible loss of data */
@@ -597,6 +598,9 @@ extern bool user_cursor_locked;
 
 /* FIXME: Re-test this code */
 void Mouse_CursorMoved(float xrel,float yrel,float x,float y,bool emulate) {
+    if (GCC_UNLIKELY(replay_mode != REPLAY_OFF) && !REPLAY_MouseMoved(xrel,yrel,x,y,emulate))
+        return;
+
     extern bool Mouse_Vertical;
     float dx = xrel * mouse.pixelPerMickey_x;
     float dy = (Mouse_Vertical?-yrel:yrel) * mouse.pixelPerMickey_y;
@@ -708,6 +712,9 @@ uint8_t Mouse_GetButtonState(void) {
 }
 
 void Mouse_ButtonPressed(Bit8u button) {
+    if (GCC_UNLIKELY(replay_mode != REPLAY_OFF) && !REPLAY_MouseButton(button,true))
+        return;
+
     if (!IS_PC98_ARCH && KEYBOARD_AUX_Active()) {
         switch (button) {
             case 0:
@@ -765,6 +772,9 @@ void Mouse_ButtonPressed(Bit8u button) {
 }
 
 void Mouse_ButtonReleased(Bit8u button) {
+    if (GCC_UNLIKELY(replay_mode != REPLAY_OFF) && !REPLAY_MouseButton(button,false))
+        return;
+
     if (!IS_PC98_ARCH && KEYBOARD_AUX_Active()) {
         switch (button) {
             case 0:
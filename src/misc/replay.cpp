@@ -0,0 +1,273 @@
+/*
+ *  Copyright (C) 2002-2019  The DOSBox Team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1335, USA.
+ */
+
+/* Input recording and replay.
+ *
+ * The recording is a text file, one event per line, each line starts with the
+ * emulated millisecond (PIC_Ticks) the event was delivered at:
+ *
+ *   DOSBox-X input recording 1
+ *   time <wall clock time of the guest at startup>
+ *   <tick> cycles <CPU_CycleMax> <CPU_CycleAutoAdjust>
+ *   <tick> key <KBD_KEYS> <pressed>
+ *   <tick> move <xrel> <yrel> <x> <y> <emulate> <locked> <cursor x> <cursor y> <cursor width> <cursor height>
+ *   <tick> button <button> <pressed>
+ *   <tick> end
+ *
+ * The cycles are part of the recording because the auto adjustment measures
+ * against the host clock. The mouse movement carries the host cursor state the
+ * mouse emulation looks at. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+#include "dosbox.h"
+#include "cpu.h"
+#include "pic.h"
+#include "timer.h"
+#include "setup.h"
+#include "keyboard.h"
+#include "replay.h"
+
+#define REPLAY_MAGIC "DOSBox-X input recording 1"
+
+ReplayMode replay_mode = REPLAY_OFF;
+
+extern bool ticksVirtual;
+extern int  user_cursor_x,  user_cursor_y;
+extern int  user_cursor_sw, user_cursor_sh;
+extern bool user_cursor_locked;
+
+void GFX_Events(void);
+void Mouse_CursorMoved(float xrel,float yrel,float x,float y,bool emulate);
+void Mouse_ButtonPressed(Bit8u button);
+void Mouse_ButtonReleased(Bit8u button);
+
+static struct {
+    FILE * file;
+    std::string filename;
+    time_t start_time;          // wall clock time of the guest at emulated time 0
+    bool host_input;            // the host events are being processed
+    Bitu events;
+    // recording
+    Bit32s last_cycles;
+    bool last_auto;
+    // replay
+    char line[256];             // the next event, not yet due
+    Bitu line_tick;
+    bool line_valid;
+    Bit32u host_start;
+} replay;
+
+static void REPLAY_Stop(void) {
+    if (replay.file != NULL) fclose(replay.file);
+    replay.file = NULL;
+    replay_mode = REPLAY_OFF;
+}
+
+/* read the next event of the replay, false at the end of the file */
+static bool REPLAY_ReadLine(void) {
+    replay.line_valid = false;
+    while (fgets(replay.line,sizeof(replay.line),replay.file) != NULL) {
+        char *end;
+        replay.line_tick = (Bitu)strtoul(replay.line,&end,10);
+        if (end == replay.line) continue;      // not an event
+        replay.line_valid = true;
+        return true;
+    }
+    return false;
+}
+
+/* deliver one recorded event, returns false at the end of the recording */
+static bool REPLAY_Deliver(const char *ev) {
+    char name[16];
+    int n = 0;
+
+    if (sscanf(ev,"%*u %15s %n",name,&n) < 1) return true;
+    const char *args = ev + n;
+
+    if (!strcmp(name,"key")) {
+        unsigned int key,pressed;
+        if (sscanf(args,"%u %u",&key,&pressed) == 2 && key < KBD_LAST)
+            KEYBOARD_AddKey((KBD_KEYS)key,pressed != 0);
+    }
+    else if (!strcmp(name,"move")) {
+        float xrel,yrel,x,y;
+        int emulate,locked,cx,cy,sw,sh;
+        if (sscanf(args,"%f %f %f %f %d %d %d %d %d %d",&xrel,&yrel,&x,&y,&emulate,&locked,&cx,&cy,&sw,&sh) == 10) {
+            /* the mouse emulation looks at the host cursor, make it see the recorded one */
+            bool o_locked = user_cursor_locked;
+            int o_x = user_cursor_x,o_y = user_cursor_y,o_sw = user_cursor_sw,o_sh = user_cursor_sh;
+            user_cursor_locked = locked != 0;
+            user_cursor_x = cx;
+            user_cursor_y = cy;
+            user_cursor_sw = sw;
+            user_cursor_sh = sh;
+            Mouse_CursorMoved(xrel,yrel,x,y,emulate != 0);
+            user_cursor_locked = o_locked;
+            user_cursor_x = o_x;
+            user_cursor_y = o_y;
+            user_cursor_sw = o_sw;
+            user_cursor_sh = o_sh;
+        }
+    }
+    else if (!strcmp(name,"button")) {
+        unsigned int button,pressed;
+        if (sscanf(args,"%u %u",&button,&pressed) == 2) {
+            if (pressed) Mouse_ButtonPressed((Bit8u)button);
+            else Mouse_ButtonReleased((Bit8u)button);
+        }
+    }
+    else if (!strcmp(name,"cycles")) {
+        long cycles;
+        unsigned int autoadjust;
+        if (sscanf(args,"%ld %u",&cycles,&autoadjust) == 2) {
+            CPU_CycleMax = (Bit32s)cycles;
+            CPU_CycleAutoAdjust = autoadjust != 0;
+        }
+    }
+    else if (!strcmp(name,"end")) {
+        return false;
+    }
+    else {
+        LOG_MSG("REPLAY: Unknown event '%s' in %s",name,replay.filename.c_str());
+    }
+
+    replay.events++;
+    return true;
+}
+
+void REPLAY_Events(void) {
+    replay.host_input = true;
+    GFX_Events();
+    replay.host_input = false;
+
+    if (GCC_LIKELY(replay_mode == REPLAY_OFF)) return;
+
+    if (replay_mode == REPLAY_RECORD) {
+        /* the auto adjustment changes the cycles between the host events, log the value the next millisecond runs with */
+        if (CPU_CycleMax != replay.last_cycles || CPU_CycleAutoAdjust != replay.last_auto) {
+            replay.last_cycles = CPU_CycleMax;
+            replay.last_auto = CPU_CycleAutoAdjust;
+            fprintf(replay.file,"%lu cycles %ld %u\n",(unsigned long)PIC_Ticks,(long)CPU_CycleMax,CPU_CycleAutoAdjust ? 1u : 0u);
+        }
+        return;
+    }
+
+    while (replay.line_valid && replay.line_tick <= PIC_Ticks) {
+        if (!REPLAY_Deliver(replay.line)) {
+            LOG_MSG("REPLAY: Finished %s, %lu events, %lu emulated ms in %lu ms",
+                replay.filename.c_str(),(unsigned long)replay.events,(unsigned long)PIC_Ticks,
+                (unsigned long)(GetTicks() - replay.host_start));
+            REPLAY_Stop();
+            throw int(1);       // the recorded session ended here, so does the replay
+        }
+        REPLAY_ReadLine();
+    }
+}
+
+bool REPLAY_Key(KBD_KEYS keytype,bool pressed) {
+    if (!replay.host_input) return true;        // generated by the emulation (typematic repeat, autotype)
+    if (replay_mode == REPLAY_PLAY) return false;
+    fprintf(replay.file,"%lu key %u %u\n",(unsigned long)PIC_Ticks,(unsigned int)keytype,pressed ? 1u : 0u);
+    return true;
+}
+
+bool REPLAY_MouseMoved(float xrel,float yrel,float x,float y,bool emulate) {
+    if (!replay.host_input) return true;
+    if (replay_mode == REPLAY_PLAY) return false;
+    fprintf(replay.file,"%lu move %.9g %.9g %.9g %.9g %u %u %d %d %d %d\n",(unsigned long)PIC_Ticks,
+        (double)xrel,(double)yrel,(double)x,(double)y,emulate ? 1u : 0u,user_cursor_locked ? 1u : 0u,
+        user_cursor_x,user_cursor_y,user_cursor_sw,user_cursor_sh);
+    return true;
+}
+
+bool REPLAY_MouseButton(Bit8u button,bool pressed) {
+    if (!replay.host_input) return true;
+    if (replay_mode == REPLAY_PLAY) return false;
+    fprintf(replay.file,"%lu button %u %u\n",(unsigned long)PIC_Ticks,(unsigned int)button,pressed ? 1u : 0u);
+    return true;
+}
+
+time_t REPLAY_Time(void) {
+    if (replay_mode == REPLAY_OFF) return time(NULL);
+    return replay.start_time + (time_t)(PIC_Ticks / 1000);
+}
+
+void REPLAY_Shutdown(void) {
+    if (replay_mode == REPLAY_RECORD) {
+        fprintf(replay.file,"%lu end\n",(unsigned long)PIC_Ticks);
+        LOG_MSG("REPLAY: Recorded %lu emulated ms to %s",(unsigned long)PIC_Ticks,replay.filename.c_str());
+    }
+    REPLAY_Stop();
+}
+
+static void REPLAY_Destroy(Section *sec) {
+    (void)sec;//UNUSED
+    REPLAY_Shutdown();
+}
+
+void REPLAY_Init(const char *record_file,const char *replay_file) {
+    replay.file = NULL;
+    replay.host_input = false;
+    replay.events = 0;
+    replay.line_valid = false;
+
+    if (replay_file != NULL && *replay_file != 0) {
+        replay.filename = replay_file;
+        replay.file = fopen(replay_file,"r");
+        if (replay.file == NULL) {
+            LOG_MSG("REPLAY: Unable to open %s",replay_file);
+            return;
+        }
+        char line[256];
+        long long start = 0;
+        if (fgets(line,sizeof(line),replay.file) == NULL || strncmp(line,REPLAY_MAGIC,strlen(REPLAY_MAGIC)) ||
+            fgets(line,sizeof(line),replay.file) == NULL || sscanf(line,"time %lld",&start) != 1) {
+            LOG_MSG("REPLAY: %s is not an input recording",replay_file);
+            REPLAY_Stop();
+            return;
+        }
+        replay.start_time = (time_t)start;
+        replay_mode = REPLAY_PLAY;
+        REPLAY_ReadLine();
+        /* nothing to wait for, the input comes from the file */
+        ticksVirtual = true;
+        replay.host_start = GetTicks();
+        LOG_MSG("REPLAY: Replaying %s in virtual time, host input is ignored",replay_file);
+    }
+    else if (record_file != NULL && *record_file != 0) {
+        replay.filename = record_file;
+        replay.file = fopen(record_file,"w");
+        if (replay.file == NULL) {
+            LOG_MSG("REPLAY: Unable to create %s",record_file);
+            return;
+        }
+        replay.start_time = time(NULL);
+        replay.last_cycles = -1;
+        replay.last_auto = false;
+        fprintf(replay.file,"%s\ntime %lld\n",REPLAY_MAGIC,(long long)replay.start_time);
+        replay_mode = REPLAY_RECORD;
+        LOG_MSG("REPLAY: Recording input to %s",record_file);
+    }
+    else return;
+
+    AddExitFunction(AddExitFunctionFuncPair(REPLAY_Destroy));
+}
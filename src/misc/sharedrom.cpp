@@ -0,0 +1,142 @@
+/*
+ *  Copyright (C) 2002-2019  The DOSBox Team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1335, USA.
+ */
+
+/* Shared ROM image cache.
+ *
+ * The cache directory holds one file per distinct image, named after the image and
+ * a hash of its contents, e.g. "rom-40000-0123456789abcdef.rom". A file is written
+ * under a temporary name and renamed into place, so it is complete when another
+ * instance sees it, and it is never modified afterwards. That matters because the
+ * pages of a private file mapping nobody has written to yet follow the file. */
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+
+#include "dosbox.h"
+#include "control.h"
+#include "setup.h"
+#include "cross.h"
+#include "sharedrom.h"
+
+#if (C_HAVE_MPROTECT) && !defined(WIN32)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <fcntl.h>
+#include <unistd.h>
+#define SHAREDROM_SUPPORTED 1
+#endif
+
+#if defined(SHAREDROM_SUPPORTED)
+/* FNV-1a, only used to name the file. The contents are compared before mapping. */
+static Bit64u SHAREDROM_Hash(const unsigned char *p,size_t size) {
+    Bit64u h = 0xcbf29ce484222325ull;
+    while (size-- != 0) {
+        h ^= *p++;
+        h *= 0x100000001b3ull;
+    }
+    return h;
+}
+
+static bool SHAREDROM_WriteFile(const std::string &path,const unsigned char *p,size_t size) {
+    char suffix[32];
+    sprintf(suffix,".%lu.tmp",(unsigned long)getpid());
+    const std::string tmp = path + suffix;
+
+    int fd = open(tmp.c_str(),O_WRONLY|O_CREAT|O_TRUNC,0644);
+    if (fd < 0) return false;
+
+    size_t done = 0;
+    while (done < size) {
+        ssize_t r = write(fd,p+done,size-done);
+        if (r <= 0) break;
+        done += (size_t)r;
+    }
+
+    if (close(fd) != 0 || done != size || rename(tmp.c_str(),path.c_str()) != 0) {
+        unlink(tmp.c_str());
+        return false;
+    }
+
+    return true;
+}
+#endif
+
+size_t SHAREDROM_Share(void *buf,size_t size,const char *name) {
+#if defined(SHAREDROM_SUPPORTED)
+    Section_prop *section = static_cast<Section_prop *>(control->GetSection("dosbox"));
+    if (section == NULL) return 0;
+
+    Prop_path *proppath = section->Get_path("shared rom cache");
+    if (proppath == NULL || proppath->realpath.empty()) return 0;
+    const std::string &dir = proppath->realpath;
+
+    /* only whole host pages can be mapped */
+    const uintptr_t pagemask = (uintptr_t)sysconf(_SC_PAGESIZE) - 1u;
+    const uintptr_t start = ((uintptr_t)buf + pagemask) & ~pagemask;
+    const uintptr_t end = ((uintptr_t)buf + size) & ~pagemask;
+    if (end <= start) return 0;
+
+    unsigned char *p = (unsigned char*)start;
+    const size_t len = (size_t)(end - start);
+
+    char fname[128];
+    sprintf(fname,"%.32s-%lx-%016llx.rom",name,(unsigned long)len,(unsigned long long)SHAREDROM_Hash(p,len));
+    const std::string path = dir + CROSS_FILESPLIT + fname;
+
+    int fd = open(path.c_str(),O_RDONLY);
+    if (fd < 0) {
+        mkdir(dir.c_str(),0755);
+        if (!SHAREDROM_WriteFile(path,p,len)) {
+            LOG_MSG("SHAREDROM: Unable to write %s",path.c_str());
+            return 0;
+        }
+        fd = open(path.c_str(),O_RDONLY);
+        if (fd < 0) return 0;
+    }
+
+    struct stat st;
+    bool same = false;
+    if (fstat(fd,&st) == 0 && st.st_size == (off_t)len) {
+        void *chk = mmap(NULL,len,PROT_READ,MAP_SHARED,fd,0);
+        if (chk != MAP_FAILED) {
+            same = memcmp(chk,p,len) == 0;
+            munmap(chk,len);
+        }
+    }
+    if (!same) {
+        close(fd);
+        LOG_MSG("SHAREDROM: %s does not match the %s image, not sharing it",path.c_str(),name);
+        return 0;
+    }
+
+    /* the old pages are gone once this is attempted, failing here leaves a hole in the buffer */
+    void *map = mmap(p,len,PROT_READ|PROT_WRITE,MAP_PRIVATE|MAP_FIXED,fd,0);
+    close(fd);
+    if (map == MAP_FAILED) E_Exit("SHAREDROM: Unable to map %s",path.c_str());
+
+    LOG(LOG_MISC,LOG_DEBUG)("SHAREDROM: Sharing %luKB of the %s image from %s",(unsigned long)(len >> 10u),name,path.c_str());
+    return len;
+#else
+    (void)buf;//UNUSED
+    (void)size;//UNUSED
+    (void)name;//UNUSED
+    return 0;
+#endif
+}
@@ -492,6 +492,22 @@ bool OUTPUT_OPENGL_StartUpdate(Bit8u* &pixels, Bitu &pitch)
 
 void OUTPUT_OPENGL_EndUpdate(const Bit16u *changedLines)
 {
+    /* Nothing changed: the texture and the window still hold the last frame, so neither
+     * upload nor swap. Swapping would only make the driver present the same picture again. */
+    if (changedLines != NULL && changedLines[0] == sdl.draw.height &&
+        sdl_opengl.clear_countdown <= 0 && sdl_opengl.menudraw_countdown <= 0)
+    {
+#if C_XBRZ
+        if (!(sdl_xbrz.enable && sdl_xbrz.scale_on))
+#endif
+        if (sdl_opengl.pixel_buffer_object)
+        {
+            glUnmapBufferARB(GL_PIXEL_UNPACK_BUFFER_EXT);
+            glBindBufferARB(GL_PIXEL_UNPACK_BUFFER_EXT, 0);
+        }
+        return;
+    }
+
     if (!(sdl.must_redraw_all && changedLines == NULL)) 
     {
         if (sdl_opengl.clear_countdown > 0)
@@ -573,30 +589,40 @@ void OUTPUT_OPENGL_EndUpdate(const Bit16u *changedLines)
 #endif /*C_XBRZ*/
         if (sdl_opengl.pixel_buffer_object) 
         {
-            if (changedLines && (changedLines[0] == sdl.draw.height))
-                return;
-
             glUnmapBufferARB(GL_PIXEL_UNPACK_BUFFER_EXT);
             glBindTexture(GL_TEXTURE_2D, sdl_opengl.texture);
-            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0,
-                (int)sdl.draw.width, (int)sdl.draw.height, GL_BGRA_EXT,
+
+            // only upload the lines that changed, the rest of the texture is still right
+            Bitu y = 0, index = 0;
+            while (y < sdl.draw.height) 
+            {
+                Bitu height = changedLines ? changedLines[index] : sdl.draw.height;
+                if (changedLines && !(index & 1))
+                {
+                    y += height;
+                }
+                else
+                {
+                    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, (int)y,
+                        (int)sdl.draw.width, (int)height, GL_BGRA_EXT,
 #if defined (MACOSX)
-                // needed for proper looking graphics on macOS 10.12, 10.13
-                GL_UNSIGNED_INT_8_8_8_8,
+                        // needed for proper looking graphics on macOS 10.12, 10.13
+                        GL_UNSIGNED_INT_8_8_8_8,
 #else
-                // works on Linux
-                GL_UNSIGNED_INT_8_8_8_8_REV,
+                        // works on Linux
+                        GL_UNSIGNED_INT_8_8_8_8_REV,
 #endif
-                (void*)0);
+                        (void*)(y * sdl_opengl.pitch));
+                    y += height;
+                }
+                index++;
+            }
             glBindBufferARB(GL_PIXEL_UNPACK_BUFFER_EXT, 0);
             glCallList(sdl_opengl.displaylist);
             SDL_GL_SwapBuffers();
         }
         else if (changedLines) 
         {
-            if (changedLines[0] == sdl.draw.height)
-                return;
-
             Bitu y = 0, index = 0;
             glBindTexture(GL_TEXTURE_2D, sdl_opengl.texture);
             while (y < sdl.draw.height) 
@@ -5,12 +5,163 @@
 #include "dosbox.h"
 #include "sdlmain.h"
 
+#include <vector>
+#include <functional>
+
+#if !defined(WIN32)
+#include <unistd.h>
+#endif
+
 using namespace std;
 
+#if C_XBRZ || C_SURFACE_POSTRENDER_ASPECT
+
+typedef std::vector< std::pair<int,int> > xBRZ_Slices; /* [first,last) lines */
+typedef std::function<void(int,int)> xBRZ_SliceJob;
+
+#if !defined(XBRZ_PPL)
+/* Portable counterpart of the PPL task group: a pool of SDL threads works through the
+ * slices of a frame along with the thread that asked for it, which returns once all the
+ * slices are done. Waking a worker costs more than a small slice, so the workers only
+ * take slices the calling thread has not got to yet. */
+static struct {
+    std::vector<SDL_Thread*> threads;
+    SDL_mutex *lock = NULL;
+    SDL_sem *start = NULL;          /* one post per worker to wake */
+    SDL_sem *done = NULL;           /* posted by the worker finishing the last slice */
+    const xBRZ_SliceJob *job = NULL;
+    xBRZ_Slices slices;
+    size_t next = 0;
+    size_t pending = 0;
+    bool quit = false;
+} xbrz_pool;
+
+/* returns true if this thread finished the last slice of the job */
+static bool xBRZ_PoolWork(void) {
+    bool last = false;
+
+    SDL_LockMutex(xbrz_pool.lock);
+    while (xbrz_pool.next < xbrz_pool.slices.size()) {
+        const std::pair<int,int> slice = xbrz_pool.slices[xbrz_pool.next++];
+        const xBRZ_SliceJob *job = xbrz_pool.job;
+
+        SDL_UnlockMutex(xbrz_pool.lock);
+        (*job)(slice.first, slice.second);
+        SDL_LockMutex(xbrz_pool.lock);
+
+        last = (--xbrz_pool.pending == 0);
+    }
+    SDL_UnlockMutex(xbrz_pool.lock);
+
+    return last;
+}
+
+static int xBRZ_PoolThread(void *data) {
+    (void)data;//UNUSED
+    for (;;) {
+        SDL_SemWait(xbrz_pool.start);
+        if (xbrz_pool.quit) break;
+        if (xBRZ_PoolWork()) SDL_SemPost(xbrz_pool.done);
+    }
+    return 0;
+}
+
+static void xBRZ_PoolStop(void) {
+    if (xbrz_pool.threads.empty()) return;
+
+    xbrz_pool.quit = true;
+    for (size_t i = 0; i < xbrz_pool.threads.size(); i++) SDL_SemPost(xbrz_pool.start);
+    for (size_t i = 0; i < xbrz_pool.threads.size(); i++) SDL_WaitThread(xbrz_pool.threads[i], NULL);
+    xbrz_pool.threads.clear();
+    xbrz_pool.quit = false;
+
+    SDL_DestroySemaphore(xbrz_pool.done);
+    SDL_DestroySemaphore(xbrz_pool.start);
+    SDL_DestroyMutex(xbrz_pool.lock);
+    xbrz_pool.done = xbrz_pool.start = NULL;
+    xbrz_pool.lock = NULL;
+}
+
+static void xBRZ_PoolStart(int workers) {
+    if ((size_t)workers == xbrz_pool.threads.size()) return;
+
+    xBRZ_PoolStop();
+    if (workers <= 0) return;
+
+    xbrz_pool.lock = SDL_CreateMutex();
+    xbrz_pool.start = SDL_CreateSemaphore(0);
+    xbrz_pool.done = SDL_CreateSemaphore(0);
+    if (xbrz_pool.lock == NULL || xbrz_pool.start == NULL || xbrz_pool.done == NULL) {
+        LOG_MSG("xBRZ: Unable to create the worker threads, scaling on a single thread");
+        return;
+    }
+
+    for (int i = 0; i < workers; i++) {
+#if defined(C_SDL2)
+        SDL_Thread *thread = SDL_CreateThread(xBRZ_PoolThread, "xBRZ", NULL);
+#else
+        SDL_Thread *thread = SDL_CreateThread(xBRZ_PoolThread, NULL);
+#endif
+        if (thread == NULL) break;
+        xbrz_pool.threads.push_back(thread);
+    }
+
+    LOG(LOG_MISC, LOG_DEBUG)("xBRZ: %u worker threads", (unsigned int)xbrz_pool.threads.size());
+}
+#endif /*!XBRZ_PPL*/
+
+static void xBRZ_RunSlices(const xBRZ_Slices &slices, const xBRZ_SliceJob &job) {
+#if defined(XBRZ_PPL)
+    concurrency::task_group tg; // perf: task_group is slightly faster than pure parallel_for
+    for (size_t i = 0; i < slices.size(); i++) {
+        const std::pair<int,int> slice = slices[i];
+        tg.run([&job, slice] { job(slice.first, slice.second); });
+    }
+    tg.wait();
+#else
+    if (xbrz_pool.threads.empty() || slices.size() < 2) {
+        for (size_t i = 0; i < slices.size(); i++) job(slices[i].first, slices[i].second);
+        return;
+    }
+
+    SDL_LockMutex(xbrz_pool.lock);
+    xbrz_pool.job = &job;
+    xbrz_pool.slices = slices;
+    xbrz_pool.next = 0;
+    xbrz_pool.pending = slices.size();
+    SDL_UnlockMutex(xbrz_pool.lock);
+
+    const size_t wake = min(xbrz_pool.threads.size(), slices.size() - 1u);
+    for (size_t i = 0; i < wake; i++) SDL_SemPost(xbrz_pool.start);
+
+    if (!xBRZ_PoolWork()) SDL_SemWait(xbrz_pool.done);
+#endif
+}
+
+static void xBRZ_AddSlices(xBRZ_Slices &slices, int first, int last, int granularity) {
+    if (granularity < 1) granularity = 1;
+    for (int i = first; i < last; i += granularity)
+        slices.push_back(std::make_pair(i, min(i + granularity, last)));
+}
+
+#endif /*C_XBRZ || C_SURFACE_POSTRENDER_ASPECT*/
+
 #if C_XBRZ
 
 struct SDL_xBRZ sdl_xbrz;
 
+/* host CPUs, the emulation thread included */
+static int xBRZ_HostCPUCount(void) {
+#if defined(C_SDL2)
+    return SDL_GetCPUCount();
+#elif defined(_SC_NPROCESSORS_ONLN)
+    const long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return (count > 0) ? (int)count : 1;
+#else
+    return 1;
+#endif
+}
+
 void xBRZ_Initialize()
 {
     Section_prop* section = static_cast<Section_prop *>(control->GetSection("render"));
@@ -34,6 +185,9 @@ void xBRZ_Change_Options(Section_prop* section)
     sdl_xbrz.task_granularity = section->Get_int("xbrz slice");
     sdl_xbrz.fixed_scale_factor = section->Get_int("xbrz fixed scale factor");
     sdl_xbrz.max_scale_factor = section->Get_int("xbrz max scale factor");
+    sdl_xbrz.threads = section->Get_int("xbrz threads");
+    if (sdl_xbrz.threads <= 0)
+        sdl_xbrz.threads = min(xBRZ_HostCPUCount(), 16);
     if ((sdl_xbrz.max_scale_factor < 2) || (sdl_xbrz.max_scale_factor > xbrz::SCALE_FACTOR_MAX))
         sdl_xbrz.max_scale_factor = xbrz::SCALE_FACTOR_MAX;
     if ((sdl_xbrz.fixed_scale_factor < 2) || (sdl_xbrz.fixed_scale_factor > xbrz::SCALE_FACTOR_MAX))
@@ -69,11 +223,11 @@ bool xBRZ_SetScaleParameters(int srcWidth, int srcHeight, int dstWidth, int dstH
 
 void xBRZ_Render(const uint32_t* renderBuf, uint32_t* xbrzBuf, const Bit16u *changedLines, const int srcWidth, const int srcHeight, int scalingFactor)
 {
-#ifdef XBRZ_PPL
+    static xBRZ_Slices slices;
+    slices.clear();
+
     if (changedLines) // perf: in worst case similar to full input scaling
     {
-        concurrency::task_group tg; // perf: task_group is slightly faster than pure parallel_for
-
         int yLast = 0;
         Bitu y = 0, index = 0;
         while (y < sdl.draw.height)
@@ -88,59 +242,31 @@ void xBRZ_Render(const uint32_t* renderBuf, uint32_t* xbrzBuf, const Bit16u *cha
 
                 int yFirst = max(yLast, sliceFirst - 2); // we need to update two adjacent lines as well since they are analyzed by xBRZ!
                 yLast = min(srcHeight, sliceLast + 2);   // (and make sure to not overlap with last slice!)
-                for (int i = yFirst; i < yLast; i += sdl_xbrz.task_granularity)
-                {
-                    tg.run([=] { 
-                        const int iLast = min(i + sdl_xbrz.task_granularity, yLast);
-                        xbrz::scale(scalingFactor, renderBuf, xbrzBuf, srcWidth, srcHeight, xbrz::ColorFormat::RGB, xbrz::ScalerCfg(), i, iLast);
-                    });
-                }
+                xBRZ_AddSlices(slices, yFirst, yLast, sdl_xbrz.task_granularity);
             }
             index++;
         }
-        tg.wait();
     }
     else // process complete input image
     {
-        concurrency::task_group tg;
-        for (int i = 0; i < srcHeight; i += sdl_xbrz.task_granularity)
-        {
-            tg.run([=] { 
-                const int iLast = min(i + sdl_xbrz.task_granularity, srcHeight);
-                xbrz::scale(scalingFactor, renderBuf, xbrzBuf, srcWidth, srcHeight, xbrz::ColorFormat::RGB, xbrz::ScalerCfg(), i, iLast);
-            });
-        }
-        tg.wait();
+        xBRZ_AddSlices(slices, 0, srcHeight, sdl_xbrz.task_granularity);
     }
-#else
-    /* non-PPL for non-Windows.
-    * combine the code above, cleanly, if possible. */
-    if (changedLines)
-    {
-        int yLast = 0;
-        Bitu y = 0, index = 0;
-        while (y < sdl.draw.height)
-        {
-            if (!(index & 1))
-                y += changedLines[index];
-            else
-            {
-                const int sliceFirst = int(y);
-                const int sliceLast = int(y + changedLines[index]);
-                y += changedLines[index];
 
-                int yFirst = max(yLast, sliceFirst - 2); // we need to update two adjacent lines as well since they are analyzed by xBRZ!
-                yLast = min(srcHeight, sliceLast + 2);  // (and make sure to not overlap with last slice!)
-                xbrz::scale((size_t)scalingFactor, renderBuf, xbrzBuf, srcWidth, srcHeight, xbrz::ColorFormat::RGB, xbrz::ScalerCfg(), yFirst, yLast);
-            }
-            index++;
-        }
-    }
-    else // process complete input image
-    {
-        xbrz::scale((size_t)scalingFactor, renderBuf, xbrzBuf, srcWidth, srcHeight, xbrz::ColorFormat::RGB, xbrz::ScalerCfg(), 0, srcHeight);
-    }
-#endif /*XBRZ_PPL*/
+#if !defined(XBRZ_PPL)
+    xBRZ_PoolStart(sdl_xbrz.threads - 1);
+#endif
+
+    xBRZ_RunSlices(slices, [=](int first, int last) {
+        xbrz::scale((size_t)scalingFactor, renderBuf, xbrzBuf, srcWidth, srcHeight, xbrz::ColorFormat::RGB, xbrz::ScalerCfg(), first, last);
+    });
+}
+
+/* joins the worker threads, they must be gone before SDL quits */
+void xBRZ_Shutdown()
+{
+#if !defined(XBRZ_PPL)
+    xBRZ_PoolStop();
+#endif
 }
 
 #endif /*C_XBRZ*/
@@ -151,35 +277,19 @@ void xBRZ_PostScale(const uint32_t* src, const int srcWidth, const int srcHeight
                     uint32_t* tgt, const int tgtWidth, const int tgtHeight, const int tgtPitch, 
                     const bool bilinear, const int task_granularity)
 {
-    (void)task_granularity;
-
-# if defined(XBRZ_PPL)
-    if (bilinear) {
-        concurrency::task_group tg;
-        for (int i = 0; i < tgtHeight; i += task_granularity)
-            tg.run([=] {
-                const int iLast = min(i + task_granularity, tgtHeight);
-                xbrz::bilinearScale(&src[0], srcWidth, srcHeight, srcPitch, &tgt[0], tgtWidth, tgtHeight, tgtPitch, i, iLast, [](uint32_t pix) { return pix; });  
-            });
-        tg.wait();
-    }
-    else
-    {
-        concurrency::task_group tg;
-        for (int i = 0; i < tgtHeight; i += task_granularity)
-            tg.run([=] {
-                const int iLast = min(i + task_granularity, tgtHeight);
-                // perf: going over target is by factor 4 faster than going over source for similar image sizes
-                xbrz::nearestNeighborScale(&src[0], srcWidth, srcHeight, srcPitch, &tgt[0], tgtWidth, tgtHeight, tgtPitch, i, iLast, [](uint32_t pix) { return pix; });
-            });
-        tg.wait();
-    }
-#else
+    static xBRZ_Slices slices;
+    slices.clear();
+    xBRZ_AddSlices(slices, 0, tgtHeight, task_granularity);
+
     if (bilinear)
-        xbrz::bilinearScale(&src[0], srcWidth, srcHeight, srcPitch, &tgt[0], tgtWidth, tgtHeight, tgtPitch, 0, tgtHeight, [](uint32_t pix) { return pix; });
+        xBRZ_RunSlices(slices, [=](int first, int last) {
+            xbrz::bilinearScale(&src[0], srcWidth, srcHeight, srcPitch, &tgt[0], tgtWidth, tgtHeight, tgtPitch, first, last, [](uint32_t pix) { return pix; });
+        });
     else
-        xbrz::nearestNeighborScale(&src[0], srcWidth, srcHeight, srcPitch, &tgt[0], tgtWidth, tgtHeight, tgtPitch, 0, tgtHeight, [](uint32_t pix) { return pix; });
-#endif
+        xBRZ_RunSlices(slices, [=](int first, int last) {
+            // perf: going over target is by factor 4 faster than going over source for similar image sizes
+            xbrz::nearestNeighborScale(&src[0], srcWidth, srcHeight, srcPitch, &tgt[0], tgtWidth, tgtHeight, tgtPitch, first, last, [](uint32_t pix) { return pix; });
+        });
 }
 
 #endif /*C_XBRZ || C_SURFACE_POSTRENDER_ASPECT*/